@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Comparing a benchmark run with a stored baseline.
+
+Usage: ./build/bench.elf | python3 compare.py baselines/linux.txt
+Exits with 1 when a benchmark got slower than the threshold or allocates more.
+Benchmarks missing in the baseline are only listed.
+
+Recording: ./build/bench.elf | python3 compare.py --record baselines/linux.txt
+The run must come from this bench project, cJSON included, so that the
+baseline holds the numbers the documented build reproduces.
+"""
+import argparse
+import os
+import re
+import sys
+
+LINE = re.compile(r"^(?P<name>.+?)\s+(?P<time>\d+) (?P<unit>\w+)/op"
+                  r"(?:\s+(?P<allocs>[\d.]+) allocs/op\s+(?P<peak>\d+) B peak)?\s*$")
+
+
+def load(lines):
+    results = {}
+    for line in lines:
+        match = LINE.match(line.rstrip("\n"))
+        if match and not line.startswith("#"):
+            results[match["name"]] = match
+    return results
+
+
+def record(path, lines):
+    results = load(lines)
+    if not any("cJSON" in name for name in results):
+        sys.exit("No cJSON rows in the run, the baseline would miss the comparison")
+    os.makedirs(os.path.dirname(path) or ".", exist_ok=True)
+    with open(path, "w") as file:
+        file.write("# Recorded with compare.py --record from ./build/bench.elf of the bench project.\n")
+        for result in results.values():
+            file.write(result.string.rstrip("\n") + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("run", nargs="?", help="benchmark output (default: stdin)")
+    parser.add_argument("--threshold", type=float, default=20.0, help="allowed slowdown in percent")
+    parser.add_argument("--record", action="store_true", help="store the run as the baseline")
+    args = parser.parse_args()
+
+    if args.run:
+        with open(args.run) as file:
+            lines = file.readlines()
+    else:
+        lines = sys.stdin.readlines()
+    if args.record:
+        record(args.baseline, lines)
+        return
+    if not os.path.exists(args.baseline):
+        sys.exit(f"No baseline {args.baseline}, record one with --record")
+
+    with open(args.baseline) as file:
+        baseline = load(file)
+    run = load(lines)
+
+    failed = False
+    for name, result in run.items():
+        base = baseline.get(name)
+        if base is None:
+            print(f"{name:34} {int(result['time']):>10} {result['unit']}/op  (no baseline)")
+            continue
+        change = (int(result["time"]) - int(base["time"])) * 100.0 / max(int(base["time"]), 1)
+        status = ""
+        if change > args.threshold:
+            status = "SLOWER"
+        if result["allocs"] and base["allocs"] and float(result["allocs"]) > float(base["allocs"]):
+            status = "MORE ALLOCS"
+        failed |= status != ""
+        print(f"{name:34} {int(base['time']):>10} -> {int(result['time']):>10} {result['unit']}/op {change:+7.1f}% {status}")
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
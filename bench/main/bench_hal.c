@@ -0,0 +1,159 @@
+/*********************************************************************/
+/*!
+*   \file   bench_hal.c
+*
+*   \brief  ADC of the benchmarks, replaying synthetic traces.
+*
+*           Traces are deterministic, so host and target runs measure
+*           the same work without the conversion time of the ADC.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "sdkconfig.h"
+
+#include "bench_hal.h"
+#include "sensor.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Noise of the traces (+/- raw). */
+#define BENCH_TRACE_NOISE 4
+/* Distance and height of the servo spikes. */
+#define BENCH_TRACE_SPIKE_PERIOD 50
+#define BENCH_TRACE_SPIKE 600
+/* Raw value of the constant traces. */
+#define BENCH_TRACE_LEVEL 1100
+
+/* Full scale of the simulated ADC [mV]. */
+#define BENCH_FULL_SCALE_MV 3100
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+static uint16_t trace[BENCH_TRACE_LENGTH];
+static uint32_t position;
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Selecting the trace read by halAdcRead().
+ *
+ * \param  type - trace type.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void benchHalSetTrace(benchTrace type)
+{
+    uint32_t noise = 2463534242u;
+    uint32_t i = 0;
+    int32_t raw = 0;
+
+    for (i = 0; i < BENCH_TRACE_LENGTH; i++)
+    {
+        switch (type)
+        {
+        case benchTraceRamp:
+            raw = SENSOR_RAW_WET + (int32_t)(i * (SENSOR_RAW_DRY - SENSOR_RAW_WET) / BENCH_TRACE_LENGTH);
+            break;
+        case benchTraceSpiky:
+            raw = BENCH_TRACE_LEVEL + ((i % BENCH_TRACE_SPIKE_PERIOD) == 0 ? BENCH_TRACE_SPIKE : 0);
+            break;
+        case benchTraceFlat:
+        default:
+            raw = BENCH_TRACE_LEVEL;
+            break;
+        }
+
+        noise ^= noise << 13;
+        noise ^= noise >> 17;
+        noise ^= noise << 5;
+        trace[i] = raw + (int32_t)(noise % (2 * BENCH_TRACE_NOISE + 1)) - BENCH_TRACE_NOISE;
+    }
+    position = 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  ADC initialization for the given ADC1 channels.
+ *
+ * \param  pChannels - ADC1 channels.
+ * \param  count - number of channels.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halAdcInit(const uint8_t* pChannels, uint8_t count)
+{
+    benchHalSetTrace(benchTraceFlat);
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading one sample of the trace, every channel reads the same trace.
+ *
+ * \param  channel - ADC1 channel.
+ *
+ * \return Raw data (HAL_ADC_BITS).
+ *
+ */
+/*********************************************************************/
+uint16_t halAdcRead(uint8_t channel)
+{
+    uint16_t raw = trace[position];
+
+    position = (position + 1) % BENCH_TRACE_LENGTH;
+    return raw;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading a whole frame of the trace.
+ *
+ * \param  callback - function called for every sample.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return Number of samples in the frame.
+ *
+ */
+/*********************************************************************/
+uint32_t halAdcReadFrame(halAdcSampleCallback callback, void* pContext)
+{
+#if CONFIG_SENSOR_CONTINUOUS
+    uint32_t i = 0;
+
+    for (i = 0; i < CONFIG_SENSOR_FRAME_SAMPLES; i++)
+    {
+        callback(CONFIG_SENSOR_1_CHANNEL, halAdcRead(CONFIG_SENSOR_1_CHANNEL), pContext);
+    }
+
+    return CONFIG_SENSOR_FRAME_SAMPLES;
+#else
+    return 0;
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Converting raw data to a voltage.
+ *
+ * \param  raw - raw data (HAL_ADC_BITS).
+ *
+ * \return Voltage [mV].
+ *
+ */
+/*********************************************************************/
+uint16_t halAdcToVoltage(uint16_t raw)
+{
+    return (uint32_t)raw * BENCH_FULL_SCALE_MV / ((1 << HAL_ADC_BITS) - 1);
+}
\ No newline at end of file
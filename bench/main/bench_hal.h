@@ -0,0 +1,49 @@
+/*********************************************************************/
+/*!
+*   \file   bench_hal.h
+*
+*   \brief  ADC of the benchmarks, replaying synthetic traces.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef BENCH_HAL_H
+#define BENCH_HAL_H
+
+#include "hal.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Number of samples of a trace, replayed in a loop. */
+#define BENCH_TRACE_LENGTH 1024
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Synthetic ADC trace. */
+typedef enum
+{
+    benchTraceFlat,     //Constant moisture with noise.
+    benchTraceRamp,     //Soil drying out from wet to dry.
+    benchTraceSpiky,    //Constant moisture with servo spikes.
+} benchTrace;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Selecting the trace read by halAdcRead().
+ *
+ * \param  trace - trace type.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void benchHalSetTrace(benchTrace trace);
+
+#endif /*BENCH_HAL_H*/
\ No newline at end of file
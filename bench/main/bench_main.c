@@ -0,0 +1,697 @@
+/*********************************************************************/
+/*!
+*   \file   bench_main.c
+*
+*   \brief  Benchmarks of the sensor and JSON hot paths.
+*
+*           Every benchmark prints one line: time per operation
+*           (ns on the host, CPU cycles on the target) and, on the
+*           host, heap allocations per operation and the peak heap.
+*           Baselines are kept in bench/baselines, regressions show
+*           up as diffs of the output (compare.py). Payload sizes of
+*           JSON and CBOR are printed next to their timings.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+#include "sdkconfig.h"
+
+#include "bench_hal.h"
+#include "cbor_writer.h"
+#include "sensor.h"
+#include "wifi_api.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <malloc.h>
+#include <time.h>
+#else
+#include "esp_cpu.h"
+#endif
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#if CONFIG_IDF_TARGET_LINUX
+    #define BENCH_UNIT "ns"
+#else
+    #define BENCH_UNIT "cycles"
+#endif
+
+/* Rounds of every benchmark, the fastest one is reported. */
+#define BENCH_ROUNDS 5
+/* Iterations of the cheap and the expensive benchmarks in each round. */
+#define BENCH_ITERATIONS 10000
+#define BENCH_ITERATIONS_SLOW 500
+
+/* Largest payload, in sensors. */
+#define BENCH_MAX_SENSORS 64
+/* Buffer for a payload with BENCH_MAX_SENSORS sensors. */
+#define BENCH_PAYLOAD_SIZE (BENCH_MAX_SENSORS * POST_SAMPLE_SIZE + 64)
+/* Chunk of the response delivered by the HTTP client. */
+#define BENCH_CHUNK_SIZE 512
+
+/* Template used by the previous cJSON serializer. */
+#define TEMP_JSON "{ \"sensor_id\": 1, \"humidity\": 28, \"is_sensor_on\": 1}"
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Function measured by a benchmark. */
+typedef void (*benchFunction)(void* pContext, uint32_t iteration);
+
+/* Heap usage of the running benchmark. */
+typedef struct
+{
+    uint32_t allocations;   //Number of allocations.
+    size_t current;         //Bytes allocated now.
+    size_t peak;            //Peak of the allocated bytes.
+} benchHeap;
+
+/* Backend response with the given number of sensors. */
+typedef struct
+{
+    char json[BENCH_PAYLOAD_SIZE];      //Response body.
+    size_t len;                         //Length of the body.
+    uint8_t cbor[BENCH_PAYLOAD_SIZE];   //Same response in CBOR.
+    size_t cborLen;                     //Length of the CBOR body.
+} benchPayload;
+
+/* Samples and output buffer of the serializers. */
+typedef struct
+{
+    sensorSample samples[BENCH_MAX_SENSORS];    //Samples to send.
+    size_t count;                               //Number of samples.
+    char buffer[BENCH_PAYLOAD_SIZE];            //Output buffer.
+} benchPost;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+/* Keeps results alive so the measured code is not optimized out. */
+static volatile size_t sink;
+
+static benchHeap heap;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+#if CONFIG_IDF_TARGET_LINUX
+/* Allocation counting, the linker redirects the heap functions here. */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pMemory, size_t size);
+void __real_free(void* pMemory);
+
+/*********************************************************************/
+/*!
+ * \brief  Counting a new allocation.
+ *
+ * \param  pMemory - allocated memory (NULL - failed).
+ *
+ * \return Allocated memory.
+ *
+ */
+/*********************************************************************/
+static void* benchHeapAdd(void* pMemory)
+{
+    if (pMemory != NULL)
+    {
+        heap.allocations++;
+        heap.current += malloc_usable_size(pMemory);
+        if (heap.current > heap.peak)
+        {
+            heap.peak = heap.current;
+        }
+    }
+    return pMemory;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Counting a released allocation.
+ *
+ * \param  pMemory - released memory.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchHeapRemove(void* pMemory)
+{
+    size_t size = (pMemory != NULL) ? malloc_usable_size(pMemory) : 0;
+
+    heap.current = (heap.current > size) ? heap.current - size : 0;
+}
+
+void* __wrap_malloc(size_t size)
+{
+    return benchHeapAdd(__real_malloc(size));
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    return benchHeapAdd(__real_calloc(count, size));
+}
+
+void* __wrap_realloc(void* pMemory, size_t size)
+{
+    benchHeapRemove(pMemory);
+    return benchHeapAdd(__real_realloc(pMemory, size));
+}
+
+void __wrap_free(void* pMemory)
+{
+    benchHeapRemove(pMemory);
+    __real_free(pMemory);
+}
+#endif
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the time counter.
+ *
+ * \param  None
+ *
+ * \return Counter value in BENCH_UNIT.
+ *
+ */
+/*********************************************************************/
+static uint64_t benchNow(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    return esp_cpu_get_cycle_count();
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Time elapsed since the given counter value.
+ *
+ * \param  start - counter value at the start.
+ *
+ * \return Elapsed time in BENCH_UNIT.
+ *
+ */
+/*********************************************************************/
+static uint64_t benchElapsed(uint64_t start)
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    /* The target cycle counter is 32-bit. */
+    return (uint32_t)(benchNow() - start);
+#else
+    return benchNow() - start;
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Running one benchmark and printing its results.
+ *         The fastest of BENCH_ROUNDS rounds is reported, which
+ *         keeps scheduling noise out of the baselines.
+ *
+ * \param  pName - name of the benchmark.
+ * \param  function - measured function.
+ * \param  pContext - pointer passed to the function.
+ * \param  iterations - number of calls in each round.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchRun(const char* pName, benchFunction function, void* pContext, uint32_t iterations)
+{
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    uint64_t best = UINT64_MAX;
+    uint32_t round = 0;
+    uint32_t i = 0;
+
+    /* Warm-up call, also leaves lazily allocated state out of the numbers. */
+    function(pContext, 0);
+    memset(&heap, 0, sizeof(heap));
+
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        elapsed = 0;
+#if !CONFIG_IDF_TARGET_LINUX
+        /* The 32-bit cycle counter wraps, every call is timed on its own. */
+        for (i = 0; i < iterations; i++)
+        {
+            start = benchNow();
+            function(pContext, i);
+            elapsed += benchElapsed(start);
+        }
+#else
+        start = benchNow();
+        for (i = 0; i < iterations; i++)
+        {
+            function(pContext, i);
+        }
+        elapsed = benchElapsed(start);
+#endif
+        if (elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+#if CONFIG_IDF_TARGET_LINUX
+    printf("%-34s %10llu " BENCH_UNIT "/op %8.2f allocs/op %8u B peak\n", pName,
+           (unsigned long long)(best / iterations), (double)heap.allocations / (iterations * BENCH_ROUNDS),
+           (unsigned)heap.peak);
+#else
+    printf("%-34s %10llu " BENCH_UNIT "/op\n", pName, (unsigned long long)(best / iterations));
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Printing the JSON and CBOR sizes of a payload.
+ *         The line does not match the result format, so compare.py
+ *         skips it.
+ *
+ * \param  pName - name of the payload.
+ * \param  json - JSON length.
+ * \param  cbor - CBOR length.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchSize(const char* pName, size_t json, size_t cbor)
+{
+    printf("%-34s %10u B json %6u B cbor %+7.1f%%\n", pName, (unsigned)json, (unsigned)cbor,
+           (json > 0) ? ((double)cbor - json) * 100.0 / json : 0.0);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Building a backend response with the given number of sensors.
+ *
+ * \param  pPayload - Pointer where the response is stored.
+ * \param  sensors - number of sensors.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchPayloadBuild(benchPayload* pPayload, uint32_t sensors)
+{
+    cborWriter writer;
+    size_t len = 0;
+    uint32_t i = 0;
+
+    len += snprintf(pPayload->json + len, sizeof(pPayload->json) - len, "{\"sensor_data\": [");
+    for (i = 0; i < sensors; i++)
+    {
+        len += snprintf(pPayload->json + len, sizeof(pPayload->json) - len,
+                        "%s{\"humidity\": %u.5, \"is_sensor_on\": %u, \"sensor_id\": %u}",
+                        (i > 0) ? ", " : "", (unsigned)(i * 7 % 100), (unsigned)(i % 3 != 2), (unsigned)(i + 1));
+    }
+    len += snprintf(pPayload->json + len, sizeof(pPayload->json) - len,
+                    "], \"watering_process\": 0, \"sprinkler_state\": 0}");
+    pPayload->len = len;
+
+    /* Same values, the humidity is a single-precision float. */
+    cborWriterInit(&writer, pPayload->cbor, sizeof(pPayload->cbor));
+    cborWriteMapBegin(&writer, 3);
+    cborWriteText(&writer, "sensor_data");
+    cborWriteArrayBegin(&writer, sensors);
+    for (i = 0; i < sensors; i++)
+    {
+        cborWriteMapBegin(&writer, 3);
+        cborWriteText(&writer, "humidity");
+        cborWriteFloat(&writer, (i * 7 % 100) + 0.5f);
+        cborWriteMemberInt(&writer, "is_sensor_on", i % 3 != 2);
+        cborWriteMemberInt(&writer, "sensor_id", i + 1);
+    }
+    cborWriteMemberInt(&writer, "watering_process", 0);
+    cborWriteMemberInt(&writer, "sprinkler_state", 0);
+    pPayload->cborLen = cborWriterFinish(&writer);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Preparing samples for the serializers.
+ *
+ * \param  pPost - Pointer where the samples are stored.
+ * \param  count - number of samples.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchPostBuild(benchPost* pPost, size_t count)
+{
+    size_t i = 0;
+
+    memset(pPost->samples, 0, sizeof(pPost->samples));
+    for (i = 0; i < count; i++)
+    {
+        pPost->samples[i].timestamp = 1700000000000LL + i * 1000;
+        pPost->samples[i].timeValid = true;
+        pPost->samples[i].data.sensorId = i + 1;
+        pPost->samples[i].data.percentageResult = i % 101;
+    }
+    pPost->count = count;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Percentage table rebuild, SENSOR_LUT_SIZE calls of mape().
+ *
+ * \param  pContext - not used.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchCalibration(void* pContext, uint32_t iteration)
+{
+    sensorSetCalibration(SENSOR_RAW_DRY + (iteration & 1), SENSOR_RAW_WET);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Filtered measurement with the voltage and the percentage.
+ *
+ * \param  pContext - not used.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchSensorResult(void* pContext, uint32_t iteration)
+{
+    sensorData data;
+
+    sensorGetResult(&data);
+    sink += data.percentageResult;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Filtered measurement with the percentage only.
+ *
+ * \param  pContext - not used.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchSensorPercentage(void* pContext, uint32_t iteration)
+{
+    sensorData data;
+
+    sensorGetPercentageResult(&data);
+    sink += data.percentageResult;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the whole response at once.
+ *
+ * \param  pContext - response.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchGetData(void* pContext, uint32_t iteration)
+{
+    benchPayload* pPayload = (benchPayload*)pContext;
+
+    getData(pPayload->json, pPayload->len);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Passing a response to the parser in chunks,
+ *         as the HTTP client delivers it.
+ *
+ * \param  format - encoding of the response.
+ * \param  pData - response body.
+ * \param  len - length of the body.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchFeedChunks(wifiApiFormat format, const uint8_t* pData, size_t len)
+{
+    size_t offset = 0;
+    size_t chunk = 0;
+
+    getDataBegin(format);
+    for (offset = 0; offset < len; offset += chunk)
+    {
+        chunk = len - offset;
+        if (chunk > BENCH_CHUNK_SIZE)
+        {
+            chunk = BENCH_CHUNK_SIZE;
+        }
+        getDataChunk((const char*)pData + offset, chunk);
+    }
+    getDataEnd();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the response in chunks, as the HTTP client delivers it.
+ *
+ * \param  pContext - response.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchGetDataChunked(void* pContext, uint32_t iteration)
+{
+    benchPayload* pPayload = (benchPayload*)pContext;
+
+    benchFeedChunks(wifiApiJson, (const uint8_t*)pPayload->json, pPayload->len);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the CBOR response in chunks.
+ *
+ * \param  pContext - response.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchGetDataCbor(void* pContext, uint32_t iteration)
+{
+    benchPayload* pPayload = (benchPayload*)pContext;
+
+    benchFeedChunks(wifiApiCbor, pPayload->cbor, pPayload->cborLen);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Previous parser: whole document tree with cJSON.
+ *
+ * \param  pContext - response.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchGetDataCjson(void* pContext, uint32_t iteration)
+{
+    benchPayload* pPayload = (benchPayload*)pContext;
+    cJSON* pRoot = cJSON_ParseWithLength(pPayload->json, pPayload->len);
+    cJSON* pSensors = cJSON_GetObjectItem(pRoot, "sensor_data");
+    cJSON* pSensor = cJSON_GetArrayItem(pSensors, 0);
+
+    sink += cJSON_GetObjectItem(pSensor, "sensor_id")->valueint;
+    sink += cJSON_GetObjectItem(pRoot, "watering_process")->valueint;
+    cJSON_Delete(pRoot);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Buffer serializer of one sample.
+ *
+ * \param  pContext - samples.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchPostData(void* pContext, uint32_t iteration)
+{
+    benchPost* pPost = (benchPost*)pContext;
+
+    pPost->samples[0].data.percentageResult = iteration % 101;
+    sink += postData(&pPost->samples[0].data, pPost->buffer, sizeof(pPost->buffer));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Buffer serializer of a batch.
+ *
+ * \param  pContext - samples.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchPostDataBatch(void* pContext, uint32_t iteration)
+{
+    benchPost* pPost = (benchPost*)pContext;
+
+    pPost->samples[0].data.percentageResult = iteration % 101;
+    sink += postDataBatch(pPost->samples, pPost->count, pPost->buffer, sizeof(pPost->buffer));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  CBOR serializer of one sample.
+ *
+ * \param  pContext - samples.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchPostDataCbor(void* pContext, uint32_t iteration)
+{
+    benchPost* pPost = (benchPost*)pContext;
+
+    pPost->samples[0].data.percentageResult = iteration % 101;
+    sink += postDataCbor(&pPost->samples[0].data, (uint8_t*)pPost->buffer, sizeof(pPost->buffer));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  CBOR serializer of a batch.
+ *
+ * \param  pContext - samples.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchPostDataBatchCbor(void* pContext, uint32_t iteration)
+{
+    benchPost* pPost = (benchPost*)pContext;
+
+    pPost->samples[0].data.percentageResult = iteration % 101;
+    sink += postDataBatchCbor(pPost->samples, pPost->count, (uint8_t*)pPost->buffer, sizeof(pPost->buffer));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Previous serializer: template parse, replace and pretty print.
+ *
+ * \param  pContext - samples.
+ * \param  iteration - call number.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void benchPostDataCjson(void* pContext, uint32_t iteration)
+{
+    benchPost* pPost = (benchPost*)pContext;
+    cJSON* pRoot = cJSON_Parse(TEMP_JSON);
+
+    cJSON_ReplaceItemInObject(pRoot, "humidity", cJSON_CreateNumber(pPost->samples[0].data.percentageResult));
+    char* pNewJsonData = cJSON_Print(pRoot);
+
+    cJSON_Delete(pRoot);
+    sink += pNewJsonData[0];
+    cJSON_free(pNewJsonData);
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+
+void app_main(void)
+{
+    static const uint32_t sensors[] = { 1, 8, BENCH_MAX_SENSORS };
+    static benchPayload payload;
+    static benchPost post;
+    uint16_t sensorIds[SENSOR_MAX];
+    char name[40];
+    uint8_t i = 0;
+
+    for (i = 0; i < SENSOR_MAX; i++)
+    {
+        sensorIds[i] = i + 1;
+    }
+    wifiApiInit(sensorIds, SENSOR_MAX);
+    sensorInit();
+
+    benchRun("sensorSetCalibration (mape x2048)", benchCalibration, NULL, BENCH_ITERATIONS_SLOW);
+
+    benchHalSetTrace(benchTraceFlat);
+    benchRun("sensorGetResult flat", benchSensorResult, NULL, BENCH_ITERATIONS);
+    benchHalSetTrace(benchTraceRamp);
+    benchRun("sensorGetResult ramp", benchSensorResult, NULL, BENCH_ITERATIONS);
+    benchHalSetTrace(benchTraceSpiky);
+    benchRun("sensorGetResult spiky", benchSensorResult, NULL, BENCH_ITERATIONS);
+    benchHalSetTrace(benchTraceFlat);
+    benchRun("sensorGetPercentageResult flat", benchSensorPercentage, NULL, BENCH_ITERATIONS);
+
+    for (i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++)
+    {
+        benchPayloadBuild(&payload, sensors[i]);
+        snprintf(name, sizeof(name), "getData %u sensors", (unsigned)sensors[i]);
+        benchRun(name, benchGetData, &payload, BENCH_ITERATIONS);
+        snprintf(name, sizeof(name), "getData chunked %u sensors", (unsigned)sensors[i]);
+        benchRun(name, benchGetDataChunked, &payload, BENCH_ITERATIONS);
+        snprintf(name, sizeof(name), "getData cJSON %u sensors", (unsigned)sensors[i]);
+        benchRun(name, benchGetDataCjson, &payload, BENCH_ITERATIONS);
+        snprintf(name, sizeof(name), "getData CBOR %u sensors", (unsigned)sensors[i]);
+        benchRun(name, benchGetDataCbor, &payload, BENCH_ITERATIONS);
+        snprintf(name, sizeof(name), "size getData %u sensors", (unsigned)sensors[i]);
+        benchSize(name, payload.len, payload.cborLen);
+    }
+
+    benchPostBuild(&post, 1);
+    benchRun("postData 1 sensor", benchPostData, &post, BENCH_ITERATIONS);
+    benchRun("postData cJSON 1 sensor", benchPostDataCjson, &post, BENCH_ITERATIONS);
+    benchRun("postData CBOR 1 sensor", benchPostDataCbor, &post, BENCH_ITERATIONS);
+    benchSize("size postData 1 sensor", postData(&post.samples[0].data, post.buffer, sizeof(post.buffer)),
+              postDataCbor(&post.samples[0].data, (uint8_t*)post.buffer, sizeof(post.buffer)));
+    for (i = 1; i < sizeof(sensors) / sizeof(sensors[0]); i++)
+    {
+        benchPostBuild(&post, sensors[i]);
+        snprintf(name, sizeof(name), "postDataBatch %u sensors", (unsigned)sensors[i]);
+        benchRun(name, benchPostDataBatch, &post, BENCH_ITERATIONS);
+        snprintf(name, sizeof(name), "postDataBatch CBOR %u sensors", (unsigned)sensors[i]);
+        benchRun(name, benchPostDataBatchCbor, &post, BENCH_ITERATIONS);
+        snprintf(name, sizeof(name), "size postDataBatch %u sensors", (unsigned)sensors[i]);
+        benchSize(name, postDataBatch(post.samples, post.count, post.buffer, sizeof(post.buffer)),
+                  postDataBatchCbor(post.samples, post.count, (uint8_t*)post.buffer, sizeof(post.buffer)));
+    }
+}
\ No newline at end of file
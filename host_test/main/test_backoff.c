@@ -0,0 +1,190 @@
+/*********************************************************************/
+/*!
+*   \file   test_backoff.c
+*
+*   \brief  Tests of the retry backoff with jitter.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "unity.h"
+
+#include "backoff.h"
+#include "test_main.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Delays of the usual reconnection backoff [ms]. */
+#define MIN_DELAY 1000
+#define MAX_DELAY 60000
+
+/* Attempts checked, well past the longest delay. */
+#define ATTEMPTS 40
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Checking a delay against its upper bound.
+ *
+ * \param  delay - returned delay [ms].
+ * \param  bound - upper bound of the attempt [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void assertJitter(uint32_t delay, uint32_t bound)
+{
+    TEST_ASSERT_TRUE(delay >= bound - bound / 2);
+    TEST_ASSERT_TRUE(delay <= bound);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Delays double up to the longest one and the jitter keeps
+ *         them between half and the whole bound.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testDoubling(void)
+{
+    backoff state;
+    uint32_t bound = MIN_DELAY;
+    uint32_t seed = 1;
+    uint32_t i = 0;
+
+    backoffInit(&state, MIN_DELAY, MAX_DELAY);
+    for (i = 0; i < ATTEMPTS; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        assertJitter(backoffNext(&state, seed), bound);
+        TEST_ASSERT_EQUAL_UINT32(i + 1, state.attempts);
+        bound = (bound > MAX_DELAY / 2) ? MAX_DELAY : bound * 2;
+    }
+    TEST_ASSERT_EQUAL_UINT32(MAX_DELAY, state.delay);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The extreme random numbers give the ends of the range.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testJitterEnds(void)
+{
+    backoff state;
+
+    backoffInit(&state, MIN_DELAY, MAX_DELAY);
+    TEST_ASSERT_EQUAL_UINT32(MIN_DELAY / 2, backoffNext(&state, 0));
+    TEST_ASSERT_EQUAL_UINT32(2 * MIN_DELAY, backoffNext(&state, 2 * MIN_DELAY / 2));
+    assertJitter(backoffNext(&state, UINT32_MAX), 4 * MIN_DELAY);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Delays near UINT32_MAX neither overflow nor wrap around.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testNoOverflow(void)
+{
+    backoff state;
+    uint32_t i = 0;
+
+    backoffInit(&state, 0x80000000u, UINT32_MAX);
+    assertJitter(backoffNext(&state, UINT32_MAX), 0x80000000u);
+    for (i = 0; i < ATTEMPTS; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, state.delay);
+        assertJitter(backoffNext(&state, UINT32_MAX - i), UINT32_MAX);
+    }
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, backoffNext(&state, UINT32_MAX / 2));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Invalid limits are corrected: no zero delay and the longest
+ *         delay is never shorter than the first one.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testLimits(void)
+{
+    backoff state;
+
+    backoffInit(&state, 0, 0);
+    TEST_ASSERT_EQUAL_UINT32(1, backoffNext(&state, 0));
+    TEST_ASSERT_EQUAL_UINT32(1, backoffNext(&state, UINT32_MAX));
+
+    backoffInit(&state, MAX_DELAY, MIN_DELAY);
+    assertJitter(backoffNext(&state, 12345), MAX_DELAY);
+    TEST_ASSERT_EQUAL_UINT32(MAX_DELAY, state.delay);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  A reset starts again from the first delay.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testReset(void)
+{
+    backoff state;
+    uint32_t i = 0;
+
+    backoffInit(&state, MIN_DELAY, MAX_DELAY);
+    for (i = 0; i < ATTEMPTS; i++)
+    {
+        backoffNext(&state, i);
+    }
+    backoffReset(&state);
+    TEST_ASSERT_EQUAL_UINT32(0, state.attempts);
+    assertJitter(backoffNext(&state, UINT32_MAX), MIN_DELAY);
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the retry backoff.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testBackoff(void)
+{
+    RUN_TEST(testDoubling);
+    RUN_TEST(testJitterEnds);
+    RUN_TEST(testNoOverflow);
+    RUN_TEST(testLimits);
+    RUN_TEST(testReset);
+}
@@ -0,0 +1,191 @@
+/*********************************************************************/
+/*!
+*   \file   test_cbor_stream.c
+*
+*   \brief  Tests of the streaming CBOR parser.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <string.h>
+
+#include "unity.h"
+
+#include "cbor_stream.h"
+#include "test_log.h"
+#include "test_main.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Values of document[] reported by the parser, the same paths as JSON. */
+#define DOCUMENT_LOG ".a.b[0]=1;.a.b[1]=22;.a.b[2].c=\"xy\";.n=-12;.h=1.5;.t=true;.f=false;.z=null;"
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+/* {"a":{"b":[1,22,{"c":"xy"}]},"n":-12,"h":1.5,"t":true,"f":false,"z":null},
+   1.5 as a half-precision float. */
+static const uint8_t document[] =
+{
+    0xA6,
+    0x61, 'a', 0xA1, 0x61, 'b', 0x83, 0x01, 0x16, 0xA1, 0x61, 'c', 0x62, 'x', 'y',
+    0x61, 'n', 0x2B,
+    0x61, 'h', 0xF9, 0x3E, 0x00,
+    0x61, 't', 0xF5,
+    0x61, 'f', 0xF4,
+    0x61, 'z', 0xF6,
+};
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Parsing a document split into two chunks.
+ *
+ * \param  pDocument - document.
+ * \param  len - length of the document.
+ * \param  split - end of the first chunk.
+ * \param  pLog - where the values are logged.
+ *
+ * \return True if the document was complete and valid.
+ *
+ */
+/*********************************************************************/
+static bool parseSplit(const uint8_t* pDocument, size_t len, size_t split, testLog* pLog)
+{
+    cborStream stream;
+
+    testLogClear(pLog);
+    cborStreamInit(&stream, testLogValue, pLog);
+    cborStreamFeed(&stream, pDocument, split);
+    cborStreamFeed(&stream, pDocument + split, len - split);
+    return cborStreamFinish(&stream);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Two chunks split at every position give the same values
+ *         as the whole document.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testEverySplit(void)
+{
+    testLog log;
+    size_t split = 0;
+
+    for (split = 0; split <= sizeof(document); split++)
+    {
+        TEST_ASSERT_TRUE(parseSplit(document, sizeof(document), split, &log));
+        TEST_ASSERT_EQUAL_STRING(DOCUMENT_LOG, log.text);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Containers without a length end with a break.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testIndefinite(void)
+{
+    /* {_ "v": [_ 1, 2]} */
+    static const uint8_t indefinite[] = { 0xBF, 0x61, 'v', 0x9F, 0x01, 0x02, 0xFF, 0xFF };
+    testLog log;
+    size_t split = 0;
+
+    for (split = 0; split <= sizeof(indefinite); split++)
+    {
+        TEST_ASSERT_TRUE(parseSplit(indefinite, sizeof(indefinite), split, &log));
+        TEST_ASSERT_EQUAL_STRING(".v[0]=1;.v[1]=2;", log.text);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  64-bit integers are passed on as text.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testLargeIntegers(void)
+{
+    /* [4294967296, -4294967297] */
+    static const uint8_t large[] =
+    {
+        0x82,
+        0x1B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+        0x3B, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+    };
+    testLog log;
+
+    TEST_ASSERT_TRUE(parseSplit(large, sizeof(large), 0, &log));
+    TEST_ASSERT_EQUAL_STRING("[0]=4294967296;[1]=-4294967297;", log.text);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Truncated and unsupported documents are not reported as complete.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testMalformed(void)
+{
+    /* Indefinite-length text string. */
+    static const uint8_t indefiniteString[] = { 0x7F, 0x61, 'a', 0xFF };
+    /* Break outside of a container. */
+    static const uint8_t strayBreak[] = { 0xFF };
+    /* Reserved additional information. */
+    static const uint8_t reserved[] = { 0x1C };
+    testLog log;
+    size_t len = 0;
+
+    for (len = 0; len < sizeof(document); len++)
+    {
+        TEST_ASSERT_FALSE(parseSplit(document, len, len, &log));
+    }
+    TEST_ASSERT_FALSE(parseSplit(indefiniteString, sizeof(indefiniteString), 0, &log));
+    TEST_ASSERT_FALSE(parseSplit(strayBreak, sizeof(strayBreak), 0, &log));
+    TEST_ASSERT_FALSE(parseSplit(reserved, sizeof(reserved), 0, &log));
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the streaming CBOR parser.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testCborStream(void)
+{
+    RUN_TEST(testEverySplit);
+    RUN_TEST(testIndefinite);
+    RUN_TEST(testLargeIntegers);
+    RUN_TEST(testMalformed);
+}
@@ -0,0 +1,219 @@
+/*********************************************************************/
+/*!
+*   \file   test_controller.c
+*
+*   \brief  Tests of the moisture controller.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "unity.h"
+
+#include "controller.h"
+#include "test_main.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Limits used by the tests. */
+#define BAND 5
+#define MAX_ON_MS 600000
+#define MIN_OFF_MS 300000
+
+/* Deficit well above the band [%]. */
+#define DRY 20
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+static const controllerLimits limits =
+{
+    .band = BAND,
+    .maxOnMs = MAX_ON_MS,
+    .minOffMs = MIN_OFF_MS,
+};
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  A new controller opens at once, without a soak time.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testFirstUpdate(void)
+{
+    moistureController controller;
+
+    controllerInit(&controller);
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &limits, 0));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The valve opens only above the band and stays open inside
+ *         it until the target is reached.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testHysteresis(void)
+{
+    moistureController controller;
+
+    controllerInit(&controller);
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, 0, &limits, 0));
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, BAND, &limits, 1000));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, BAND + 1, &limits, 2000));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, BAND, &limits, 3000));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, 1, &limits, 4000));
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, 0, &limits, 5000));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The watering ends after maxOnMs even if the soil is dry.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testMaxOn(void)
+{
+    moistureController controller;
+
+    controllerInit(&controller);
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &limits, 1000));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &limits, 1000 + MAX_ON_MS - 1));
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, DRY, &limits, 1000 + MAX_ON_MS));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  After a watering the valve stays closed for minOffMs.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testSoak(void)
+{
+    moistureController controller;
+    int64_t closedMs = 1000 + MAX_ON_MS;
+
+    controllerInit(&controller);
+    controllerUpdate(&controller, DRY, &limits, 1000);
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, DRY, &limits, closedMs));
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, DRY, &limits, closedMs + MIN_OFF_MS - 1));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &limits, closedMs + MIN_OFF_MS));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Without a target the valve never opens and an open valve
+ *         is closed.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testNoTarget(void)
+{
+    moistureController controller;
+
+    controllerInit(&controller);
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, CONTROLLER_NO_TARGET, &limits, 0));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &limits, 1000));
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, CONTROLLER_NO_TARGET, &limits, 2000));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Giving up the valve closes it and starts the soak time.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testStop(void)
+{
+    moistureController controller;
+
+    controllerInit(&controller);
+    controllerUpdate(&controller, DRY, &limits, 0);
+    controllerStop(&controller, 1000);
+    TEST_ASSERT_FALSE(controller.valveOpen);
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, DRY, &limits, 1000 + MIN_OFF_MS - 1));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &limits, 1000 + MIN_OFF_MS));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The longest limits the website can set, in ms, are kept.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testLongLimits(void)
+{
+    static const controllerLimits longLimits =
+    {
+        .band = BAND,
+        .maxOnMs = 86400000,
+        .minOffMs = 86400000,
+    };
+    moistureController controller;
+
+    controllerInit(&controller);
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &longLimits, 0));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &longLimits, 86400000 - 1));
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, DRY, &longLimits, 86400000));
+    TEST_ASSERT_FALSE(controllerUpdate(&controller, DRY, &longLimits, 2 * 86400000LL - 1));
+    TEST_ASSERT_TRUE(controllerUpdate(&controller, DRY, &longLimits, 2 * 86400000LL));
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the moisture controller.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testController(void)
+{
+    RUN_TEST(testFirstUpdate);
+    RUN_TEST(testHysteresis);
+    RUN_TEST(testMaxOn);
+    RUN_TEST(testSoak);
+    RUN_TEST(testNoTarget);
+    RUN_TEST(testStop);
+    RUN_TEST(testLongLimits);
+}
@@ -0,0 +1,188 @@
+/*********************************************************************/
+/*!
+*   \file   test_event_stream.c
+*
+*   \brief  Tests of the Server-Sent Events parser.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <string.h>
+
+#include "unity.h"
+
+#include "event_stream.h"
+#include "test_main.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Size of the received events text. */
+#define EVENTS_SIZE 256
+
+/* Stream with comments, ignored fields, CRLF and multi-line data. */
+#define STREAM ": keep-alive\r\n" \
+               "event: command\r\n" \
+               "data: {\"a\":1}\r\n" \
+               "\r\n" \
+               "id: 7\n" \
+               "data:first\n" \
+               "data\n" \
+               "data:  last\n" \
+               "\n" \
+               "retry: 1000\n" \
+               "\n"
+/* Events of STREAM, each one in brackets. */
+#define STREAM_EVENTS "<{\"a\":1}><first\n\n last>"
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Events received so far. */
+typedef struct
+{
+    char text[EVENTS_SIZE];     //Events, each one in brackets.
+    size_t len;                 //Length of the text.
+} testEvents;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Parser callback storing the events.
+ *
+ * \param  part - part of the event.
+ * \param  pData - piece of the data.
+ * \param  len - length of the piece.
+ * \param  pContext - received events.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testEventPart(eventStreamPart part, const char* pData, size_t len, void* pContext)
+{
+    testEvents* pEvents = (testEvents*)pContext;
+
+    if (part == eventStreamBegin)
+    {
+        pData = "<";
+        len = 1;
+    }
+    else if (part == eventStreamEnd)
+    {
+        pData = ">";
+        len = 1;
+    }
+    if (pEvents->len + len < EVENTS_SIZE)
+    {
+        memcpy(pEvents->text + pEvents->len, pData, len);
+        pEvents->len += len;
+        pEvents->text[pEvents->len] = '\0';
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing a stream split into two chunks.
+ *
+ * \param  pText - stream.
+ * \param  split - end of the first chunk.
+ * \param  pEvents - where the events are stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void parseSplit(const char* pText, size_t split, testEvents* pEvents)
+{
+    eventStream stream;
+
+    pEvents->text[0] = '\0';
+    pEvents->len = 0;
+    eventStreamInit(&stream, testEventPart, pEvents);
+    eventStreamFeed(&stream, pText, split);
+    eventStreamFeed(&stream, pText + split, strlen(pText) - split);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Two chunks split at every position give the same events,
+ *         a CRLF split between the chunks included.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testEverySplit(void)
+{
+    testEvents events;
+    size_t split = 0;
+
+    for (split = 0; split <= strlen(STREAM); split++)
+    {
+        parseSplit(STREAM, split, &events);
+        TEST_ASSERT_EQUAL_STRING(STREAM_EVENTS, events.text);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  An event is dispatched only by the blank line after it.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testUnfinishedEvent(void)
+{
+    testEvents events;
+
+    parseSplit("data: 1\n\ndata: 2\n", 0, &events);
+    TEST_ASSERT_EQUAL_STRING("<1><2", events.text);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Fields which only begin like "data" are not data.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testLongFieldNames(void)
+{
+    testEvents events;
+
+    parseSplit("datax: 1\ndataxxxxxxxxxxxx: 2\ndat: 3\n\n", 0, &events);
+    TEST_ASSERT_EQUAL_STRING("", events.text);
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the Server-Sent Events parser.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testEventStream(void)
+{
+    RUN_TEST(testEverySplit);
+    RUN_TEST(testUnfinishedEvent);
+    RUN_TEST(testLongFieldNames);
+}
@@ -0,0 +1,309 @@
+/*********************************************************************/
+/*!
+*   \file   test_filter.c
+*
+*   \brief  Tests of the sensor filter chain.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "filter.h"
+#include "test_main.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Samples compared against the reference median. */
+#define MEDIAN_SAMPLES 500
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Ordering of samples for qsort().
+ *
+ * \param  pA - first sample.
+ * \param  pB - second sample.
+ *
+ * \return Difference of the samples.
+ *
+ */
+/*********************************************************************/
+static int compareSamples(const void* pA, const void* pB)
+{
+    return (int)*(const uint16_t*)pA - (int)*(const uint16_t*)pB;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Median of the last samples, sorted from scratch.
+ *
+ * \param  pSamples - samples, the newest one last.
+ * \param  count - number of samples.
+ * \param  window - window size.
+ *
+ * \return Median as the running median reports it.
+ *
+ */
+/*********************************************************************/
+static uint16_t referenceMedian(const uint16_t* pSamples, size_t count, uint8_t window)
+{
+    uint16_t sorted[FILTER_MAX_WINDOW];
+    size_t len = (count < window) ? count : window;
+
+    memcpy(sorted, pSamples + count - len, len * sizeof(uint16_t));
+    qsort(sorted, len, sizeof(uint16_t), compareSamples);
+    return sorted[len / 2];
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The running median matches a full sort for every window size,
+ *         repeated values included.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testMedianMatchesReference(void)
+{
+    static uint16_t samples[MEDIAN_SAMPLES];
+    filterChain chain;
+    uint32_t seed = 1;
+    uint8_t window = 0;
+    size_t i = 0;
+
+    for (i = 0; i < MEDIAN_SAMPLES; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        /* A narrow range gives many equal samples. */
+        samples[i] = (seed >> 16) % 32;
+    }
+
+    for (window = 1; window <= FILTER_MAX_WINDOW; window++)
+    {
+        filterChainInit(&chain);
+        TEST_ASSERT_TRUE(filterAddMedian(&chain, window));
+        for (i = 0; i < MEDIAN_SAMPLES; i++)
+        {
+            TEST_ASSERT_EQUAL_UINT16(referenceMedian(samples, i + 1, window), filterChainApply(&chain, samples[i]));
+        }
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The median removes a single spike.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testMedianSpike(void)
+{
+    static const uint16_t samples[] = { 100, 100, 100, 900, 100, 100 };
+    filterChain chain;
+    size_t i = 0;
+
+    filterChainInit(&chain);
+    filterAddMedian(&chain, 5);
+    for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++)
+    {
+        TEST_ASSERT_EQUAL_UINT16(100, filterChainApply(&chain, samples[i]));
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The trimmed mean drops the extremes, also while it fills up.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testTrimmedMean(void)
+{
+    filterChain chain;
+
+    filterChainInit(&chain);
+    TEST_ASSERT_TRUE(filterAddTrimmedMean(&chain, 5, 1));
+    TEST_ASSERT_EQUAL_UINT16(10, filterChainApply(&chain, 10));
+    TEST_ASSERT_EQUAL_UINT16(15, filterChainApply(&chain, 20));
+    TEST_ASSERT_EQUAL_UINT16(20, filterChainApply(&chain, 30));
+    TEST_ASSERT_EQUAL_UINT16(25, filterChainApply(&chain, 40));
+    TEST_ASSERT_EQUAL_UINT16(30, filterChainApply(&chain, 1000));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The moving average starts at the first sample and moves
+ *         by alpha / 256 of every change.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testEma(void)
+{
+    filterChain chain;
+
+    filterChainInit(&chain);
+    TEST_ASSERT_TRUE(filterAddEma(&chain, 128));
+    TEST_ASSERT_EQUAL_UINT16(100, filterChainApply(&chain, 100));
+    TEST_ASSERT_EQUAL_UINT16(150, filterChainApply(&chain, 200));
+    TEST_ASSERT_EQUAL_UINT16(175, filterChainApply(&chain, 200));
+    TEST_ASSERT_EQUAL_UINT16(88, filterChainApply(&chain, 0));
+
+    filterChainInit(&chain);
+    filterAddEma(&chain, 256);
+    TEST_ASSERT_EQUAL_UINT16(2047, filterChainApply(&chain, 2047));
+    TEST_ASSERT_EQUAL_UINT16(0, filterChainApply(&chain, 0));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Full-scale steps of the moving average do not overflow.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testEmaFullScale(void)
+{
+    filterChain chain;
+
+    filterChainInit(&chain);
+    filterAddEma(&chain, 256);
+    TEST_ASSERT_EQUAL_UINT16(0, filterChainApply(&chain, 0));
+    TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, filterChainApply(&chain, UINT16_MAX));
+    TEST_ASSERT_EQUAL_UINT16(0, filterChainApply(&chain, 0));
+
+    filterChainInit(&chain);
+    filterAddEma(&chain, 255);
+    TEST_ASSERT_EQUAL_UINT16(0, filterChainApply(&chain, 0));
+    TEST_ASSERT_EQUAL_UINT16(65279, filterChainApply(&chain, UINT16_MAX));
+    TEST_ASSERT_EQUAL_UINT16(255, filterChainApply(&chain, 0));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The rate limit holds the value on jumps and accepts a new
+ *         level after maxRejects samples.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testRateLimit(void)
+{
+    filterChain chain;
+
+    filterChainInit(&chain);
+    TEST_ASSERT_TRUE(filterAddRateLimit(&chain, 50, 2));
+    TEST_ASSERT_EQUAL_UINT16(100, filterChainApply(&chain, 100));
+    TEST_ASSERT_EQUAL_UINT16(140, filterChainApply(&chain, 140));
+    TEST_ASSERT_EQUAL_UINT16(140, filterChainApply(&chain, 400));
+    TEST_ASSERT_EQUAL_UINT16(140, filterChainApply(&chain, 400));
+    TEST_ASSERT_EQUAL_UINT16(400, filterChainApply(&chain, 400));
+    TEST_ASSERT_EQUAL_UINT16(360, filterChainApply(&chain, 360));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Invalid filters and a full chain are refused.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testLimits(void)
+{
+    filterChain chain;
+    uint8_t i = 0;
+
+    filterChainInit(&chain);
+    TEST_ASSERT_FALSE(filterAddMedian(&chain, 0));
+    TEST_ASSERT_FALSE(filterAddMedian(&chain, FILTER_MAX_WINDOW + 1));
+    TEST_ASSERT_FALSE(filterAddTrimmedMean(&chain, 4, 2));
+    TEST_ASSERT_FALSE(filterAddEma(&chain, 0));
+    TEST_ASSERT_FALSE(filterAddEma(&chain, 257));
+    TEST_ASSERT_EQUAL_UINT8(0, chain.count);
+
+    for (i = 0; i < FILTER_MAX_STAGES; i++)
+    {
+        TEST_ASSERT_TRUE(filterAddEma(&chain, 256));
+    }
+    TEST_ASSERT_FALSE(filterAddMedian(&chain, 3));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  A reset chain starts over from the next sample.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testReset(void)
+{
+    filterChain chain;
+
+    filterChainInit(&chain);
+    filterAddRateLimit(&chain, 50, 3);
+    filterAddMedian(&chain, 3);
+    filterAddEma(&chain, 64);
+    filterChainApply(&chain, 100);
+    filterChainApply(&chain, 120);
+
+    filterChainReset(&chain);
+    TEST_ASSERT_EQUAL_UINT16(1500, filterChainApply(&chain, 1500));
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the sensor filter chain.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testFilter(void)
+{
+    RUN_TEST(testMedianMatchesReference);
+    RUN_TEST(testMedianSpike);
+    RUN_TEST(testTrimmedMean);
+    RUN_TEST(testEma);
+    RUN_TEST(testEmaFullScale);
+    RUN_TEST(testRateLimit);
+    RUN_TEST(testLimits);
+    RUN_TEST(testReset);
+}
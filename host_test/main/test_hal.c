@@ -0,0 +1,82 @@
+/*********************************************************************/
+/*!
+*   \file   test_hal.c
+*
+*   \brief  Tests of the simulated hardware.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "unity.h"
+
+#include "hal.h"
+#include "test_main.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Value written before the deep sleep. */
+#define PATTERN 0x5AA5F00Du
+/* Simulated deep sleep [ms]. */
+#define SLEEP_MS 60000
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+HAL_RETAINED static uint32_t retainedValue;
+HAL_RETAINED static int64_t sleepStartUs;
+static uint32_t plainValue;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Deep sleep restarts the process, the retained variables
+ *         keep their values, the others start from zero and the
+ *         clock includes the sleep.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testDeepSleepResume(void)
+{
+    if (!halWokeFromDeepSleep())
+    {
+        retainedValue = PATTERN;
+        plainValue = PATTERN;
+        sleepStartUs = halClockUs();
+        halDeepSleep(SLEEP_MS);
+        TEST_ASSERT_TRUE_MESSAGE(false, "Deep sleep returned without a restart");
+        return;
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(PATTERN, retainedValue);
+    TEST_ASSERT_EQUAL_UINT32(0, plainValue);
+    TEST_ASSERT_GREATER_OR_EQUAL(sleepStartUs + SLEEP_MS * 1000LL, halClockUs());
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the simulated hardware. The process
+ *         restarts once, so they run before all other tests.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testHal(void)
+{
+    RUN_TEST(testDeepSleepResume);
+}
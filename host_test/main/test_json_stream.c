@@ -0,0 +1,333 @@
+/*********************************************************************/
+/*!
+*   \file   test_json_stream.c
+*
+*   \brief  Tests of the streaming JSON parser and its number conversions.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+#include "json_stream.h"
+#include "test_log.h"
+#include "test_main.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Document with every kind of value, nested containers and an escape. */
+#define DOCUMENT "{\"a\":{\"b\":[1,22,{\"c\":\"x\\\"y\"}]},\"n\":-12.5e1,\"t\":true,\"f\":false,\"z\":null}"
+/* Values of DOCUMENT reported by the parser. */
+#define DOCUMENT_LOG ".a.b[0]=1;.a.b[1]=22;.a.b[2].c=\"x\"y\";.n=-12.5e1;.t=true;.f=false;.z=null;"
+
+/* Longest time of a conversion with an extreme exponent [s]. */
+#define CONVERSION_MAX_S 0.1
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Parsing a document split into the given chunks.
+ *
+ * \param  pDocument - document.
+ * \param  pSplits - ends of the chunks but the last, ascending.
+ * \param  splitCount - number of the splits.
+ * \param  pLog - where the values are logged.
+ *
+ * \return True if the document was complete and valid.
+ *
+ */
+/*********************************************************************/
+static bool parseSplit(const char* pDocument, const size_t* pSplits, size_t splitCount, testLog* pLog)
+{
+    jsonStream stream;
+    size_t len = strlen(pDocument);
+    size_t start = 0;
+    size_t i = 0;
+
+    testLogClear(pLog);
+    jsonStreamInit(&stream, testLogValue, pLog);
+    for (i = 0; i <= splitCount; i++)
+    {
+        size_t end = (i < splitCount) ? pSplits[i] : len;
+
+        jsonStreamFeed(&stream, pDocument + start, end - start);
+        start = end;
+    }
+    return jsonStreamFinish(&stream);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing a whole document in one chunk.
+ *
+ * \param  pDocument - document.
+ * \param  pLog - where the values are logged.
+ *
+ * \return True if the document was complete and valid.
+ *
+ */
+/*********************************************************************/
+static bool parse(const char* pDocument, testLog* pLog)
+{
+    return parseSplit(pDocument, NULL, 0, pLog);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  A document in one chunk reports every value with its path.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testWholeDocument(void)
+{
+    testLog log;
+
+    TEST_ASSERT_TRUE(parse(DOCUMENT, &log));
+    TEST_ASSERT_EQUAL_STRING(DOCUMENT_LOG, log.text);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Two chunks split at every position give the same values.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testEverySplit(void)
+{
+    testLog log;
+    size_t split = 0;
+
+    for (split = 0; split <= strlen(DOCUMENT); split++)
+    {
+        TEST_ASSERT_TRUE(parseSplit(DOCUMENT, &split, 1, &log));
+        TEST_ASSERT_EQUAL_STRING(DOCUMENT_LOG, log.text);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  One byte per chunk gives the same values.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testByteChunks(void)
+{
+    size_t splits[sizeof(DOCUMENT)];
+    testLog log;
+    size_t i = 0;
+
+    for (i = 0; i < strlen(DOCUMENT) - 1; i++)
+    {
+        splits[i] = i + 1;
+    }
+    TEST_ASSERT_TRUE(parseSplit(DOCUMENT, splits, strlen(DOCUMENT) - 1, &log));
+    TEST_ASSERT_EQUAL_STRING(DOCUMENT_LOG, log.text);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Broken documents are not reported as complete.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testMalformed(void)
+{
+    static const char* const documents[] =
+    {
+        "",
+        "{\"a\":1,}",
+        "{\"a\" 1}",
+        "[1,2",
+        "[1 2]",
+        "[1,]",
+        "}",
+        "{1:2}",
+        "{\"a\":tru}",
+        "[nul]",
+        "{\"a\":1}}",
+        "{\"a\":1} x",
+        "{\"a\":\"open",
+    };
+    testLog log;
+    size_t i = 0;
+
+    for (i = 0; i < sizeof(documents) / sizeof(documents[0]); i++)
+    {
+        TEST_ASSERT_FALSE_MESSAGE(parse(documents[i], &log), documents[i]);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Nesting up to JSON_STREAM_MAX_DEPTH is parsed, deeper is rejected.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testDepth(void)
+{
+    testLog log;
+
+    TEST_ASSERT_TRUE(parse("[[[[[[1]]]]]]", &log));
+    TEST_ASSERT_EQUAL_STRING("[0][0][0][0][0][0]=1;", log.text);
+    TEST_ASSERT_FALSE(parse("[[[[[[[1]]]]]]]", &log));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Long keys and values are truncated to JSON_STREAM_MAX_TOKEN.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testLongTokens(void)
+{
+    testLog log;
+
+    TEST_ASSERT_TRUE(parse("{\"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\":\"bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb\","
+                           "\"n\":123456789012345678901234567890123456789}", &log));
+    TEST_ASSERT_EQUAL_STRING(".aaaaaaaaaaaaaaaaaaaaaaa=\"bbbbbbbbbbbbbbbbbbbbbbb\";.n=12345678901234567890123;", log.text);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Integers are converted to int32_t.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testToInt(void)
+{
+    TEST_ASSERT_EQUAL_INT32(0, jsonStreamToInt("0"));
+    TEST_ASSERT_EQUAL_INT32(0, jsonStreamToInt("-0"));
+    TEST_ASSERT_EQUAL_INT32(120, jsonStreamToInt("120"));
+    TEST_ASSERT_EQUAL_INT32(-45, jsonStreamToInt("-45"));
+    TEST_ASSERT_EQUAL_INT32(12, jsonStreamToInt("12.9"));
+    TEST_ASSERT_EQUAL_INT32(1, jsonStreamToInt("1e9"));
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, jsonStreamToInt("2147483647"));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Integers out of the int32_t range saturate.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testToIntSaturation(void)
+{
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, jsonStreamToInt("2147483648"));
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, jsonStreamToInt("4294967296"));
+    TEST_ASSERT_EQUAL_INT32(INT32_MIN, jsonStreamToInt("-2147483648"));
+    TEST_ASSERT_EQUAL_INT32(INT32_MIN, jsonStreamToInt("-2147483649"));
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, jsonStreamToInt("99999999999999999999999"));
+    TEST_ASSERT_EQUAL_INT32(INT32_MIN, jsonStreamToInt("-99999999999999999999999"));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Floats with fractions and exponents are converted.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testToFloat(void)
+{
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, jsonStreamToFloat("0"));
+    TEST_ASSERT_EQUAL_FLOAT(42.5f, jsonStreamToFloat("42.5"));
+    TEST_ASSERT_EQUAL_FLOAT(-0.025f, jsonStreamToFloat("-2.5E-2"));
+    TEST_ASSERT_EQUAL_FLOAT(1500.0f, jsonStreamToFloat("1.5e3"));
+    TEST_ASSERT_EQUAL_FLOAT(100.0f, jsonStreamToFloat("1e+2"));
+    TEST_ASSERT_EQUAL_FLOAT(1e38f, jsonStreamToFloat("1e38"));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Extreme exponents saturate at once instead of looping
+ *         once per unit of the exponent.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testExtremeExponents(void)
+{
+    clock_t start = clock();
+
+    TEST_ASSERT_FLOAT_IS_INF(jsonStreamToFloat("1e2000000000"));
+    TEST_ASSERT_FLOAT_IS_NEG_INF(jsonStreamToFloat("-1e99999999999999999999"));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, jsonStreamToFloat("1e-2000000000"));
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, jsonStreamToFloat("0e2000000000"));
+    TEST_ASSERT_FLOAT_IS_INF(jsonStreamToFloat("1e39"));
+    TEST_ASSERT_FLOAT_IS_INF(jsonStreamToFloat("123456789012345678901234567890123456789012345"));
+    TEST_ASSERT_TRUE((double)(clock() - start) / CLOCKS_PER_SEC < CONVERSION_MAX_S);
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the streaming JSON parser.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testJsonStream(void)
+{
+    RUN_TEST(testWholeDocument);
+    RUN_TEST(testEverySplit);
+    RUN_TEST(testByteChunks);
+    RUN_TEST(testMalformed);
+    RUN_TEST(testDepth);
+    RUN_TEST(testLongTokens);
+    RUN_TEST(testToInt);
+    RUN_TEST(testToIntSaturation);
+    RUN_TEST(testToFloat);
+    RUN_TEST(testExtremeExponents);
+}
@@ -0,0 +1,112 @@
+/*********************************************************************/
+/*!
+*   \file   test_log.c
+*
+*   \brief  Text log of the values reported by the streaming parsers,
+*           compared as a whole by the tests.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdio.h>
+
+#include "test_log.h"
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Appending formatted text, the log is cut when it is full.
+ *
+ * \param  pLog - log.
+ * \param  pText - text.
+ * \param  pPrefix - text before it.
+ * \param  pSuffix - text after it.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testLogPut(testLog* pLog, const char* pPrefix, const char* pText, const char* pSuffix)
+{
+    int len = snprintf(pLog->text + pLog->len, TEST_LOG_SIZE - pLog->len, "%s%s%s", pPrefix, pText, pSuffix);
+
+    if (len > 0)
+    {
+        pLog->len += ((size_t)len < TEST_LOG_SIZE - pLog->len) ? (size_t)len : TEST_LOG_SIZE - 1 - pLog->len;
+    }
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Emptying the log.
+ *
+ * \param  pLog - log.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testLogClear(testLog* pLog)
+{
+    pLog->text[0] = '\0';
+    pLog->len = 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parser callback appending the path and the value.
+ *         Strings are quoted, numbers and literals are kept as they are.
+ *
+ * \param  pStream - parser context.
+ * \param  type - type of the value.
+ * \param  pValue - value token.
+ * \param  pContext - log.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testLogValue(const jsonStream* pStream, jsonValueType type, const char* pValue, void* pContext)
+{
+    testLog* pLog = (testLog*)pContext;
+    char index[8];
+    uint8_t level = 0;
+
+    for (level = 0; level < pStream->depth; level++)
+    {
+        if (pStream->levels[level].isArray)
+        {
+            snprintf(index, sizeof(index), "%u", (unsigned)pStream->levels[level].index);
+            testLogPut(pLog, "[", index, "]");
+        }
+        else
+        {
+            testLogPut(pLog, ".", pStream->levels[level].key, "");
+        }
+    }
+
+    switch (type)
+    {
+    case jsonString:
+        testLogPut(pLog, "=\"", pValue, "\";");
+        break;
+    case jsonTrue:
+        testLogPut(pLog, "=", "true", ";");
+        break;
+    case jsonFalse:
+        testLogPut(pLog, "=", "false", ";");
+        break;
+    case jsonNull:
+        testLogPut(pLog, "=", "null", ";");
+        break;
+    default:
+        testLogPut(pLog, "=", pValue, ";");
+        break;
+    }
+}
@@ -0,0 +1,67 @@
+/*********************************************************************/
+/*!
+*   \file   test_log.h
+*
+*   \brief  Text log of the values reported by the streaming parsers,
+*           compared as a whole by the tests.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef TEST_LOG_H
+#define TEST_LOG_H
+
+#include <stddef.h>
+
+#include "json_stream.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Size of the log text. */
+#define TEST_LOG_SIZE 512
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Values reported so far, one "path=value;" entry each. */
+typedef struct
+{
+    char text[TEST_LOG_SIZE];   //Log text, NUL-terminated.
+    size_t len;                 //Length of the text.
+} testLog;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Emptying the log.
+ *
+ * \param  pLog - log.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testLogClear(testLog* pLog);
+
+/*********************************************************************/
+/*!
+ * \brief  Parser callback appending the path and the value.
+ *         Strings are quoted, numbers and literals are kept as they are.
+ *
+ * \param  pStream - parser context.
+ * \param  type - type of the value.
+ * \param  pValue - value token.
+ * \param  pContext - log.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testLogValue(const jsonStream* pStream, jsonValueType type, const char* pValue, void* pContext);
+
+#endif /*TEST_LOG_H*/
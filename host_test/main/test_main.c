@@ -0,0 +1,67 @@
+/*********************************************************************/
+/*!
+*   \file   test_main.c
+*
+*   \brief  Host unit tests of the platform-independent modules.
+*
+*           The modules are built from the firmware sources as they
+*           are, the tests only feed them data and check the results.
+*           The process exits with the number of failed tests.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdlib.h>
+
+#include "unity.h"
+
+#include "test_main.h"
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Called by Unity before every test.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void setUp(void)
+{
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Called by Unity after every test.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void tearDown(void)
+{
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+
+    /* Deep sleep restarts the process, nothing may run before it. */
+    testHal();
+    testJsonStream();
+    testFilter();
+    testEventStream();
+    testCborStream();
+    testBackoff();
+    testSchedule();
+    testController();
+
+    exit(UNITY_END());
+}
@@ -0,0 +1,114 @@
+/*********************************************************************/
+/*!
+*   \file   test_main.h
+*
+*   \brief  Groups of the host unit tests, one per tested module.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef TEST_MAIN_H
+#define TEST_MAIN_H
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the simulated hardware. The process
+ *         restarts once, so they run before all other tests.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testHal(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the streaming JSON parser.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testJsonStream(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the sensor filter chain.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testFilter(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the Server-Sent Events parser.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testEventStream(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the streaming CBOR parser.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testCborStream(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the retry backoff.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testBackoff(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the watering schedule, in UTC.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testSchedule(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the moisture controller.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testController(void);
+
+#endif /*TEST_MAIN_H*/
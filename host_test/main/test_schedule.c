@@ -0,0 +1,263 @@
+/*********************************************************************/
+/*!
+*   \file   test_schedule.c
+*
+*   \brief  Tests of the watering schedule windows.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "unity.h"
+
+#include "schedule.h"
+#include "test_main.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Sunday, 7 January 2024, 00:00 UTC. */
+#define SUNDAY ((time_t)1704585600)
+#define MINUTE ((time_t)60)
+#define HOUR (60 * MINUTE)
+#define DAY (24 * HOUR)
+
+/* Days of the week masks. */
+#define DAY_SUNDAY 0x01
+#define DAY_MONDAY 0x02
+#define DAY_SATURDAY 0x40
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing a valid schedule with one program and one window.
+ *
+ * \param  pTable - schedule.
+ * \param  days - days of the window.
+ * \param  hour - start hour of the window.
+ * \param  minute - start minute of the window.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void scheduleOne(scheduleTable* pTable, uint8_t days, uint8_t hour, uint8_t minute)
+{
+    memset(pTable, 0, sizeof(*pTable));
+    pTable->programs[0].phases[0].valveOpen = true;
+    pTable->programs[0].phases[0].durationMs = 60000;
+    pTable->programs[0].phaseCount = 1;
+    pTable->programCount = 1;
+    pTable->windows[0].days = days;
+    pTable->windows[0].hour = hour;
+    pTable->windows[0].minute = minute;
+    pTable->windows[0].program = 0;
+    pTable->windowCount = 1;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Times at the edges of their ranges are accepted, one past
+ *         them is rejected, as are missing programs and phases.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testValid(void)
+{
+    scheduleTable table;
+
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 23, 59);
+    TEST_ASSERT_TRUE(scheduleValid(&table));
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 24, 0);
+    TEST_ASSERT_FALSE(scheduleValid(&table));
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 0, 60);
+    TEST_ASSERT_FALSE(scheduleValid(&table));
+
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 0, 0);
+    table.windows[0].program = 1;
+    TEST_ASSERT_FALSE(scheduleValid(&table));
+
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 0, 0);
+    table.programs[0].phaseCount = 0;
+    TEST_ASSERT_FALSE(scheduleValid(&table));
+
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 0, 0);
+    table.windowCount = SCHEDULE_MAX_WINDOWS + 1;
+    TEST_ASSERT_FALSE(scheduleValid(&table));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Phases last 1 ms to SCHEDULE_MAX_PHASE_MS and the days use
+ *         only the seven bits of the week.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testPhaseLimits(void)
+{
+    scheduleTable table;
+
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 0, 0);
+    table.programs[0].phases[0].durationMs = 1;
+    TEST_ASSERT_TRUE(scheduleValid(&table));
+    table.programs[0].phases[0].durationMs = SCHEDULE_MAX_PHASE_MS;
+    TEST_ASSERT_TRUE(scheduleValid(&table));
+    table.programs[0].phases[0].durationMs = SCHEDULE_MAX_PHASE_MS + 1;
+    TEST_ASSERT_FALSE(scheduleValid(&table));
+    table.programs[0].phases[0].durationMs = 0;
+    TEST_ASSERT_FALSE(scheduleValid(&table));
+
+    scheduleOne(&table, SCHEDULE_EVERY_DAY + 1, 0, 0);
+    TEST_ASSERT_FALSE(scheduleValid(&table));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  A window starting exactly now is due, one starting exactly
+ *         at since was already handled.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testDueEdges(void)
+{
+    scheduleTable table;
+    time_t start = SUNDAY + 6 * HOUR;
+    uint8_t window = 0xFF;
+
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 6, 0);
+    TEST_ASSERT_EQUAL_INT64(start, scheduleDue(&table, start - MINUTE, start, &window));
+    TEST_ASSERT_EQUAL_UINT8(0, window);
+    TEST_ASSERT_EQUAL_INT64(0, scheduleDue(&table, start, start + MINUTE, &window));
+    TEST_ASSERT_EQUAL_INT64(0, scheduleDue(&table, start - 2 * MINUTE, start - 1, &window));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  A window of yesterday evening is found after midnight, on
+ *         yesterday's day of the week.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testDueAcrossMidnight(void)
+{
+    scheduleTable table;
+    time_t now = SUNDAY + 10 * MINUTE;
+    uint8_t window = 0xFF;
+
+    scheduleOne(&table, DAY_SATURDAY, 23, 50);
+    TEST_ASSERT_EQUAL_INT64(SUNDAY - 10 * MINUTE, scheduleDue(&table, now - HOUR, now, &window));
+    TEST_ASSERT_EQUAL_UINT8(0, window);
+
+    table.windows[0].days = DAY_SUNDAY;
+    TEST_ASSERT_EQUAL_INT64(0, scheduleDue(&table, now - HOUR, now, &window));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Of several due windows the latest one is reported and the
+ *         days of the week are respected.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testDueLatest(void)
+{
+    scheduleTable table;
+    time_t now = SUNDAY + 7 * HOUR;
+    uint8_t window = 0xFF;
+
+    scheduleOne(&table, SCHEDULE_EVERY_DAY, 5, 0);
+    table.windows[1] = table.windows[0];
+    table.windows[1].hour = 6;
+    table.windows[2] = table.windows[0];
+    table.windows[2].hour = 6;
+    table.windows[2].minute = 30;
+    table.windows[2].days = DAY_MONDAY;
+    table.windowCount = 3;
+    TEST_ASSERT_TRUE(scheduleValid(&table));
+    TEST_ASSERT_EQUAL_INT64(SUNDAY + 6 * HOUR, scheduleDue(&table, now - 3 * HOUR, now, &window));
+    TEST_ASSERT_EQUAL_UINT8(1, window);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  The next start wraps around to the following week and a
+ *         window without days never starts.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void testNext(void)
+{
+    scheduleTable table;
+    time_t start = SUNDAY + 6 * HOUR;
+
+    scheduleOne(&table, DAY_SUNDAY, 6, 0);
+    TEST_ASSERT_EQUAL_INT64(start, scheduleNext(&table, start - 1));
+    TEST_ASSERT_EQUAL_INT64(start + 7 * DAY, scheduleNext(&table, start));
+
+    table.windows[1] = table.windows[0];
+    table.windows[1].days = DAY_MONDAY;
+    table.windowCount = 2;
+    TEST_ASSERT_EQUAL_INT64(start + DAY, scheduleNext(&table, start));
+
+    scheduleOne(&table, 0, 6, 0);
+    TEST_ASSERT_EQUAL_INT64(0, scheduleNext(&table, start));
+    table.windowCount = 0;
+    TEST_ASSERT_EQUAL_INT64(0, scheduleNext(&table, start));
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Running the tests of the watering schedule, in UTC.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void testSchedule(void)
+{
+    setenv("TZ", "UTC0", 1);
+    tzset();
+
+    RUN_TEST(testValid);
+    RUN_TEST(testPhaseLimits);
+    RUN_TEST(testDueEdges);
+    RUN_TEST(testDueAcrossMidnight);
+    RUN_TEST(testDueLatest);
+    RUN_TEST(testNext);
+}
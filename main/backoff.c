@@ -0,0 +1,72 @@
+/*********************************************************************/
+/*!
+*   \file   backoff.c
+*
+*   \brief  Jittered exponential backoff of reconnect attempts.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "backoff.h"
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the backoff state.
+ *
+ * \param  pBackoff - backoff state.
+ * \param  minDelay - first delay [ms].
+ * \param  maxDelay - longest delay [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void backoffInit(backoff* pBackoff, uint32_t minDelay, uint32_t maxDelay)
+{
+    pBackoff->minDelay = (minDelay > 0) ? minDelay : 1;
+    pBackoff->maxDelay = (maxDelay > pBackoff->minDelay) ? maxDelay : pBackoff->minDelay;
+    backoffReset(pBackoff);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting again from the first delay after a success.
+ *
+ * \param  pBackoff - backoff state.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void backoffReset(backoff* pBackoff)
+{
+    pBackoff->delay = pBackoff->minDelay;
+    pBackoff->attempts = 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Delay before the next attempt.
+ *
+ * \param  pBackoff - backoff state.
+ * \param  random - random number, e.g. from esp_random().
+ *
+ * \return Delay [ms].
+ *
+ */
+/*********************************************************************/
+uint32_t backoffNext(backoff* pBackoff, uint32_t random)
+{
+    uint32_t half = pBackoff->delay / 2;
+    uint32_t delay = pBackoff->delay - half + random % (half + 1);
+
+    pBackoff->attempts++;
+    /* Doubling stops at the longest delay, without an overflow. */
+    pBackoff->delay = (pBackoff->delay > pBackoff->maxDelay / 2) ? pBackoff->maxDelay : pBackoff->delay * 2;
+
+    return delay;
+}
\ No newline at end of file
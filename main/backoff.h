@@ -0,0 +1,74 @@
+/*********************************************************************/
+/*!
+*   \file   backoff.h
+*
+*   \brief  Jittered exponential backoff of reconnect attempts.
+*
+*           Every failed attempt doubles the delay up to the longest one.
+*           Each delay is drawn from its upper half, so boards which lost
+*           the link at the same moment do not retry together.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdint.h>
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Backoff state, no dynamic memory is used. */
+typedef struct
+{
+    uint32_t minDelay;      //First delay [ms].
+    uint32_t maxDelay;      //Longest delay [ms].
+    uint32_t delay;         //Upper bound of the next delay [ms].
+    uint32_t attempts;      //Attempts since the last success.
+} backoff;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the backoff state.
+ *
+ * \param  pBackoff - backoff state.
+ * \param  minDelay - first delay [ms].
+ * \param  maxDelay - longest delay [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void backoffInit(backoff* pBackoff, uint32_t minDelay, uint32_t maxDelay);
+
+/*********************************************************************/
+/*!
+ * \brief  Starting again from the first delay after a success.
+ *
+ * \param  pBackoff - backoff state.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void backoffReset(backoff* pBackoff);
+
+/*********************************************************************/
+/*!
+ * \brief  Delay before the next attempt.
+ *
+ * \param  pBackoff - backoff state.
+ * \param  random - random number, e.g. from esp_random().
+ *
+ * \return Delay [ms].
+ *
+ */
+/*********************************************************************/
+uint32_t backoffNext(backoff* pBackoff, uint32_t random);
+
+#endif /*BACKOFF_H*/
\ No newline at end of file
@@ -0,0 +1,563 @@
+/*********************************************************************/
+/*!
+*   \file   cbor_stream.c
+*
+*   \brief  Incremental CBOR (RFC 8949) parser working on body chunks.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cbor_stream.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Major types. */
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+/* Additional information of the simple values and floats. */
+#define CBOR_FALSE 20
+#define CBOR_TRUE 21
+#define CBOR_NULL 22
+#define CBOR_UNDEFINED 23
+#define CBOR_HALF 25
+#define CBOR_SINGLE 26
+#define CBOR_DOUBLE 27
+/* Indefinite length or break. */
+#define CBOR_BREAK 31
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Checking if the next item is a map key.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return True if a key is expected.
+ *
+ */
+/*********************************************************************/
+static bool keyExpected(const cborStream* pStream)
+{
+    uint8_t level = 0;
+
+    if (pStream->path.depth == 0)
+    {
+        return false;
+    }
+    level = pStream->path.depth - 1;
+
+    return !pStream->path.levels[level].isArray && (pStream->keyNext & (1 << level)) != 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Counting a complete item in the containers,
+ *         closing the ones which are full.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void itemDone(cborStream* pStream)
+{
+    uint8_t level = 0;
+
+    pStream->state = cborStateHead;
+    while (pStream->path.depth > 0)
+    {
+        level = pStream->path.depth - 1;
+        if (pStream->path.levels[level].isArray)
+        {
+            pStream->path.levels[level].index++;
+        }
+        else
+        {
+            /* Keys and values alternate. */
+            pStream->keyNext ^= (1 << level);
+        }
+
+        if (pStream->remaining[level] == CBOR_STREAM_INDEFINITE || --pStream->remaining[level] > 0)
+        {
+            return;
+        }
+        /* Full container is an item of its parent. */
+        pStream->path.depth--;
+    }
+
+    pStream->state = cborStateDone;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Passing a complete scalar in the token to the callback,
+ *         or storing it as the key of the map.
+ *
+ * \param  pStream - parser context.
+ * \param  type - type of the value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void scalarDone(cborStream* pStream, jsonValueType type)
+{
+    if (keyExpected(pStream))
+    {
+        memcpy(pStream->path.levels[pStream->path.depth - 1].key, pStream->path.token, pStream->path.tokenLen + 1);
+    }
+    else
+    {
+        pStream->path.callback(&pStream->path, type, pStream->path.token, pStream->path.pContext);
+    }
+    itemDone(pStream);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing an integer into the token.
+ *
+ * \param  pStream - parser context.
+ * \param  negative - the integer is negative.
+ * \param  magnitude - absolute value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void tokenInteger(cborStream* pStream, bool negative, uint64_t magnitude)
+{
+    char digits[20];
+    uint8_t count = 0;
+
+    pStream->path.tokenLen = 0;
+    if (negative)
+    {
+        pStream->path.token[pStream->path.tokenLen++] = '-';
+    }
+    do
+    {
+        digits[count++] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    while (count > 0 && pStream->path.tokenLen < JSON_STREAM_MAX_TOKEN - 1)
+    {
+        pStream->path.token[pStream->path.tokenLen++] = digits[--count];
+    }
+    pStream->path.token[pStream->path.tokenLen] = '\0';
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a text into the token.
+ *
+ * \param  pStream - parser context.
+ * \param  pText - text.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void tokenText(cborStream* pStream, const char* pText)
+{
+    int len = snprintf(pStream->path.token, JSON_STREAM_MAX_TOKEN, "%s", pText);
+
+    pStream->path.tokenLen = (len < JSON_STREAM_MAX_TOKEN) ? len : JSON_STREAM_MAX_TOKEN - 1;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Converting a half-precision float.
+ *
+ * \param  half - IEEE 754 binary16.
+ *
+ * \return Float value.
+ *
+ */
+/*********************************************************************/
+static float halfToFloat(uint16_t half)
+{
+    int exponent = (half >> 10) & 0x1F;
+    int mantissa = half & 0x3FF;
+    float value = 0.0f;
+
+    if (exponent == 0)
+    {
+        value = ldexpf(mantissa, -24);
+    }
+    else if (exponent != 31)
+    {
+        value = ldexpf(mantissa + 1024, exponent - 25);
+    }
+    else
+    {
+        value = (mantissa == 0) ? INFINITY : NAN;
+    }
+
+    return (half & 0x8000) ? -value : value;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Opening an array or a map.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void containerBegin(cborStream* pStream)
+{
+    uint8_t level = pStream->path.depth;
+    uint32_t count = CBOR_STREAM_INDEFINITE;
+
+    if (keyExpected(pStream) || level == JSON_STREAM_MAX_DEPTH ||
+        (pStream->info != CBOR_BREAK && pStream->argument >= CBOR_STREAM_INDEFINITE / 2))
+    {
+        pStream->state = cborStateError;
+        return;
+    }
+    if (pStream->info != CBOR_BREAK)
+    {
+        count = (uint32_t)pStream->argument * ((pStream->major == CBOR_MAP) ? 2 : 1);
+        if (count == 0)
+        {
+            itemDone(pStream);
+            return;
+        }
+    }
+
+    pStream->path.levels[level].isArray = (pStream->major == CBOR_ARRAY);
+    pStream->path.levels[level].index = 0;
+    pStream->path.levels[level].key[0] = '\0';
+    pStream->remaining[level] = count;
+    pStream->keyNext |= (1 << level);
+    pStream->path.depth++;
+    pStream->state = cborStateHead;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Closing an indefinite-length container.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void containerBreak(cborStream* pStream)
+{
+    uint8_t level = 0;
+
+    if (pStream->path.depth == 0)
+    {
+        pStream->state = cborStateError;
+        return;
+    }
+    level = pStream->path.depth - 1;
+
+    /* A map may not end between a key and its value. */
+    if (pStream->remaining[level] != CBOR_STREAM_INDEFINITE ||
+        (!pStream->path.levels[level].isArray && !keyExpected(pStream)))
+    {
+        pStream->state = cborStateError;
+        return;
+    }
+
+    pStream->path.depth--;
+    itemDone(pStream);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Handling a simple value or a float.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void simpleValue(cborStream* pStream)
+{
+    uint32_t bits = (uint32_t)pStream->argument;
+    double value = 0.0;
+    float single = 0.0f;
+
+    switch (pStream->info)
+    {
+    case CBOR_FALSE:
+        tokenText(pStream, "false");
+        scalarDone(pStream, jsonFalse);
+        return;
+    case CBOR_TRUE:
+        tokenText(pStream, "true");
+        scalarDone(pStream, jsonTrue);
+        return;
+    case CBOR_HALF:
+        value = halfToFloat((uint16_t)bits);
+        break;
+    case CBOR_SINGLE:
+        memcpy(&single, &bits, sizeof(single));
+        value = single;
+        break;
+    case CBOR_DOUBLE:
+        memcpy(&value, &pStream->argument, sizeof(value));
+        break;
+    case CBOR_BREAK:
+        containerBreak(pStream);
+        return;
+    default:
+        /* null, undefined and unassigned values. */
+        tokenText(pStream, "null");
+        scalarDone(pStream, jsonNull);
+        return;
+    }
+
+    pStream->path.tokenLen = snprintf(pStream->path.token, JSON_STREAM_MAX_TOKEN, "%.9g", value);
+    if (pStream->path.tokenLen >= JSON_STREAM_MAX_TOKEN)
+    {
+        pStream->path.tokenLen = JSON_STREAM_MAX_TOKEN - 1;
+    }
+    scalarDone(pStream, jsonNumber);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing a string.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void stringDone(cborStream* pStream)
+{
+    pStream->path.token[pStream->path.tokenLen] = '\0';
+    if (pStream->major == CBOR_TEXT)
+    {
+        scalarDone(pStream, jsonString);
+    }
+    else if (keyExpected(pStream))
+    {
+        /* Byte strings are skipped, but cannot be keys. */
+        pStream->state = cborStateError;
+    }
+    else
+    {
+        itemDone(pStream);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Handling an item once its head and argument were read.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void itemHead(cborStream* pStream)
+{
+    switch (pStream->major)
+    {
+    case CBOR_UNSIGNED:
+        tokenInteger(pStream, false, pStream->argument);
+        scalarDone(pStream, jsonNumber);
+        break;
+    case CBOR_NEGATIVE:
+        /* -1 - n, the magnitude of -2^64 does not fit and saturates. */
+        tokenInteger(pStream, true, (pStream->argument == UINT64_MAX) ? UINT64_MAX : pStream->argument + 1);
+        scalarDone(pStream, jsonNumber);
+        break;
+    case CBOR_BYTES:
+    case CBOR_TEXT:
+        if (pStream->info == CBOR_BREAK)
+        {
+            pStream->state = cborStateError;
+            break;
+        }
+        pStream->path.tokenLen = 0;
+        pStream->stringLeft = pStream->argument;
+        pStream->state = cborStateString;
+        if (pStream->stringLeft == 0)
+        {
+            stringDone(pStream);
+        }
+        break;
+    case CBOR_ARRAY:
+    case CBOR_MAP:
+        containerBegin(pStream);
+        break;
+    case CBOR_TAG:
+        /* Tags are ignored, the tagged item follows. */
+        pStream->state = cborStateHead;
+        break;
+    default:
+        simpleValue(pStream);
+        break;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the initial byte of an item.
+ *
+ * \param  pStream - parser context.
+ * \param  byte - initial byte.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void itemStart(cborStream* pStream, uint8_t byte)
+{
+    pStream->major = byte >> 5;
+    pStream->info = byte & 0x1F;
+    pStream->argument = pStream->info;
+
+    if (pStream->info < 24)
+    {
+        itemHead(pStream);
+    }
+    else if (pStream->info <= CBOR_DOUBLE)
+    {
+        /* 1, 2, 4 or 8 byte argument follows. */
+        pStream->argumentLeft = 1 << (pStream->info - 24);
+        pStream->argument = 0;
+        pStream->state = cborStateArgument;
+    }
+    else if (pStream->info == CBOR_BREAK && pStream->major != CBOR_UNSIGNED &&
+             pStream->major != CBOR_NEGATIVE && pStream->major != CBOR_TAG)
+    {
+        itemHead(pStream);
+    }
+    else
+    {
+        pStream->state = cborStateError;
+    }
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the parser for a new document.
+ *
+ * \param  pStream - parser context.
+ * \param  callback - function called for every value.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborStreamInit(cborStream* pStream, jsonStreamCallback callback, void* pContext)
+{
+    memset(pStream, 0, sizeof(*pStream));
+    jsonStreamInit(&pStream->path, callback, pContext);
+    pStream->state = cborStateHead;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the next chunk of the document.
+ *         Chunks may split items. Indefinite-length strings
+ *         are not supported.
+ *
+ * \param  pStream - parser context.
+ * \param  pData - chunk of the document.
+ * \param  len - length of the chunk.
+ *
+ * \return False if the document is not valid.
+ *
+ */
+/*********************************************************************/
+bool cborStreamFeed(cborStream* pStream, const uint8_t* pData, size_t len)
+{
+    size_t pos = 0;
+    size_t run = 0;
+    size_t copy = 0;
+
+    while (pos < len && pStream->state != cborStateError)
+    {
+        switch (pStream->state)
+        {
+        case cborStateHead:
+            itemStart(pStream, pData[pos++]);
+            break;
+        case cborStateArgument:
+            pStream->argument = (pStream->argument << 8) | pData[pos++];
+            if (--pStream->argumentLeft == 0)
+            {
+                itemHead(pStream);
+            }
+            break;
+        case cborStateString:
+            run = len - pos;
+            if (run > pStream->stringLeft)
+            {
+                run = (size_t)pStream->stringLeft;
+            }
+            /* Long strings are truncated like JSON tokens. */
+            copy = JSON_STREAM_MAX_TOKEN - 1 - pStream->path.tokenLen;
+            if (copy > run)
+            {
+                copy = run;
+            }
+            memcpy(pStream->path.token + pStream->path.tokenLen, pData + pos, copy);
+            pStream->path.tokenLen += copy;
+            pStream->stringLeft -= run;
+            pos += run;
+            if (pStream->stringLeft == 0)
+            {
+                stringDone(pStream);
+            }
+            break;
+        default:
+            /* Data after the end of the document. */
+            pStream->state = cborStateError;
+            break;
+        }
+    }
+
+    return pStream->state != cborStateError;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the document after the last chunk.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return True if a complete and valid document was parsed.
+ *
+ */
+/*********************************************************************/
+bool cborStreamFinish(cborStream* pStream)
+{
+    return pStream->state == cborStateDone;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+/*********************************************************************/
+/*!
+*   \file   cbor_stream.h
+*
+*   \brief  Incremental CBOR (RFC 8949) parser working on body chunks.
+*
+*           Values are reported through the callback of the JSON
+*           parser, with the same path, so one handler serves both
+*           encodings.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef CBOR_STREAM_H
+#define CBOR_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json_stream.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Container without a length, ended by a break. */
+#define CBOR_STREAM_INDEFINITE UINT32_MAX
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Internal state of the parser. */
+typedef enum
+{
+    cborStateHead,          //Expecting the initial byte of an item.
+    cborStateArgument,      //Inside of the argument of an item.
+    cborStateString,        //Inside of a string.
+    cborStateDone,          //Whole document parsed.
+    cborStateError,         //Document is not valid or not supported.
+} cborState;
+
+/* Parser context, no dynamic memory is used. */
+typedef struct
+{
+    jsonStream path;                                //Path to the current value, token and callback.
+    cborState state;                                //Current state.
+    uint8_t major;                                  //Major type of the item being read.
+    uint8_t info;                                   //Additional information of the item being read.
+    uint8_t argumentLeft;                           //Bytes of the argument still to read.
+    uint64_t argument;                              //Argument of the item being read.
+    uint64_t stringLeft;                            //Bytes of the string still to read.
+    uint8_t keyNext;                                //Bit per level, next map item is a key.
+    uint32_t remaining[JSON_STREAM_MAX_DEPTH];      //Items left in each container.
+} cborStream;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the parser for a new document.
+ *
+ * \param  pStream - parser context.
+ * \param  callback - function called for every value.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborStreamInit(cborStream* pStream, jsonStreamCallback callback, void* pContext);
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the next chunk of the document.
+ *         Chunks may split items. Indefinite-length strings
+ *         are not supported.
+ *
+ * \param  pStream - parser context.
+ * \param  pData - chunk of the document.
+ * \param  len - length of the chunk.
+ *
+ * \return False if the document is not valid.
+ *
+ */
+/*********************************************************************/
+bool cborStreamFeed(cborStream* pStream, const uint8_t* pData, size_t len);
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the document after the last chunk.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return True if a complete and valid document was parsed.
+ *
+ */
+/*********************************************************************/
+bool cborStreamFinish(cborStream* pStream);
+
+#endif /*CBOR_STREAM_H*/
\ No newline at end of file
@@ -0,0 +1,252 @@
+/*********************************************************************/
+/*!
+*   \file   cbor_writer.c
+*
+*   \brief  CBOR (RFC 8949) writer working on a caller-provided buffer.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <string.h>
+
+#include "cbor_writer.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Major types. */
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_SIMPLE 7
+
+/* Additional information of a single-precision float. */
+#define CBOR_SINGLE 26
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Appending bytes to the output.
+ *
+ * \param  pWriter - writer context.
+ * \param  pData - bytes.
+ * \param  len - number of bytes.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void writeBytes(cborWriter* pWriter, const void* pData, size_t len)
+{
+    if (pWriter->overflow || pWriter->size - pWriter->len < len)
+    {
+        pWriter->overflow = true;
+        return;
+    }
+    memcpy(pWriter->pBuffer + pWriter->len, pData, len);
+    pWriter->len += len;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing the head of an item with the shortest argument.
+ *
+ * \param  pWriter - writer context.
+ * \param  major - major type.
+ * \param  argument - argument (value, length or count).
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void writeHead(cborWriter* pWriter, uint8_t major, uint64_t argument)
+{
+    uint8_t head[9];
+    uint8_t bytes = 0;
+    uint8_t i = 0;
+
+    if (argument < 24)
+    {
+        head[0] = (major << 5) | (uint8_t)argument;
+    }
+    else
+    {
+        /* 1, 2, 4 or 8 byte argument, additional information 24 to 27. */
+        bytes = 1;
+        head[0] = (major << 5) | 24;
+        while (bytes < 8 && (argument >> (8 * bytes)) != 0)
+        {
+            bytes *= 2;
+            head[0]++;
+        }
+        for (i = 0; i < bytes; i++)
+        {
+            head[bytes - i] = (uint8_t)(argument >> (8 * i));
+        }
+    }
+    writeBytes(pWriter, head, bytes + 1);
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the writer.
+ *
+ * \param  pWriter - writer context.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriterInit(cborWriter* pWriter, uint8_t* pBuffer, size_t size)
+{
+    pWriter->pBuffer = pBuffer;
+    pWriter->size = size;
+    pWriter->len = 0;
+    pWriter->overflow = false;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Opening a map, the given number of key and value pairs
+ *         has to follow.
+ *
+ * \param  pWriter - writer context.
+ * \param  count - number of pairs.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteMapBegin(cborWriter* pWriter, size_t count)
+{
+    writeHead(pWriter, CBOR_MAP, count);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Opening an array, the given number of elements has to follow.
+ *
+ * \param  pWriter - writer context.
+ * \param  count - number of elements.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteArrayBegin(cborWriter* pWriter, size_t count)
+{
+    writeHead(pWriter, CBOR_ARRAY, count);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a text string.
+ *
+ * \param  pWriter - writer context.
+ * \param  pText - text (UTF-8).
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteText(cborWriter* pWriter, const char* pText)
+{
+    size_t len = strlen(pText);
+
+    writeHead(pWriter, CBOR_TEXT, len);
+    writeBytes(pWriter, pText, len);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing an integer in its shortest form.
+ *
+ * \param  pWriter - writer context.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteInt(cborWriter* pWriter, int64_t value)
+{
+    if (value < 0)
+    {
+        /* Negative integers are stored as -1 - n. */
+        writeHead(pWriter, CBOR_NEGATIVE, (uint64_t)(-(value + 1)));
+    }
+    else
+    {
+        writeHead(pWriter, CBOR_UNSIGNED, (uint64_t)value);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a single-precision float.
+ *
+ * \param  pWriter - writer context.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteFloat(cborWriter* pWriter, float value)
+{
+    uint8_t item[5];
+    uint32_t bits = 0;
+    uint8_t i = 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    item[0] = (CBOR_SIMPLE << 5) | CBOR_SINGLE;
+    for (i = 0; i < 4; i++)
+    {
+        item[4 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    writeBytes(pWriter, item, sizeof(item));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a map member with a text key and an integer value.
+ *
+ * \param  pWriter - writer context.
+ * \param  pKey - key.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteMemberInt(cborWriter* pWriter, const char* pKey, int64_t value)
+{
+    cborWriteText(pWriter, pKey);
+    cborWriteInt(pWriter, value);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the output.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return Length of the output, -1 if it did not fit.
+ *
+ */
+/*********************************************************************/
+int cborWriterFinish(cborWriter* pWriter)
+{
+    return pWriter->overflow ? -1 : (int)pWriter->len;
+}
\ No newline at end of file
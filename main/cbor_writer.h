@@ -0,0 +1,139 @@
+/*********************************************************************/
+/*!
+*   \file   cbor_writer.h
+*
+*   \brief  CBOR (RFC 8949) writer working on a caller-provided buffer.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Writer context, no dynamic memory is used. */
+typedef struct
+{
+    uint8_t* pBuffer;   //Output buffer.
+    size_t size;        //Size of the output buffer.
+    size_t len;         //Number of bytes written.
+    bool overflow;      //Output did not fit into the buffer.
+} cborWriter;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the writer.
+ *
+ * \param  pWriter - writer context.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriterInit(cborWriter* pWriter, uint8_t* pBuffer, size_t size);
+
+/*********************************************************************/
+/*!
+ * \brief  Opening a map, the given number of key and value pairs
+ *         has to follow.
+ *
+ * \param  pWriter - writer context.
+ * \param  count - number of pairs.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteMapBegin(cborWriter* pWriter, size_t count);
+
+/*********************************************************************/
+/*!
+ * \brief  Opening an array, the given number of elements has to follow.
+ *
+ * \param  pWriter - writer context.
+ * \param  count - number of elements.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteArrayBegin(cborWriter* pWriter, size_t count);
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a text string.
+ *
+ * \param  pWriter - writer context.
+ * \param  pText - text (UTF-8).
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteText(cborWriter* pWriter, const char* pText);
+
+/*********************************************************************/
+/*!
+ * \brief  Writing an integer in its shortest form.
+ *
+ * \param  pWriter - writer context.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteInt(cborWriter* pWriter, int64_t value);
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a single-precision float.
+ *
+ * \param  pWriter - writer context.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteFloat(cborWriter* pWriter, float value);
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a map member with a text key and an integer value.
+ *
+ * \param  pWriter - writer context.
+ * \param  pKey - key.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void cborWriteMemberInt(cborWriter* pWriter, const char* pKey, int64_t value);
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the output.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return Length of the output, -1 if it did not fit.
+ *
+ */
+/*********************************************************************/
+int cborWriterFinish(cborWriter* pWriter);
+
+#endif /*CBOR_WRITER_H*/
\ No newline at end of file
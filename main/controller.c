@@ -0,0 +1,85 @@
+/*********************************************************************/
+/*!
+*   \file   controller.c
+*
+*   \brief  Closed-loop moisture control with hysteresis.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "controller.h"
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the controller, the valve starts closed
+ *         without a soak time.
+ *
+ * \param  pController - controller state.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void controllerInit(moistureController* pController)
+{
+    pController->valveOpen = false;
+    pController->changedMs = INT64_MIN / 2;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Deciding about the valve after a sensor pass.
+ *
+ * \param  pController - controller state.
+ * \param  deficit - largest target minus reading of the sensors [%],
+ *                   CONTROLLER_NO_TARGET without targets.
+ * \param  pLimits - limits.
+ * \param  nowMs - current time [ms].
+ *
+ * \return True if the valve should be open.
+ *
+ */
+/*********************************************************************/
+bool controllerUpdate(moistureController* pController, int32_t deficit, const controllerLimits* pLimits, int64_t nowMs)
+{
+    int64_t elapsed = nowMs - pController->changedMs;
+
+    if (pController->valveOpen)
+    {
+        /* The target or the time limit ends the watering. */
+        if (deficit <= 0 || elapsed >= pLimits->maxOnMs)
+        {
+            pController->valveOpen = false;
+            pController->changedMs = nowMs;
+        }
+    }
+    else if (deficit != CONTROLLER_NO_TARGET && deficit > pLimits->band && elapsed >= pLimits->minOffMs)
+    {
+        pController->valveOpen = true;
+        pController->changedMs = nowMs;
+    }
+
+    return pController->valveOpen;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Giving up the valve to other control, e.g. a manual
+ *         command. The soak time starts now.
+ *
+ * \param  pController - controller state.
+ * \param  nowMs - current time [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void controllerStop(moistureController* pController, int64_t nowMs)
+{
+    pController->valveOpen = false;
+    pController->changedMs = nowMs;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+/*********************************************************************/
+/*!
+*   \file   controller.h
+*
+*   \brief  Closed-loop moisture control with hysteresis.
+*
+*           The valve opens when the soil is drier than the target by
+*           more than the band and closes once the target is reached.
+*           A watering is limited in time and followed by a soak time,
+*           so water still moving down to the sensor does not start
+*           the next one.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Deficit when no sensor has a target, the valve stays closed. */
+#define CONTROLLER_NO_TARGET INT32_MIN
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Limits set by the website. */
+typedef struct
+{
+    int32_t band;           //Deficit which opens the valve [%].
+    uint32_t maxOnMs;       //Longest watering [ms].
+    uint32_t minOffMs;      //Soak time after a watering [ms].
+} controllerLimits;
+
+/* Controller state, no dynamic memory is used. */
+typedef struct
+{
+    bool valveOpen;         //Valve opened by the controller.
+    int64_t changedMs;      //Time of the last valve change [ms].
+} moistureController;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the controller, the valve starts closed
+ *         without a soak time.
+ *
+ * \param  pController - controller state.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void controllerInit(moistureController* pController);
+
+/*********************************************************************/
+/*!
+ * \brief  Deciding about the valve after a sensor pass.
+ *
+ * \param  pController - controller state.
+ * \param  deficit - largest target minus reading of the sensors [%],
+ *                   CONTROLLER_NO_TARGET without targets.
+ * \param  pLimits - limits.
+ * \param  nowMs - current time [ms].
+ *
+ * \return True if the valve should be open.
+ *
+ */
+/*********************************************************************/
+bool controllerUpdate(moistureController* pController, int32_t deficit, const controllerLimits* pLimits, int64_t nowMs);
+
+/*********************************************************************/
+/*!
+ * \brief  Giving up the valve to other control, e.g. a manual
+ *         command. The soak time starts now.
+ *
+ * \param  pController - controller state.
+ * \param  nowMs - current time [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void controllerStop(moistureController* pController, int64_t nowMs);
+
+#endif /*CONTROLLER_H*/
\ No newline at end of file
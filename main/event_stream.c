@@ -0,0 +1,204 @@
+/*********************************************************************/
+/*!
+*   \file   event_stream.c
+*
+*   \brief  Incremental parser of a text/event-stream (Server-Sent Events).
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <string.h>
+
+#include "event_stream.h"
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Checking if the field name being read is the data field.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return True for the data field.
+ *
+ */
+/*********************************************************************/
+static bool fieldIsData(const eventStream* pStream)
+{
+    return pStream->fieldLen == 4 && memcmp(pStream->field, "data", 4) == 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting a data line, the first one also starts the event.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void dataLineStart(eventStream* pStream)
+{
+    if (!pStream->inEvent)
+    {
+        pStream->inEvent = true;
+        pStream->callback(eventStreamBegin, NULL, 0, pStream->pContext);
+    }
+    else
+    {
+        pStream->callback(eventStreamData, "\n", 1, pStream->pContext);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Handling the end of a line.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void lineEnd(eventStream* pStream)
+{
+    if (pStream->state == eventStateLineStart)
+    {
+        /* Blank line dispatches the event. */
+        if (pStream->inEvent)
+        {
+            pStream->inEvent = false;
+            pStream->callback(eventStreamEnd, NULL, 0, pStream->pContext);
+        }
+    }
+    else if (pStream->state == eventStateField && fieldIsData(pStream))
+    {
+        /* Field without a colon has an empty value. */
+        dataLineStart(pStream);
+    }
+
+    pStream->state = eventStateLineStart;
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the parser for a new stream.
+ *
+ * \param  pStream - parser context.
+ * \param  callback - function called with the event data.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void eventStreamInit(eventStream* pStream, eventStreamCallback callback, void* pContext)
+{
+    memset(pStream, 0, sizeof(*pStream));
+    pStream->state = eventStateLineStart;
+    pStream->callback = callback;
+    pStream->pContext = pContext;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the next chunk of the stream.
+ *         Only data fields are passed on, lines of one event are
+ *         joined with LF. Comments and other fields are skipped.
+ *
+ * \param  pStream - parser context.
+ * \param  pData - chunk of the stream.
+ * \param  len - length of the chunk.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void eventStreamFeed(eventStream* pStream, const char* pData, size_t len)
+{
+    size_t pos = 0;
+    size_t run = 0;
+    char c = 0;
+
+    while (pos < len)
+    {
+        c = pData[pos];
+
+        if (pStream->skipLf)
+        {
+            pStream->skipLf = false;
+            if (c == '\n')
+            {
+                pos++;
+                continue;
+            }
+        }
+
+        if (c == '\r' || c == '\n')
+        {
+            pStream->skipLf = (c == '\r');
+            lineEnd(pStream);
+            pos++;
+            continue;
+        }
+
+        switch (pStream->state)
+        {
+        case eventStateLineStart:
+            if (c == ':')
+            {
+                pStream->state = eventStateSkip;
+                break;
+            }
+            pStream->fieldLen = 0;
+            pStream->state = eventStateField;
+            /* fall through */
+        case eventStateField:
+            if (c == ':')
+            {
+                if (fieldIsData(pStream))
+                {
+                    dataLineStart(pStream);
+                    pStream->state = eventStateSpace;
+                }
+                else
+                {
+                    pStream->state = eventStateSkip;
+                }
+            }
+            else if (pStream->fieldLen < EVENT_STREAM_MAX_FIELD)
+            {
+                pStream->field[pStream->fieldLen++] = c;
+            }
+            break;
+        case eventStateSpace:
+            pStream->state = eventStateData;
+            if (c == ' ')
+            {
+                break;
+            }
+            /* fall through */
+        case eventStateData:
+            /* The rest of the line goes to the callback in one piece. */
+            run = 1;
+            while (pos + run < len && pData[pos + run] != '\r' && pData[pos + run] != '\n')
+            {
+                run++;
+            }
+            pStream->callback(eventStreamData, pData + pos, run, pStream->pContext);
+            pos += run;
+            continue;
+        case eventStateSkip:
+        default:
+            break;
+        }
+
+        pos++;
+    }
+}
\ No newline at end of file
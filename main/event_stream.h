@@ -0,0 +1,94 @@
+/*********************************************************************/
+/*!
+*   \file   event_stream.h
+*
+*   \brief  Incremental parser of a text/event-stream (Server-Sent Events).
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Maximum length of a field name, longer ones are ignored. */
+#define EVENT_STREAM_MAX_FIELD 8
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Part of an event passed to the callback. */
+typedef enum
+{
+    eventStreamBegin,   //First data line of an event.
+    eventStreamData,    //Piece of the event data.
+    eventStreamEnd,     //Blank line, the event is complete.
+} eventStreamPart;
+
+/* Internal state of the parser. */
+typedef enum
+{
+    eventStateLineStart,    //Beginning of a line.
+    eventStateField,        //Inside of a field name.
+    eventStateSpace,        //After the colon, before the value.
+    eventStateData,         //Inside of the value of a data field.
+    eventStateSkip,         //Inside of a comment or an ignored field.
+} eventStreamState;
+
+/* Called with the data of every event, pieces may split lines and tokens. */
+typedef void (*eventStreamCallback)(eventStreamPart part, const char* pData, size_t len, void* pContext);
+
+/* Parser context, no dynamic memory is used. */
+typedef struct
+{
+    eventStreamState state;                 //Current state.
+    bool inEvent;                           //Data of the current event started.
+    bool skipLf;                            //Line ended with CR, LF may follow.
+    uint8_t fieldLen;                       //Length of the field name being read.
+    char field[EVENT_STREAM_MAX_FIELD];     //Field name being read.
+    eventStreamCallback callback;           //Event callback.
+    void* pContext;                         //Callback context.
+} eventStream;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the parser for a new stream.
+ *
+ * \param  pStream - parser context.
+ * \param  callback - function called with the event data.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void eventStreamInit(eventStream* pStream, eventStreamCallback callback, void* pContext);
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the next chunk of the stream.
+ *         Only data fields are passed on, lines of one event are
+ *         joined with LF. Comments and other fields are skipped.
+ *
+ * \param  pStream - parser context.
+ * \param  pData - chunk of the stream.
+ * \param  len - length of the chunk.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void eventStreamFeed(eventStream* pStream, const char* pData, size_t len);
+
+#endif /*EVENT_STREAM_H*/
\ No newline at end of file
@@ -0,0 +1,345 @@
+/*********************************************************************/
+/*!
+*   \file   filter.c
+*
+*   \brief  Chain of filters for sensor readings.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <string.h>
+
+#include "filter.h"
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Reserving the next filter of the chain.
+ *
+ * \param  pChain - chain.
+ * \param  type - kind of the filter.
+ *
+ * \return Filter, NULL if the chain is full.
+ *
+ */
+/*********************************************************************/
+static filterStage* stageAdd(filterChain* pChain, filterType type)
+{
+    if (pChain->count >= FILTER_MAX_STAGES)
+    {
+        return NULL;
+    }
+
+    filterStage* pStage = &pChain->stages[pChain->count++];
+    memset(pStage, 0, sizeof(*pStage));
+    pStage->type = type;
+    return pStage;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Putting a sample into the window, replacing the oldest one.
+ *         The sorted copy is updated in place, O(window).
+ *
+ * \param  pStage - filter.
+ * \param  sample - new sample.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void windowPut(filterStage* pStage, uint16_t sample)
+{
+    uint8_t i = 0;
+    uint8_t count = pStage->count;
+
+    if (count == pStage->window)
+    {
+        /* Remove the oldest sample from the sorted copy. */
+        uint16_t oldest = pStage->history[pStage->next];
+        for (i = 0; i < count && pStage->sorted[i] != oldest; i++)
+        {
+        }
+        for (; i + 1 < count; i++)
+        {
+            pStage->sorted[i] = pStage->sorted[i + 1];
+        }
+        count--;
+    }
+    else
+    {
+        pStage->count++;
+    }
+
+    pStage->history[pStage->next] = sample;
+    pStage->next = (pStage->next + 1) % pStage->window;
+
+    /* Insert the new sample keeping the order. */
+    for (i = count; i > 0 && pStage->sorted[i - 1] > sample; i--)
+    {
+        pStage->sorted[i] = pStage->sorted[i - 1];
+    }
+    pStage->sorted[i] = sample;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Mean of the sorted window without the extreme samples.
+ *
+ * \param  pStage - filter.
+ *
+ * \return Trimmed mean.
+ *
+ */
+/*********************************************************************/
+static uint16_t windowTrimmedMean(const filterStage* pStage)
+{
+    uint32_t sum = 0;
+    uint8_t trim = pStage->trim;
+    uint8_t i = 0;
+
+    /* While the window fills up, trim only what it can afford. */
+    if (pStage->count <= 2 * trim)
+    {
+        trim = (pStage->count - 1) / 2;
+    }
+    for (i = trim; i < pStage->count - trim; i++)
+    {
+        sum += pStage->sorted[i];
+    }
+
+    return sum / (pStage->count - 2 * trim);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Passing a sample through a single filter.
+ *
+ * \param  pStage - filter.
+ * \param  sample - new sample.
+ *
+ * \return Filtered value.
+ *
+ */
+/*********************************************************************/
+static uint16_t stageApply(filterStage* pStage, uint16_t sample)
+{
+    uint16_t delta = 0;
+
+    switch (pStage->type)
+    {
+    case filterMedian:
+        windowPut(pStage, sample);
+        return pStage->sorted[pStage->count / 2];
+    case filterTrimmedMean:
+        windowPut(pStage, sample);
+        return windowTrimmedMean(pStage);
+    case filterEma:
+        if (!pStage->primed)
+        {
+            pStage->value = (uint32_t)sample << 8;
+            pStage->primed = true;
+        }
+        else
+        {
+            int32_t diff = ((int32_t)sample << 8) - (int32_t)pStage->value;
+            /* Full-scale steps times alpha do not fit int32_t. */
+            pStage->value += ((int64_t)diff * pStage->alpha) / 256;
+        }
+        return (pStage->value + 128) >> 8;
+    case filterRateLimit:
+        if (!pStage->primed)
+        {
+            pStage->value = sample;
+            pStage->primed = true;
+            return sample;
+        }
+        delta = (sample > pStage->value) ? sample - pStage->value : pStage->value - sample;
+        if (delta > pStage->maxDelta && pStage->rejects < pStage->maxRejects)
+        {
+            pStage->rejects++;
+            return pStage->value;
+        }
+        pStage->rejects = 0;
+        pStage->value = sample;
+        return sample;
+    default:
+        return sample;
+    }
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Creating an empty chain.
+ *
+ * \param  pChain - chain.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void filterChainInit(filterChain* pChain)
+{
+    pChain->count = 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a running median.
+ *
+ * \param  pChain - chain.
+ * \param  window - window size (1 - FILTER_MAX_WINDOW).
+ *
+ * \return False if the filter could not be added.
+ *
+ */
+/*********************************************************************/
+bool filterAddMedian(filterChain* pChain, uint8_t window)
+{
+    if (window == 0 || window > FILTER_MAX_WINDOW)
+    {
+        return false;
+    }
+
+    filterStage* pStage = stageAdd(pChain, filterMedian);
+    if (pStage == NULL)
+    {
+        return false;
+    }
+    pStage->window = window;
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a trimmed mean.
+ *
+ * \param  pChain - chain.
+ * \param  window - window size (1 - FILTER_MAX_WINDOW).
+ * \param  trim - samples dropped at each end of the sorted window.
+ *
+ * \return False if the filter could not be added.
+ *
+ */
+/*********************************************************************/
+bool filterAddTrimmedMean(filterChain* pChain, uint8_t window, uint8_t trim)
+{
+    if (window == 0 || window > FILTER_MAX_WINDOW || 2 * trim >= window)
+    {
+        return false;
+    }
+
+    filterStage* pStage = stageAdd(pChain, filterTrimmedMean);
+    if (pStage == NULL)
+    {
+        return false;
+    }
+    pStage->window = window;
+    pStage->trim = trim;
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Adding an exponential moving average.
+ *
+ * \param  pChain - chain.
+ * \param  alpha - weight of the new sample in 1/256 (1 - 256).
+ *
+ * \return False if the filter could not be added.
+ *
+ */
+/*********************************************************************/
+bool filterAddEma(filterChain* pChain, uint16_t alpha)
+{
+    if (alpha == 0 || alpha > 256)
+    {
+        return false;
+    }
+
+    filterStage* pStage = stageAdd(pChain, filterEma);
+    if (pStage == NULL)
+    {
+        return false;
+    }
+    pStage->alpha = alpha;
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a rate of change outlier rejection.
+ *
+ * \param  pChain - chain.
+ * \param  maxDelta - largest accepted change between samples.
+ * \param  maxRejects - consecutive rejections after which the new level is accepted.
+ *
+ * \return False if the filter could not be added.
+ *
+ */
+/*********************************************************************/
+bool filterAddRateLimit(filterChain* pChain, uint16_t maxDelta, uint8_t maxRejects)
+{
+    filterStage* pStage = stageAdd(pChain, filterRateLimit);
+    if (pStage == NULL)
+    {
+        return false;
+    }
+    pStage->maxDelta = maxDelta;
+    pStage->maxRejects = maxRejects;
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Clearing the state of all filters.
+ *
+ * \param  pChain - chain.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void filterChainReset(filterChain* pChain)
+{
+    uint8_t i = 0;
+
+    for (i = 0; i < pChain->count; i++)
+    {
+        filterStage* pStage = &pChain->stages[i];
+        pStage->count = 0;
+        pStage->next = 0;
+        pStage->value = 0;
+        pStage->rejects = 0;
+        pStage->primed = false;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Passing a sample through all filters.
+ *
+ * \param  pChain - chain.
+ * \param  sample - new sample.
+ *
+ * \return Filtered value.
+ *
+ */
+/*********************************************************************/
+uint16_t filterChainApply(filterChain* pChain, uint16_t sample)
+{
+    uint8_t i = 0;
+
+    for (i = 0; i < pChain->count; i++)
+    {
+        sample = stageApply(&pChain->stages[i], sample);
+    }
+
+    return sample;
+}
\ No newline at end of file
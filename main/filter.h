@@ -0,0 +1,158 @@
+/*********************************************************************/
+/*!
+*   \file   filter.h
+*
+*   \brief  Chain of filters for sensor readings.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Maximum window of the median and trimmed mean filters. */
+#define FILTER_MAX_WINDOW 9
+/* Maximum number of filters in a chain. */
+#define FILTER_MAX_STAGES 4
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Kind of the filter. */
+typedef enum
+{
+    filterMedian,       //Running median over a window.
+    filterTrimmedMean,  //Mean of a window without the extreme samples.
+    filterEma,          //Exponential moving average.
+    filterRateLimit,    //Rejection of samples changing too fast.
+} filterType;
+
+/* Single filter with its preallocated state. */
+typedef struct
+{
+    filterType type;                        //Kind of the filter.
+    uint8_t window;                         //Window size (median, trimmed mean).
+    uint8_t trim;                           //Samples dropped at each end (trimmed mean).
+    uint16_t alpha;                         //Smoothing factor, 256 - no smoothing (EMA).
+    uint16_t maxDelta;                      //Largest accepted change (rate limit).
+    uint8_t maxRejects;                     //Rejections before a change is accepted (rate limit).
+
+    uint16_t history[FILTER_MAX_WINDOW];    //Samples in arrival order.
+    uint16_t sorted[FILTER_MAX_WINDOW];     //Samples in ascending order.
+    uint8_t count;                          //Samples in the window.
+    uint8_t next;                           //Oldest sample in history.
+    uint32_t value;                         //Last output (EMA in 1/256 units).
+    uint8_t rejects;                        //Consecutive rejections.
+    bool primed;                            //First sample received.
+} filterStage;
+
+/* Filters applied one after another. */
+typedef struct
+{
+    filterStage stages[FILTER_MAX_STAGES];  //Filters in order.
+    uint8_t count;                          //Number of filters.
+} filterChain;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Creating an empty chain.
+ *
+ * \param  pChain - chain.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void filterChainInit(filterChain* pChain);
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a running median.
+ *
+ * \param  pChain - chain.
+ * \param  window - window size (1 - FILTER_MAX_WINDOW).
+ *
+ * \return False if the filter could not be added.
+ *
+ */
+/*********************************************************************/
+bool filterAddMedian(filterChain* pChain, uint8_t window);
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a trimmed mean.
+ *
+ * \param  pChain - chain.
+ * \param  window - window size (1 - FILTER_MAX_WINDOW).
+ * \param  trim - samples dropped at each end of the sorted window.
+ *
+ * \return False if the filter could not be added.
+ *
+ */
+/*********************************************************************/
+bool filterAddTrimmedMean(filterChain* pChain, uint8_t window, uint8_t trim);
+
+/*********************************************************************/
+/*!
+ * \brief  Adding an exponential moving average.
+ *
+ * \param  pChain - chain.
+ * \param  alpha - weight of the new sample in 1/256 (1 - 256).
+ *
+ * \return False if the filter could not be added.
+ *
+ */
+/*********************************************************************/
+bool filterAddEma(filterChain* pChain, uint16_t alpha);
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a rate of change outlier rejection.
+ *
+ * \param  pChain - chain.
+ * \param  maxDelta - largest accepted change between samples.
+ * \param  maxRejects - consecutive rejections after which the new level is accepted.
+ *
+ * \return False if the filter could not be added.
+ *
+ */
+/*********************************************************************/
+bool filterAddRateLimit(filterChain* pChain, uint16_t maxDelta, uint8_t maxRejects);
+
+/*********************************************************************/
+/*!
+ * \brief  Clearing the state of all filters.
+ *
+ * \param  pChain - chain.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void filterChainReset(filterChain* pChain);
+
+/*********************************************************************/
+/*!
+ * \brief  Passing a sample through all filters.
+ *
+ * \param  pChain - chain.
+ * \param  sample - new sample.
+ *
+ * \return Filtered value.
+ *
+ */
+/*********************************************************************/
+uint16_t filterChainApply(filterChain* pChain, uint16_t sample);
+
+#endif /*FILTER_H*/
\ No newline at end of file
@@ -0,0 +1,220 @@
+/*********************************************************************/
+/*!
+*   \file   hal.h
+*
+*   \brief  Hardware abstraction of the ADC, PWM and GPIO drivers.
+*
+*           hal_esp32.c uses the ESP-IDF drivers, hal_linux.c simulates
+*           the hardware so the firmware runs as a Linux process.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_attr.h"
+#endif
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Resolution of the raw ADC data. */
+#define HAL_ADC_BITS 11
+/* Resolution of the PWM duty. */
+#define HAL_PWM_BITS 13
+
+/* Wall-clock time before this was not set yet by SNTP (2024-01-01) [s]. */
+#define HAL_CLOCK_VALID_S 1704067200
+
+/* Variables kept through deep sleep, zeroed at power-on. */
+#if !CONFIG_IDF_TARGET_LINUX
+#define HAL_RETAINED RTC_DATA_ATTR
+#else
+/* The simulated deep sleep copies this section into the restarted process. */
+#define HAL_RETAINED __attribute__((section("hal_retained")))
+#endif
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Called for every sample of a continuous ADC frame. */
+typedef void (*halAdcSampleCallback)(uint8_t channel, uint16_t raw, void* pContext);
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  ADC initialization for the given ADC1 channels.
+ *         With CONFIG_SENSOR_CONTINUOUS all channels are sampled
+ *         by DMA, only while halAdcReadFrame() runs.
+ *
+ * \param  pChannels - ADC1 channels.
+ * \param  count - number of channels.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halAdcInit(const uint8_t* pChannels, uint8_t count);
+
+/*********************************************************************/
+/*!
+ * \brief  Reading one sample of the channel.
+ *
+ * \param  channel - ADC1 channel.
+ *
+ * \return Raw data (HAL_ADC_BITS).
+ *
+ */
+/*********************************************************************/
+uint16_t halAdcRead(uint8_t channel);
+
+/*********************************************************************/
+/*!
+ * \brief  Sampling a fresh frame with the continuous ADC.
+ *
+ * \param  callback - function called for every sample.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return Number of samples in the frame.
+ *
+ */
+/*********************************************************************/
+uint32_t halAdcReadFrame(halAdcSampleCallback callback, void* pContext);
+
+/*********************************************************************/
+/*!
+ * \brief  Converting raw data to a voltage.
+ *
+ * \param  raw - raw data (HAL_ADC_BITS).
+ *
+ * \return Voltage [mV].
+ *
+ */
+/*********************************************************************/
+uint16_t halAdcToVoltage(uint16_t raw);
+
+/*********************************************************************/
+/*!
+ * \brief  PWM initialization.
+ *
+ * \param  pin - output pin.
+ * \param  frequency - PWM frequency [Hz].
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmInit(uint8_t pin, uint32_t frequency);
+
+/*********************************************************************/
+/*!
+ * \brief  Starting the PWM with a new duty.
+ *
+ * \param  duty - duty (HAL_PWM_BITS).
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmSetDuty(uint32_t duty);
+
+/*********************************************************************/
+/*!
+ * \brief  Stopping the PWM, the output stays low.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmStop(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Configuring the pin as an output.
+ *
+ * \param  pin - pin number.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halGpioOutput(uint8_t pin);
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the output level.
+ *
+ * \param  pin - pin number.
+ * \param  level - 1 - high, 0 - low.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void halGpioSet(uint8_t pin, uint8_t level);
+
+/*********************************************************************/
+/*!
+ * \brief  Time which keeps running through deep sleep.
+ *
+ * \param  None
+ *
+ * \return Time since power-on [us].
+ *
+ */
+/*********************************************************************/
+int64_t halClockUs(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the firmware started from a deep sleep timer wake-up.
+ *
+ * \param  None
+ *
+ * \return True after a deep sleep, false after power-on or a reset.
+ *
+ */
+/*********************************************************************/
+bool halWokeFromDeepSleep(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Entering deep sleep. The target restarts from app_main()
+ *         with only HAL_RETAINED variables kept, the simulation
+ *         advances its clock and restarts its process the same way.
+ *
+ * \param  ms - sleep time [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void halDeepSleep(uint32_t ms);
+
+/*********************************************************************/
+/*!
+ * \brief  Enabling automatic light sleep while all tasks are blocked.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halLightSleepEnable(void);
+
+#endif /*HAL_H*/
\ No newline at end of file
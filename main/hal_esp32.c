@@ -0,0 +1,494 @@
+/*********************************************************************/
+/*!
+*   \file   hal_esp32.c
+*
+*   \brief  Hardware abstraction on the ESP-IDF drivers.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+/* The legacy and the new ADC drivers are never linked together. */
+#if CONFIG_SENSOR_CONTINUOUS
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_adc/adc_continuous.h"
+#else
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+#endif
+
+#include "hal.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define TAG "hal"
+
+/* Reference voltage used when eFuse calibration is missing [mV]. */
+#define HAL_ADC_VREF 1100
+
+#if CONFIG_SENSOR_CONTINUOUS
+/* Shift of the raw data to the full resolution of the calibration. */
+#define HAL_CALI_SHIFT (SOC_ADC_RTC_MAX_BITWIDTH - HAL_ADC_BITS)
+/* Nominal full scale of the 11 dB attenuation, used without calibration [mV]. */
+#define HAL_ADC_FULL_SCALE_MV 3100
+#endif
+
+/* LEDC channel of the PWM output. */
+#define HAL_PWM_MODE LEDC_LOW_SPEED_MODE
+#define HAL_PWM_CHANNEL LEDC_CHANNEL_0
+#define HAL_PWM_TIMER LEDC_TIMER_0
+
+#if CONFIG_SENSOR_CONTINUOUS
+/* Size of the DMA frame reduced by a single measurement, all channels interleaved. */
+#define HAL_FRAME_BYTES (CONFIG_SENSOR_FRAME_SAMPLES * CONFIG_SENSOR_COUNT * SOC_ADC_DIGI_RESULT_BYTES)
+/* Maximum time of waiting for a complete frame. */
+#define HAL_FRAME_TIMEOUT_MS 1000
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define HAL_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define HAL_SAMPLE_CHANNEL(p) ((p)->type1.channel)
+#define HAL_SAMPLE_DATA(p) ((p)->type1.data)
+#else
+#define HAL_OUTPUT_FORMAT ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define HAL_SAMPLE_CHANNEL(p) ((p)->type2.channel)
+#define HAL_SAMPLE_DATA(p) ((p)->type2.data)
+#endif
+#endif
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+/* Time before the last deep sleep plus its length [us]. The boot time
+   after a wake-up is not counted, the clock lags by a few ms per wake. */
+HAL_RETAINED static int64_t clockOffsetUs;
+
+#if CONFIG_SENSOR_CONTINUOUS
+/* ADC calibration scheme, created once at initialization. */
+static adc_cali_handle_t caliHandle;
+/* Continuous ADC driver, started for every frame. */
+static adc_continuous_handle_t continuousHandle;
+/* Frame being reduced. */
+static uint8_t frame[HAL_FRAME_BYTES];
+#else
+/* ADC characteristics, read once at initialization. */
+static esp_adc_cal_characteristics_t adcCalibration;
+#endif
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+#if CONFIG_SENSOR_CONTINUOUS
+/*********************************************************************/
+/*!
+ * \brief  Creating the calibration scheme of ADC1 supported by the chip.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t halAdcCaliInit(void)
+{
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_11,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+
+    return adc_cali_create_scheme_curve_fitting(&config, &caliHandle);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t config = {
+        .unit_id = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_11,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+#if CONFIG_IDF_TARGET_ESP32
+        .default_vref = HAL_ADC_VREF,
+#endif
+    };
+
+    return adc_cali_create_scheme_line_fitting(&config, &caliHandle);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+#endif
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  ADC initialization for the given ADC1 channels.
+ *         With CONFIG_SENSOR_CONTINUOUS all channels are sampled
+ *         by DMA, only while halAdcReadFrame() runs.
+ *
+ * \param  pChannels - ADC1 channels.
+ * \param  count - number of channels.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halAdcInit(const uint8_t* pChannels, uint8_t count)
+{
+    esp_err_t err = ESP_FAIL;
+    uint8_t i = 0;
+
+#if CONFIG_SENSOR_CONTINUOUS
+    adc_continuous_handle_cfg_t handleConfig = {
+        .max_store_buf_size = HAL_FRAME_BYTES * 2,
+        .conv_frame_size = HAL_FRAME_BYTES,
+    };
+    adc_digi_pattern_config_t patterns[SOC_ADC_PATT_LEN_MAX];
+    adc_continuous_config_t config = {
+        .pattern_num = count,
+        .adc_pattern = patterns,
+        .sample_freq_hz = CONFIG_SENSOR_SAMPLE_RATE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = HAL_OUTPUT_FORMAT,
+    };
+
+    for (i = 0; i < count; i++)
+    {
+        patterns[i].atten = ADC_ATTEN_DB_11;
+        patterns[i].channel = pChannels[i];
+        patterns[i].unit = ADC_UNIT_1;
+        patterns[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    err = adc_continuous_new_handle(&handleConfig, &continuousHandle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to create continuous ADC: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = adc_continuous_config(continuousHandle, &config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to configure continuous ADC: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    /* Without calibration halAdcToVoltage() scales the raw data linearly. */
+    err = halAdcCaliInit();
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "ADC calibration not available: %s", esp_err_to_name(err));
+        caliHandle = NULL;
+    }
+#else
+    err = adc1_config_width(ADC_WIDTH_BIT_11);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to configure ADC width: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        err = adc1_config_channel_atten(pChannels[i], ADC_ATTEN_DB_11);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to configure ADC channel attenuation: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_11, HAL_ADC_VREF, &adcCalibration);
+#endif
+
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading one sample of the channel.
+ *         Not available with CONFIG_SENSOR_CONTINUOUS.
+ *
+ * \param  channel - ADC1 channel.
+ *
+ * \return Raw data (HAL_ADC_BITS).
+ *
+ */
+/*********************************************************************/
+uint16_t halAdcRead(uint8_t channel)
+{
+#if CONFIG_SENSOR_CONTINUOUS
+    return 0;
+#else
+    return adc1_get_raw(channel);
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Sampling a fresh frame with the continuous ADC.
+ *
+ * \param  callback - function called for every sample.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return Number of samples in the frame.
+ *
+ */
+/*********************************************************************/
+uint32_t halAdcReadFrame(halAdcSampleCallback callback, void* pContext)
+{
+#if CONFIG_SENSOR_CONTINUOUS
+    esp_err_t err = ESP_FAIL;
+    uint32_t len = 0;
+    uint32_t count = 0;
+    uint32_t offset = 0;
+
+    /* Running the DMA only for the frame keeps the samples fresh: a full
+       pool would drop the newer conversions and keep the old ones. It also
+       releases the power management lock, so light sleep can start. */
+    adc_continuous_flush_pool(continuousHandle);
+    err = adc_continuous_start(continuousHandle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start continuous ADC: %s", esp_err_to_name(err));
+        return 0;
+    }
+    err = adc_continuous_read(continuousHandle, frame, sizeof(frame), &len, HAL_FRAME_TIMEOUT_MS);
+    adc_continuous_stop(continuousHandle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to read ADC frame: %s", esp_err_to_name(err));
+        return 0;
+    }
+
+    for (offset = 0; offset + SOC_ADC_DIGI_RESULT_BYTES <= len; offset += SOC_ADC_DIGI_RESULT_BYTES)
+    {
+        adc_digi_output_data_t* pSample = (adc_digi_output_data_t*)&frame[offset];
+
+        /* Frames have the full DMA resolution, conversions use HAL_ADC_BITS. */
+        callback(HAL_SAMPLE_CHANNEL(pSample), HAL_SAMPLE_DATA(pSample) >> (SOC_ADC_DIGI_MAX_BITWIDTH - HAL_ADC_BITS), pContext);
+        count++;
+    }
+
+    return count;
+#else
+    return 0;
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Converting raw data to a voltage.
+ *
+ * \param  raw - raw data (HAL_ADC_BITS).
+ *
+ * \return Voltage [mV].
+ *
+ */
+/*********************************************************************/
+uint16_t halAdcToVoltage(uint16_t raw)
+{
+#if CONFIG_SENSOR_CONTINUOUS
+    int voltage = 0;
+
+    if (caliHandle == NULL ||
+        adc_cali_raw_to_voltage(caliHandle, raw << HAL_CALI_SHIFT, &voltage) != ESP_OK)
+    {
+        return (uint32_t)raw * HAL_ADC_FULL_SCALE_MV / ((1 << HAL_ADC_BITS) - 1);
+    }
+    return voltage;
+#else
+    return esp_adc_cal_raw_to_voltage(raw, &adcCalibration);
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  PWM initialization.
+ *
+ * \param  pin - output pin.
+ * \param  frequency - PWM frequency [Hz].
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmInit(uint8_t pin, uint32_t frequency)
+{
+    esp_err_t err = ESP_FAIL;
+
+    ledc_timer_config_t ledc_timer = {
+        .speed_mode       = HAL_PWM_MODE,
+        .timer_num        = HAL_PWM_TIMER,
+        .duty_resolution  = HAL_PWM_BITS,
+        .freq_hz          = frequency,
+        .clk_cfg          = LEDC_AUTO_CLK
+    };
+    err = ledc_timer_config(&ledc_timer);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    ledc_channel_config_t ledc_channel = {
+        .speed_mode     = HAL_PWM_MODE,
+        .channel        = HAL_PWM_CHANNEL,
+        .timer_sel      = HAL_PWM_TIMER,
+        .intr_type      = LEDC_INTR_DISABLE,
+        .gpio_num       = pin,
+        .duty           = 0,
+        .hpoint         = 0
+    };
+    return ledc_channel_config(&ledc_channel);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting the PWM with a new duty.
+ *
+ * \param  duty - duty (HAL_PWM_BITS).
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmSetDuty(uint32_t duty)
+{
+    esp_err_t err = ledc_set_duty(HAL_PWM_MODE, HAL_PWM_CHANNEL, duty);
+
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return ledc_update_duty(HAL_PWM_MODE, HAL_PWM_CHANNEL);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Stopping the PWM, the output stays low.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmStop(void)
+{
+    return ledc_stop(HAL_PWM_MODE, HAL_PWM_CHANNEL, 0);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Configuring the pin as an output.
+ *
+ * \param  pin - pin number.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halGpioOutput(uint8_t pin)
+{
+    esp_rom_gpio_pad_select_gpio(pin);
+    return gpio_set_direction(pin, GPIO_MODE_OUTPUT);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the output level.
+ *
+ * \param  pin - pin number.
+ * \param  level - 1 - high, 0 - low.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void halGpioSet(uint8_t pin, uint8_t level)
+{
+    gpio_set_level(pin, level);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Time which keeps running through deep sleep.
+ *
+ * \param  None
+ *
+ * \return Time since power-on [us].
+ *
+ */
+/*********************************************************************/
+int64_t halClockUs(void)
+{
+    return clockOffsetUs + esp_timer_get_time();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the firmware started from a deep sleep timer wake-up.
+ *
+ * \param  None
+ *
+ * \return True after a deep sleep, false after power-on or a reset.
+ *
+ */
+/*********************************************************************/
+bool halWokeFromDeepSleep(void)
+{
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Entering deep sleep. The target restarts from app_main()
+ *         with only HAL_RETAINED variables kept, the simulation
+ *         advances its clock and restarts its process the same way.
+ *
+ * \param  ms - sleep time [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void halDeepSleep(uint32_t ms)
+{
+    /* esp_timer starts from zero after the wake-up. */
+    clockOffsetUs += esp_timer_get_time() + (int64_t)ms * 1000;
+    esp_deep_sleep((uint64_t)ms * 1000);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Enabling automatic light sleep while all tasks are blocked.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halLightSleepEnable(void)
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = true,
+    };
+
+    return esp_pm_configure(&config);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,592 @@
+/*********************************************************************/
+/*!
+*   \file   hal_linux.c
+*
+*   \brief  Simulated hardware for the Linux build.
+*
+*           The ADC reads a simple soil model: every channel dries out
+*           slowly and gets wet while the servo holds the valve open.
+*           PWM and GPIO outputs are only logged. Deep sleep moves
+*           a simulated clock forward instead of waiting and restarts
+*           the process with the HAL_RETAINED variables copied over.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+
+#include "hal.h"
+#include "sensor.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define TAG "hal"
+
+/* Number of ADC1 channels and GPIO pins. */
+#define HAL_ADC_CHANNELS 8
+#define HAL_GPIO_PINS 40
+
+/* Full scale of the simulated ADC [mV]. */
+#define SIM_FULL_SCALE_MV 3100
+/* Noise of the simulated ADC (+/- raw). */
+#define SIM_NOISE 8
+/* Soil moisture change per second (1.0 - wet sensor). */
+#define SIM_DRYING_PER_S 0.002f
+#define SIM_WATERING_PER_S 0.02f
+/* Shortest servo pulse which opens the valve [us]. */
+#define SIM_VALVE_OPEN_US 1800
+
+/* Environment variable with the retained memory file of a wake-up. */
+#define SIM_WAKE_ENV "HAL_SIM_WAKE"
+/* Marks a retained memory file. */
+#define SIM_RETAINED_MAGIC 0x52544e44u
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* State of the simulated hardware. */
+typedef struct
+{
+    float moisture[HAL_ADC_CHANNELS];   //Soil moisture at each channel (0.0 - 1.0).
+    int64_t lastUpdateUs;               //Time of the last soil update [us].
+    int64_t bootUs;                     //Simulated time at the start of the process [us].
+    uint32_t noise;                     //State of the noise generator.
+    uint32_t pwmFrequency;              //PWM frequency [Hz].
+    volatile bool valveOpen;            //Servo holds the valve open.
+    uint8_t gpio[HAL_GPIO_PINS];        //Output levels.
+} halSimulation;
+
+/* Header of the retained memory file. */
+typedef struct
+{
+    uint32_t magic;                     //SIM_RETAINED_MAGIC.
+    uint32_t size;                      //Bytes of retained memory which follow.
+} halRetainedHeader;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+/* The soil, the valve and the clock outlive the sleeping chip. */
+HAL_RETAINED static halSimulation sim = { .noise = 2463534242u };
+static int64_t processStartUs;
+static char** processArgv;
+static bool woke;
+
+/* All HAL_RETAINED variables, placed together by the linker. */
+extern uint8_t __start_hal_retained[];
+extern uint8_t __stop_hal_retained[];
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Monotonic time of the host.
+ *
+ * \param  None
+ *
+ * \return Time [us].
+ *
+ */
+/*********************************************************************/
+static int64_t halHostUs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Simulated time, running on through deep sleep and restarts.
+ *
+ * \param  None
+ *
+ * \return Time since the first start [us].
+ *
+ */
+/*********************************************************************/
+static int64_t halNowUs(void)
+{
+    return halHostUs() - processStartUs + sim.bootUs;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Process start, restores the retained memory when the
+ *         process was restarted by halDeepSleep(). Runs before main().
+ *
+ * \param  argc - number of arguments.
+ * \param  argv - arguments, kept for the restart.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+__attribute__((constructor)) static void halProcessStart(int argc, char** argv)
+{
+    const char* pPath = getenv(SIM_WAKE_ENV);
+    halRetainedHeader header;
+    FILE* pFile = NULL;
+
+    processStartUs = halHostUs();
+    processArgv = argv;
+    (void)argc;
+    if (pPath == NULL)
+    {
+        return;
+    }
+
+    pFile = fopen(pPath, "rb");
+    if (pFile != NULL)
+    {
+        /* A file of another build is ignored, that start is a power-on. */
+        woke = fread(&header, sizeof(header), 1, pFile) == 1 && header.magic == SIM_RETAINED_MAGIC &&
+               header.size == (uint32_t)(__stop_hal_retained - __start_hal_retained) &&
+               fread(__start_hal_retained, 1, header.size, pFile) == header.size;
+        fclose(pFile);
+    }
+    unlink(pPath);
+    unsetenv(SIM_WAKE_ENV);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing the retained memory to a file.
+ *
+ * \param  pPath - file path.
+ *
+ * \return True if the whole memory was written.
+ *
+ */
+/*********************************************************************/
+static bool halRetainedSave(const char* pPath)
+{
+    halRetainedHeader header = {
+        .magic = SIM_RETAINED_MAGIC,
+        .size = (uint32_t)(__stop_hal_retained - __start_hal_retained)
+    };
+    FILE* pFile = fopen(pPath, "wb");
+    bool written = false;
+
+    if (pFile == NULL)
+    {
+        return false;
+    }
+    written = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+              fwrite(__start_hal_retained, 1, header.size, pFile) == header.size;
+    return fclose(pFile) == 0 && written;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Closing the open files of the process on exec(),
+ *         like the connections of the sleeping target.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void halCloseOnExec(void)
+{
+    DIR* pDir = opendir("/proc/self/fd");
+    struct dirent* pEntry = NULL;
+    int fd = 0;
+
+    if (pDir == NULL)
+    {
+        return;
+    }
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        fd = atoi(pEntry->d_name);
+        if (fd > STDERR_FILENO && fd != dirfd(pDir))
+        {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    closedir(pDir);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting the process again from main() with the retained
+ *         memory, as the target does after a deep sleep.
+ *
+ * \param  None
+ *
+ * \return None, only if the restart failed.
+ *
+ */
+/*********************************************************************/
+static void halRestart(void)
+{
+    char path[64];
+    int64_t bootUs = sim.bootUs;
+
+    snprintf(path, sizeof(path), "/tmp/hal_retained_%ld.bin", (long)getpid());
+    /* The new process continues the simulated time from now. */
+    sim.bootUs = halNowUs();
+    if (processArgv != NULL && halRetainedSave(path) && setenv(SIM_WAKE_ENV, path, 1) == 0)
+    {
+        halCloseOnExec();
+        fflush(NULL);
+        execv("/proc/self/exe", processArgv);
+    }
+
+    ESP_LOGE(TAG, "Failed to restart the simulation: %s", strerror(errno));
+    unsetenv(SIM_WAKE_ENV);
+    unlink(path);
+    sim.bootUs = bootUs;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Advancing the soil model to the current time.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void halSoilUpdate(void)
+{
+    int64_t now = halNowUs();
+    float seconds = (now - sim.lastUpdateUs) / 1000000.0f;
+    float change = sim.valveOpen ? SIM_WATERING_PER_S : -SIM_DRYING_PER_S;
+    uint8_t channel = 0;
+
+    sim.lastUpdateUs = now;
+    for (channel = 0; channel < HAL_ADC_CHANNELS; channel++)
+    {
+        sim.moisture[channel] += change * seconds;
+        if (sim.moisture[channel] < 0.0f)
+        {
+            sim.moisture[channel] = 0.0f;
+        }
+        else if (sim.moisture[channel] > 1.0f)
+        {
+            sim.moisture[channel] = 1.0f;
+        }
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Raw value of the channel with noise.
+ *
+ * \param  channel - ADC1 channel.
+ *
+ * \return Raw data (HAL_ADC_BITS).
+ *
+ */
+/*********************************************************************/
+static uint16_t halSoilRaw(uint8_t channel)
+{
+    int32_t raw = SENSOR_RAW_DRY - (int32_t)(sim.moisture[channel % HAL_ADC_CHANNELS] * (SENSOR_RAW_DRY - SENSOR_RAW_WET));
+
+    sim.noise ^= sim.noise << 13;
+    sim.noise ^= sim.noise >> 17;
+    sim.noise ^= sim.noise << 5;
+    raw += (int32_t)(sim.noise % (2 * SIM_NOISE + 1)) - SIM_NOISE;
+
+    if (raw < 0)
+    {
+        return 0;
+    }
+    return (raw < (1 << HAL_ADC_BITS)) ? raw : (1 << HAL_ADC_BITS) - 1;
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  ADC initialization for the given ADC1 channels.
+ *         With CONFIG_SENSOR_CONTINUOUS all channels are sampled
+ *         by DMA, only while halAdcReadFrame() runs.
+ *
+ * \param  pChannels - ADC1 channels.
+ * \param  count - number of channels.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halAdcInit(const uint8_t* pChannels, uint8_t count)
+{
+    uint8_t channel = 0;
+
+    /* Every probe starts at a different moisture, a wake-up keeps the soil. */
+    for (channel = 0; channel < HAL_ADC_CHANNELS && !woke; channel++)
+    {
+        sim.moisture[channel] = 0.3f + 0.1f * channel;
+    }
+    halSoilUpdate();
+
+    ESP_LOGI(TAG, "Simulated ADC with %u channels", count);
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading one sample of the channel.
+ *
+ * \param  channel - ADC1 channel.
+ *
+ * \return Raw data (HAL_ADC_BITS).
+ *
+ */
+/*********************************************************************/
+uint16_t halAdcRead(uint8_t channel)
+{
+    halSoilUpdate();
+    return halSoilRaw(channel);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading a whole frame of the continuous ADC.
+ *
+ * \param  callback - function called for every sample.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return Number of samples in the frame.
+ *
+ */
+/*********************************************************************/
+uint32_t halAdcReadFrame(halAdcSampleCallback callback, void* pContext)
+{
+#if CONFIG_SENSOR_CONTINUOUS
+    static const uint8_t channels[] = {
+        CONFIG_SENSOR_1_CHANNEL,
+#if CONFIG_SENSOR_COUNT >= 2
+        CONFIG_SENSOR_2_CHANNEL,
+#endif
+#if CONFIG_SENSOR_COUNT >= 3
+        CONFIG_SENSOR_3_CHANNEL,
+#endif
+#if CONFIG_SENSOR_COUNT >= 4
+        CONFIG_SENSOR_4_CHANNEL,
+#endif
+    };
+    uint32_t sample = 0;
+    uint8_t channel = 0;
+
+    halSoilUpdate();
+    for (sample = 0; sample < CONFIG_SENSOR_FRAME_SAMPLES; sample++)
+    {
+        for (channel = 0; channel < sizeof(channels); channel++)
+        {
+            callback(channels[channel], halSoilRaw(channels[channel]), pContext);
+        }
+    }
+
+    return CONFIG_SENSOR_FRAME_SAMPLES * sizeof(channels);
+#else
+    return 0;
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Converting raw data to a voltage.
+ *
+ * \param  raw - raw data (HAL_ADC_BITS).
+ *
+ * \return Voltage [mV].
+ *
+ */
+/*********************************************************************/
+uint16_t halAdcToVoltage(uint16_t raw)
+{
+    return (uint32_t)raw * SIM_FULL_SCALE_MV / ((1 << HAL_ADC_BITS) - 1);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  PWM initialization.
+ *
+ * \param  pin - output pin.
+ * \param  frequency - PWM frequency [Hz].
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmInit(uint8_t pin, uint32_t frequency)
+{
+    if (frequency == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sim.pwmFrequency = frequency;
+    ESP_LOGI(TAG, "Simulated PWM on pin %u, %lu Hz", pin, (unsigned long)frequency);
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting the PWM with a new duty.
+ *
+ * \param  duty - duty (HAL_PWM_BITS).
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmSetDuty(uint32_t duty)
+{
+    uint32_t pulseUs = 0;
+
+    if (sim.pwmFrequency == 0)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pulseUs = (uint64_t)duty * 1000000 / sim.pwmFrequency >> HAL_PWM_BITS;
+
+    /* The soil changes with the old valve position until now. */
+    halSoilUpdate();
+    sim.valveOpen = (pulseUs >= SIM_VALVE_OPEN_US);
+
+    ESP_LOGI(TAG, "Servo pulse %lu us, valve %s", (unsigned long)pulseUs, sim.valveOpen ? "open" : "closed");
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Stopping the PWM, the output stays low.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halPwmStop(void)
+{
+    /* The servo holds the valve where it is. */
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Configuring the pin as an output.
+ *
+ * \param  pin - pin number.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halGpioOutput(uint8_t pin)
+{
+    return (pin < HAL_GPIO_PINS) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the output level.
+ *
+ * \param  pin - pin number.
+ * \param  level - 1 - high, 0 - low.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void halGpioSet(uint8_t pin, uint8_t level)
+{
+    if (pin < HAL_GPIO_PINS && sim.gpio[pin] != level)
+    {
+        sim.gpio[pin] = level;
+        ESP_LOGD(TAG, "GPIO %u = %u", pin, level);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Time which keeps running through deep sleep.
+ *
+ * \param  None
+ *
+ * \return Time since power-on [us].
+ *
+ */
+/*********************************************************************/
+int64_t halClockUs(void)
+{
+    return halNowUs();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the firmware started from a deep sleep timer wake-up.
+ *
+ * \param  None
+ *
+ * \return True after a deep sleep, false after power-on or a reset.
+ *
+ */
+/*********************************************************************/
+bool halWokeFromDeepSleep(void)
+{
+    return woke;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Entering deep sleep. The target restarts from app_main()
+ *         with only HAL_RETAINED variables kept, the simulation
+ *         advances its clock and restarts its process the same way.
+ *
+ * \param  ms - sleep time [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void halDeepSleep(uint32_t ms)
+{
+    /* The soil changes during the sleep as if the time passed. */
+    sim.bootUs += (int64_t)ms * 1000;
+    halSoilUpdate();
+
+    ESP_LOGI(TAG, "Simulated deep sleep of %lu ms", (unsigned long)ms);
+    halRestart();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Enabling automatic light sleep while all tasks are blocked.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t halLightSleepEnable(void)
+{
+    /* The host does not sleep. */
+    return ESP_OK;
+}
\ No newline at end of file
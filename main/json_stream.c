@@ -0,0 +1,592 @@
+/*********************************************************************/
+/*!
+*   \file   json_stream.c
+*
+*   \brief  Incremental JSON parser working on body chunks.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <string.h>
+
+#include "json_stream.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Largest decimal exponent applied to a float, float mantissas
+   lie between 1e-45 and 3.4e38. */
+#define JSON_FLOAT_MAX_EXPONENT 84
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Checking for JSON whitespace.
+ *
+ * \param  c - character.
+ *
+ * \return True for whitespace.
+ *
+ */
+/*********************************************************************/
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Appending a character to the token, truncating long tokens.
+ *
+ * \param  pStream - parser context.
+ * \param  c - character.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void tokenPut(jsonStream* pStream, char c)
+{
+    if (pStream->tokenLen < JSON_STREAM_MAX_TOKEN - 1)
+    {
+        pStream->token[pStream->tokenLen++] = c;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Moving to the state after a complete value.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void valueDone(jsonStream* pStream)
+{
+    pStream->state = (pStream->depth == 0) ? jsonStateDone : jsonStateCommaOrEnd;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Passing a complete scalar value to the callback.
+ *
+ * \param  pStream - parser context.
+ * \param  type - type of the value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void valueEmit(jsonStream* pStream, jsonValueType type)
+{
+    pStream->token[pStream->tokenLen] = '\0';
+    if (pStream->callback != NULL)
+    {
+        pStream->callback(pStream, type, pStream->token, pStream->pContext);
+    }
+    valueDone(pStream);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing a number or a true/false/null literal.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void literalEmit(jsonStream* pStream)
+{
+    char first = pStream->token[0];
+
+    pStream->token[pStream->tokenLen] = '\0';
+    if (strcmp(pStream->token, "true") == 0)
+    {
+        valueEmit(pStream, jsonTrue);
+    }
+    else if (strcmp(pStream->token, "false") == 0)
+    {
+        valueEmit(pStream, jsonFalse);
+    }
+    else if (strcmp(pStream->token, "null") == 0)
+    {
+        valueEmit(pStream, jsonNull);
+    }
+    else if (first == '-' || (first >= '0' && first <= '9'))
+    {
+        valueEmit(pStream, jsonNumber);
+    }
+    else
+    {
+        pStream->state = jsonStateError;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Opening a new object or array.
+ *
+ * \param  pStream - parser context.
+ * \param  isArray - array or object.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void containerOpen(jsonStream* pStream, bool isArray)
+{
+    if (pStream->depth >= JSON_STREAM_MAX_DEPTH)
+    {
+        pStream->state = jsonStateError;
+        return;
+    }
+
+    jsonLevel* pLevel = &pStream->levels[pStream->depth++];
+    pLevel->isArray = isArray;
+    pLevel->index = 0;
+    pLevel->key[0] = '\0';
+    pStream->state = isArray ? jsonStateValueOrEnd : jsonStateKeyOrEnd;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Closing the current object or array.
+ *
+ * \param  pStream - parser context.
+ * \param  isArray - expected type of the container.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void containerClose(jsonStream* pStream, bool isArray)
+{
+    if (pStream->depth == 0 || pStream->levels[pStream->depth - 1].isArray != isArray)
+    {
+        pStream->state = jsonStateError;
+        return;
+    }
+
+    pStream->depth--;
+    valueDone(pStream);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting a value.
+ *
+ * \param  pStream - parser context.
+ * \param  c - first character of the value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void valueStart(jsonStream* pStream, char c)
+{
+    pStream->tokenLen = 0;
+
+    if (c == '{')
+    {
+        containerOpen(pStream, false);
+    }
+    else if (c == '[')
+    {
+        containerOpen(pStream, true);
+    }
+    else if (c == '"')
+    {
+        pStream->inKey = false;
+        pStream->escape = 0;
+        pStream->state = jsonStateString;
+    }
+    else if (c == '-' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z'))
+    {
+        tokenPut(pStream, c);
+        pStream->state = jsonStateLiteral;
+    }
+    else
+    {
+        pStream->state = jsonStateError;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading a character of a string.
+ *
+ * \param  pStream - parser context.
+ * \param  c - character.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void stringPut(jsonStream* pStream, char c)
+{
+    if (pStream->escape > 1)
+    {
+        /* \uXXXX - the code point is replaced by a single '?'. */
+        if (++pStream->escape == 6)
+        {
+            tokenPut(pStream, '?');
+            pStream->escape = 0;
+        }
+        return;
+    }
+
+    if (pStream->escape == 1)
+    {
+        switch (c)
+        {
+        case 'u':
+            pStream->escape = 2;
+            return;
+        case 'n':
+            c = '\n';
+            break;
+        case 't':
+            c = '\t';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 'b':
+            c = '\b';
+            break;
+        case 'f':
+            c = '\f';
+            break;
+        default:
+            break;
+        }
+        tokenPut(pStream, c);
+        pStream->escape = 0;
+        return;
+    }
+
+    if (c == '\\')
+    {
+        pStream->escape = 1;
+        return;
+    }
+
+    if (c != '"')
+    {
+        tokenPut(pStream, c);
+        return;
+    }
+
+    /* End of the string. */
+    if (pStream->inKey)
+    {
+        jsonLevel* pLevel = &pStream->levels[pStream->depth - 1];
+        memcpy(pLevel->key, pStream->token, pStream->tokenLen);
+        pLevel->key[pStream->tokenLen] = '\0';
+        pStream->state = jsonStateColon;
+    }
+    else
+    {
+        valueEmit(pStream, jsonString);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing a single character.
+ *
+ * \param  pStream - parser context.
+ * \param  c - character.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void parseChar(jsonStream* pStream, char c)
+{
+    switch (pStream->state)
+    {
+    case jsonStateString:
+        stringPut(pStream, c);
+        return;
+    case jsonStateLiteral:
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '.' || c == '-' || c == '+')
+        {
+            tokenPut(pStream, c);
+            return;
+        }
+        literalEmit(pStream);
+        if (pStream->state == jsonStateError)
+        {
+            return;
+        }
+        /* The character ending the literal still needs to be parsed. */
+        break;
+    default:
+        break;
+    }
+
+    if (isSpace(c))
+    {
+        return;
+    }
+
+    switch (pStream->state)
+    {
+    case jsonStateValueOrEnd:
+        if (c == ']')
+        {
+            containerClose(pStream, true);
+            break;
+        }
+        valueStart(pStream, c);
+        break;
+    case jsonStateValue:
+        valueStart(pStream, c);
+        break;
+    case jsonStateKeyOrEnd:
+        if (c == '}')
+        {
+            containerClose(pStream, false);
+            break;
+        }
+        /* fall through */
+    case jsonStateKey:
+        if (c != '"')
+        {
+            pStream->state = jsonStateError;
+            break;
+        }
+        pStream->tokenLen = 0;
+        pStream->inKey = true;
+        pStream->escape = 0;
+        pStream->state = jsonStateString;
+        break;
+    case jsonStateColon:
+        pStream->state = (c == ':') ? jsonStateValue : jsonStateError;
+        break;
+    case jsonStateCommaOrEnd:
+        if (c == ',')
+        {
+            jsonLevel* pLevel = &pStream->levels[pStream->depth - 1];
+            if (pLevel->isArray)
+            {
+                pLevel->index++;
+                pStream->state = jsonStateValue;
+            }
+            else
+            {
+                pStream->state = jsonStateKey;
+            }
+        }
+        else if (c == ']' || c == '}')
+        {
+            containerClose(pStream, c == ']');
+        }
+        else
+        {
+            pStream->state = jsonStateError;
+        }
+        break;
+    default:
+        /* Only whitespace is allowed after the document. */
+        pStream->state = jsonStateError;
+        break;
+    }
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the parser for a new document.
+ *
+ * \param  pStream - parser context.
+ * \param  callback - function called for every value.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonStreamInit(jsonStream* pStream, jsonStreamCallback callback, void* pContext)
+{
+    memset(pStream, 0, sizeof(*pStream));
+    pStream->state = jsonStateValue;
+    pStream->callback = callback;
+    pStream->pContext = pContext;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the next chunk of the document.
+ *         Chunks do not need to be NUL-terminated and may split tokens.
+ *
+ * \param  pStream - parser context.
+ * \param  pData - chunk of the document.
+ * \param  len - length of the chunk.
+ *
+ * \return False if the document is not valid.
+ *
+ */
+/*********************************************************************/
+bool jsonStreamFeed(jsonStream* pStream, const char* pData, size_t len)
+{
+    size_t i = 0;
+
+    for (i = 0; i < len && pStream->state != jsonStateError; i++)
+    {
+        parseChar(pStream, pData[i]);
+    }
+
+    return pStream->state != jsonStateError;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the document after the last chunk.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return True if a complete and valid document was parsed.
+ *
+ */
+/*********************************************************************/
+bool jsonStreamFinish(jsonStream* pStream)
+{
+    /* A top-level number has no terminating character. */
+    if (pStream->state == jsonStateLiteral && pStream->depth == 0)
+    {
+        literalEmit(pStream);
+    }
+
+    return pStream->state == jsonStateDone;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking the key of the object at the given level.
+ *
+ * \param  pStream - parser context.
+ * \param  level - nesting level (0 - root).
+ * \param  pKey - expected key.
+ *
+ * \return True if the level is an object member with the given key.
+ *
+ */
+/*********************************************************************/
+bool jsonStreamKeyIs(const jsonStream* pStream, uint8_t level, const char* pKey)
+{
+    if (level >= pStream->depth || pStream->levels[level].isArray)
+    {
+        return false;
+    }
+
+    return strcmp(pStream->levels[level].key, pKey) == 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Converting a number token to an integer.
+ *
+ * \param  pValue - number token.
+ *
+ * \return Integer value (fraction is dropped), saturated
+ *         to INT32_MIN - INT32_MAX.
+ *
+ */
+/*********************************************************************/
+int32_t jsonStreamToInt(const char* pValue)
+{
+    uint32_t result = 0;
+    uint32_t limit = INT32_MAX;
+    uint32_t digit = 0;
+    bool negative = (*pValue == '-');
+
+    if (negative)
+    {
+        pValue++;
+        limit = (uint32_t)INT32_MAX + 1;
+    }
+    while (*pValue >= '0' && *pValue <= '9')
+    {
+        digit = *pValue++ - '0';
+        /* Longer numbers keep the limit, the remaining digits are skipped. */
+        result = (result > (limit - digit) / 10) ? limit : result * 10 + digit;
+    }
+
+    if (negative)
+    {
+        return (result == 0) ? 0 : -(int32_t)(result - 1) - 1;
+    }
+    return (int32_t)result;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Converting a number token to a float.
+ *
+ * \param  pValue - number token.
+ *
+ * \return Float value.
+ *
+ */
+/*********************************************************************/
+float jsonStreamToFloat(const char* pValue)
+{
+    float result = 0.0f;
+    float scale = 1.0f;
+    int32_t exponent = 0;
+    bool negative = (*pValue == '-');
+
+    if (negative)
+    {
+        pValue++;
+    }
+    while (*pValue >= '0' && *pValue <= '9')
+    {
+        result = result * 10.0f + (*pValue++ - '0');
+    }
+    if (*pValue == '.')
+    {
+        pValue++;
+        while (*pValue >= '0' && *pValue <= '9')
+        {
+            scale /= 10.0f;
+            result += (*pValue++ - '0') * scale;
+        }
+    }
+    if (*pValue == 'e' || *pValue == 'E')
+    {
+        exponent = jsonStreamToInt(pValue + 1 + (pValue[1] == '+'));
+        /* Every non-zero mantissa overflows or underflows before the limit,
+           so larger exponents do not change the result. */
+        if (exponent > JSON_FLOAT_MAX_EXPONENT)
+        {
+            exponent = JSON_FLOAT_MAX_EXPONENT;
+        }
+        else if (exponent < -JSON_FLOAT_MAX_EXPONENT)
+        {
+            exponent = -JSON_FLOAT_MAX_EXPONENT;
+        }
+        for (; exponent > 0; exponent--)
+        {
+            result *= 10.0f;
+        }
+        for (; exponent < 0; exponent++)
+        {
+            result /= 10.0f;
+        }
+    }
+
+    return negative ? -result : result;
+}
\ No newline at end of file
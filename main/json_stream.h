@@ -0,0 +1,164 @@
+/*********************************************************************/
+/*!
+*   \file   json_stream.h
+*
+*   \brief  Incremental JSON parser working on body chunks.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Maximum nesting of objects and arrays. */
+#define JSON_STREAM_MAX_DEPTH 6
+/* Maximum length of a key or a value, longer ones are truncated. */
+#define JSON_STREAM_MAX_TOKEN 24
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Type of the parsed value. */
+typedef enum
+{
+    jsonString,
+    jsonNumber,
+    jsonTrue,
+    jsonFalse,
+    jsonNull,
+} jsonValueType;
+
+/* Internal state of the parser. */
+typedef enum
+{
+    jsonStateValue,         //Expecting a value.
+    jsonStateValueOrEnd,    //Expecting a value or the end of an empty array.
+    jsonStateKeyOrEnd,      //Expecting a key or the end of an empty object.
+    jsonStateKey,           //Expecting a key.
+    jsonStateColon,         //Expecting a colon after the key.
+    jsonStateCommaOrEnd,    //Expecting a comma or the end of a container.
+    jsonStateString,        //Inside of a string.
+    jsonStateLiteral,       //Inside of a number, true, false or null.
+    jsonStateDone,          //Whole document parsed.
+    jsonStateError,         //Document is not valid.
+} jsonState;
+
+/* One level of nesting. */
+typedef struct
+{
+    bool isArray;                       //Array or object.
+    uint16_t index;                     //Index of the current array element.
+    char key[JSON_STREAM_MAX_TOKEN];    //Key of the current object member.
+} jsonLevel;
+
+typedef struct jsonStream jsonStream;
+
+/* Called for every scalar value in the document. */
+typedef void (*jsonStreamCallback)(const jsonStream* pStream, jsonValueType type, const char* pValue, void* pContext);
+
+/* Parser context, no dynamic memory is used. */
+struct jsonStream
+{
+    jsonState state;                            //Current state.
+    bool inKey;                                 //String being read is a key.
+    uint8_t escape;                             //Escape sequence progress.
+    uint8_t depth;                              //Current nesting.
+    uint8_t tokenLen;                           //Length of the token being read.
+    char token[JSON_STREAM_MAX_TOKEN];          //Token being read.
+    jsonLevel levels[JSON_STREAM_MAX_DEPTH];    //Path to the current value.
+    jsonStreamCallback callback;                //Value callback.
+    void* pContext;                             //Callback context.
+};
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the parser for a new document.
+ *
+ * \param  pStream - parser context.
+ * \param  callback - function called for every value.
+ * \param  pContext - pointer passed to the callback.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonStreamInit(jsonStream* pStream, jsonStreamCallback callback, void* pContext);
+
+/*********************************************************************/
+/*!
+ * \brief  Parsing the next chunk of the document.
+ *         Chunks do not need to be NUL-terminated and may split tokens.
+ *
+ * \param  pStream - parser context.
+ * \param  pData - chunk of the document.
+ * \param  len - length of the chunk.
+ *
+ * \return False if the document is not valid.
+ *
+ */
+/*********************************************************************/
+bool jsonStreamFeed(jsonStream* pStream, const char* pData, size_t len);
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the document after the last chunk.
+ *
+ * \param  pStream - parser context.
+ *
+ * \return True if a complete and valid document was parsed.
+ *
+ */
+/*********************************************************************/
+bool jsonStreamFinish(jsonStream* pStream);
+
+/*********************************************************************/
+/*!
+ * \brief  Checking the key of the object at the given level.
+ *
+ * \param  pStream - parser context.
+ * \param  level - nesting level (0 - root).
+ * \param  pKey - expected key.
+ *
+ * \return True if the level is an object member with the given key.
+ *
+ */
+/*********************************************************************/
+bool jsonStreamKeyIs(const jsonStream* pStream, uint8_t level, const char* pKey);
+
+/*********************************************************************/
+/*!
+ * \brief  Converting a number token to an integer.
+ *
+ * \param  pValue - number token.
+ *
+ * \return Integer value (fraction is dropped).
+ *
+ */
+/*********************************************************************/
+int32_t jsonStreamToInt(const char* pValue);
+
+/*********************************************************************/
+/*!
+ * \brief  Converting a number token to a float.
+ *
+ * \param  pValue - number token.
+ *
+ * \return Float value.
+ *
+ */
+/*********************************************************************/
+float jsonStreamToFloat(const char* pValue);
+
+#endif /*JSON_STREAM_H*/
\ No newline at end of file
@@ -0,0 +1,257 @@
+/*********************************************************************/
+/*!
+*   \file   json_writer.c
+*
+*   \brief  Compact JSON writer working on a caller-provided buffer.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "json_writer.h"
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Writing a single character.
+ *
+ * \param  pWriter - writer context.
+ * \param  c - character.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void writeChar(jsonWriter* pWriter, char c)
+{
+    /* One place is always left for the terminating NUL. */
+    if (pWriter->len + 1 >= pWriter->size)
+    {
+        pWriter->overflow = true;
+        return;
+    }
+    pWriter->pBuffer[pWriter->len++] = c;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a string without escaping.
+ *
+ * \param  pWriter - writer context.
+ * \param  pText - text.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void writeRaw(jsonWriter* pWriter, const char* pText)
+{
+    while (*pText != '\0')
+    {
+        writeChar(pWriter, *pText++);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing the separator before the next value if needed.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void writeSeparator(jsonWriter* pWriter)
+{
+    if (pWriter->needComma)
+    {
+        writeChar(pWriter, ',');
+    }
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the writer.
+ *
+ * \param  pWriter - writer context.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriterInit(jsonWriter* pWriter, char* pBuffer, size_t size)
+{
+    pWriter->pBuffer = pBuffer;
+    pWriter->size = size;
+    pWriter->len = 0;
+    pWriter->needComma = false;
+    pWriter->overflow = (size == 0);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Opening an object, as a value or an array element.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteObjectBegin(jsonWriter* pWriter)
+{
+    writeSeparator(pWriter);
+    writeChar(pWriter, '{');
+    pWriter->needComma = false;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Closing an object.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteObjectEnd(jsonWriter* pWriter)
+{
+    writeChar(pWriter, '}');
+    pWriter->needComma = true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Opening an array, as a value or an array element.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteArrayBegin(jsonWriter* pWriter)
+{
+    writeSeparator(pWriter);
+    writeChar(pWriter, '[');
+    pWriter->needComma = false;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Closing an array.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteArrayEnd(jsonWriter* pWriter)
+{
+    writeChar(pWriter, ']');
+    pWriter->needComma = true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a member key, the value has to follow.
+ *
+ * \param  pWriter - writer context.
+ * \param  pKey - key (written as is, without escaping).
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteKey(jsonWriter* pWriter, const char* pKey)
+{
+    writeSeparator(pWriter);
+    writeChar(pWriter, '"');
+    writeRaw(pWriter, pKey);
+    writeChar(pWriter, '"');
+    writeChar(pWriter, ':');
+    /* The value directly follows the key. */
+    pWriter->needComma = false;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing an integer value.
+ *
+ * \param  pWriter - writer context.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteInt(jsonWriter* pWriter, int64_t value)
+{
+    char digits[20];
+    uint8_t count = 0;
+    uint64_t magnitude = (value < 0) ? -(uint64_t)value : (uint64_t)value;
+
+    writeSeparator(pWriter);
+    if (value < 0)
+    {
+        writeChar(pWriter, '-');
+    }
+    do
+    {
+        digits[count++] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    while (count > 0)
+    {
+        writeChar(pWriter, digits[--count]);
+    }
+    pWriter->needComma = true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing an integer object member.
+ *
+ * \param  pWriter - writer context.
+ * \param  pKey - key.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteMemberInt(jsonWriter* pWriter, const char* pKey, int64_t value)
+{
+    jsonWriteKey(pWriter, pKey);
+    jsonWriteInt(pWriter, value);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the output.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return Length of the NUL-terminated output, -1 if it did not fit.
+ *
+ */
+/*********************************************************************/
+int jsonWriterFinish(jsonWriter* pWriter)
+{
+    if (pWriter->size > 0)
+    {
+        pWriter->pBuffer[pWriter->len] = '\0';
+    }
+
+    return pWriter->overflow ? -1 : (int)pWriter->len;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+/*********************************************************************/
+/*!
+*   \file   json_writer.h
+*
+*   \brief  Compact JSON writer working on a caller-provided buffer.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Writer context, no dynamic memory is used. */
+typedef struct
+{
+    char* pBuffer;      //Output buffer.
+    size_t size;        //Size of the output buffer.
+    size_t len;         //Number of characters written.
+    bool needComma;     //Next member or element needs a separator.
+    bool overflow;      //Output did not fit into the buffer.
+} jsonWriter;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the writer.
+ *
+ * \param  pWriter - writer context.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriterInit(jsonWriter* pWriter, char* pBuffer, size_t size);
+
+/*********************************************************************/
+/*!
+ * \brief  Opening an object, as a value or an array element.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteObjectBegin(jsonWriter* pWriter);
+
+/*********************************************************************/
+/*!
+ * \brief  Closing an object.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteObjectEnd(jsonWriter* pWriter);
+
+/*********************************************************************/
+/*!
+ * \brief  Opening an array, as a value or an array element.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteArrayBegin(jsonWriter* pWriter);
+
+/*********************************************************************/
+/*!
+ * \brief  Closing an array.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteArrayEnd(jsonWriter* pWriter);
+
+/*********************************************************************/
+/*!
+ * \brief  Writing a member key, the value has to follow.
+ *
+ * \param  pWriter - writer context.
+ * \param  pKey - key (written as is, without escaping).
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteKey(jsonWriter* pWriter, const char* pKey);
+
+/*********************************************************************/
+/*!
+ * \brief  Writing an integer value.
+ *
+ * \param  pWriter - writer context.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteInt(jsonWriter* pWriter, int64_t value);
+
+/*********************************************************************/
+/*!
+ * \brief  Writing an integer object member.
+ *
+ * \param  pWriter - writer context.
+ * \param  pKey - key.
+ * \param  value - value.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void jsonWriteMemberInt(jsonWriter* pWriter, const char* pKey, int64_t value);
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the output.
+ *
+ * \param  pWriter - writer context.
+ *
+ * \return Length of the NUL-terminated output, -1 if it did not fit.
+ *
+ */
+/*********************************************************************/
+int jsonWriterFinish(jsonWriter* pWriter);
+
+#endif /*JSON_WRITER_H*/
\ No newline at end of file
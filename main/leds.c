@@ -8,9 +8,9 @@
 *
 */
 /*********************************************************************/
-#include "driver/gpio.h"
 #include "esp_log.h"
 
+#include "hal.h"
 #include "leds.h"
 
 /**********************************************************************
@@ -36,16 +36,11 @@ void ledsGpioInit(void)
 {
     esp_err_t err = ESP_OK;
 
-    esp_rom_gpio_pad_select_gpio(lowHydrationStatus);
-    err += gpio_set_direction(lowHydrationStatus, GPIO_MODE_OUTPUT);
-    esp_rom_gpio_pad_select_gpio(moderateHydrationStatus);
-    err += gpio_set_direction(moderateHydrationStatus, GPIO_MODE_OUTPUT);
-    esp_rom_gpio_pad_select_gpio(goodHydrationStatus);
-    err += gpio_set_direction(goodHydrationStatus, GPIO_MODE_OUTPUT);
-    esp_rom_gpio_pad_select_gpio(servoStatus);
-    err += gpio_set_direction(servoStatus, GPIO_MODE_OUTPUT);
-    esp_rom_gpio_pad_select_gpio(wifiUiStatus);
-    err += gpio_set_direction(wifiUiStatus, GPIO_MODE_OUTPUT);
+    err += halGpioOutput(lowHydrationStatus);
+    err += halGpioOutput(moderateHydrationStatus);
+    err += halGpioOutput(goodHydrationStatus);
+    err += halGpioOutput(servoStatus);
+    err += halGpioOutput(wifiUiStatus);
 
     if (err == 0)
     {
@@ -69,7 +64,7 @@ void ledsGpioInit(void)
 /*********************************************************************/
 void turnOnLed(ledRole led)
 {
-    gpio_set_level(led, LED_ON);
+    halGpioSet(led, LED_ON);
 }
 
 /*********************************************************************/
@@ -84,5 +79,5 @@ void turnOnLed(ledRole led)
 /*********************************************************************/
 void turnOffLed(ledRole led)
 {
-    gpio_set_level(led, LED_OFF);
+    halGpioSet(led, LED_OFF);
 }
\ No newline at end of file
@@ -8,26 +8,74 @@
 *
 */
 /*********************************************************************/
+#include "esp_log.h"
+#include "nvs_flash.h"
+
+#include "metrics.h"
+#include "offline_queue.h"
+#include "power.h"
+#include "scheduler.h"
 #include "wifi.h"
 #include "sensor.h"
 #include "leds.h"
 #include "wifi_api.h"
 #include "servo.h"
 #include "task.h"
+#include "watering.h"
 
 #define BOARD 0
 
+#define TAG "main"
+
 void app_main(void)
 {
-    wifiInit();
+    uint16_t sensorIds[SENSOR_MAX];
+    uint8_t sensor = 0;
+    esp_err_t err = ESP_OK;
+
+    /* NVS is used on every wake, also on the ones without the radio. */
+    err = nvs_flash_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to init nvs flash: %s", esp_err_to_name(err));
+    }
+
+    for (sensor = 0; sensor < sensorCount(); sensor++)
+    {
+        sensorIds[sensor] = sensorGetId(sensor);
+    }
+
+    wifiApiInit(sensorIds, sensorCount());
+    powerInit();
+    /* Most wakes from deep sleep only sample, without the radio. */
+    if (powerRadioOn())
+    {
+        wifiInit();
+        metricsInit();
+        offlineQueueInit();
+    }
     ledsGpioInit();
-    sensorInit();
+    if (powerResumed())
+    {
+        sensorResume();
+    }
+    else
+    {
+        sensorInit();
+        taskInit();
+    }
 #if BOARD == 0
     servoInit();
+    wateringInit();
+    schedulerInit();
 #endif
 
     xTaskCreatePinnedToCore(taskSensor, "Task_sensor", 4096, NULL, 1, NULL, 0);
-    xTaskCreatePinnedToCore(taskWifi, "Task_wifi", 4096, NULL, 1, NULL, 1);
+    if (powerRadioOn())
+    {
+        xTaskCreatePinnedToCore(taskWifi, "Task_wifi", 4096, NULL, 1, NULL, 1);
+        xTaskCreatePinnedToCore(taskUploader, "Task_uploader", 4096, NULL, 1, NULL, 1);
+    }
 #if BOARD == 0
     xTaskCreatePinnedToCore(taskSprinklers, "Task_Sprinklers", 4096, NULL, 2, NULL, 1);
 #endif
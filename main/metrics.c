@@ -0,0 +1,416 @@
+/*********************************************************************/
+/*!
+*   \file   metrics.c
+*
+*   \brief  Runtime metrics of the tasks in the Prometheus text format.
+*
+*           Latencies are kept in fixed histograms updated with atomics,
+*           so recording never blocks the measured task. Stack and heap
+*           watermarks are read when the metrics are written.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_system.h"
+#endif
+#if CONFIG_METRICS_ENDPOINT
+#include "esp_http_server.h"
+#endif
+
+#include "metrics.h"
+#include "power.h"
+#include "task.h"
+#include "wifi.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define TAG "metrics"
+
+/* Length of the longest line of the metrics text. */
+#define METRICS_LINE_SIZE 160
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Latency histogram, buckets are not cumulative. */
+typedef struct
+{
+    atomic_uint buckets[METRICS_BUCKETS];   //Observations in each bucket.
+    atomic_uint count;                      //Number of observations.
+    atomic_ullong sumUs;                    //Sum of the observations [us].
+} metricsHistogram;
+
+/* Name of the histogram in the metrics text. */
+typedef struct
+{
+    const char* pFamily;    //Metric family.
+    const char* pHelp;      //Description of the family.
+    const char* pLabels;    //Labels of the histogram, without the braces.
+} metricsName;
+
+/* Tasks with a reported stack. */
+typedef struct
+{
+    TaskHandle_t handles[METRICS_MAX_TASKS];    //Registered tasks.
+    atomic_uint count;                          //Number of registered tasks.
+} metricsTasks;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+/* Upper bounds of the buckets [us], the last bucket has no bound. */
+static const uint32_t bucketBounds[METRICS_BUCKETS - 1] =
+{
+    100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000
+};
+
+static const metricsName names[metricCount] =
+{
+    [metricLoopSensor] = { "garden_loop_seconds", "Busy time of one task iteration.", "task=\"sensor\"" },
+    [metricLoopWifi] = { "garden_loop_seconds", "Busy time of one task iteration.", "task=\"wifi\"" },
+    [metricLoopUploader] = { "garden_loop_seconds", "Busy time of one task iteration.", "task=\"uploader\"" },
+    [metricLoopSprinklers] = { "garden_loop_seconds", "Busy time of one task iteration.", "task=\"sprinklers\"" },
+    [metricHttpGet] = { "garden_http_seconds", "Round trip of a rest api request.", "method=\"GET\"" },
+    [metricHttpPost] = { "garden_http_seconds", "Round trip of a rest api request.", "method=\"POST\"" },
+    [metricAdc] = { "garden_adc_seconds", "ADC acquisition of all sensors.", "" },
+    [metricWakeSample] = { "garden_wake_first_sample_seconds", "Wake-up to the first sample of the cycle.", "" },
+    [metricCycleActive] = { "garden_cycle_active_seconds", "Active time of one wake cycle.", "" },
+};
+
+static metricsHistogram histograms[metricCount];
+static metricsTasks tasks;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Writing one formatted line of the metrics text.
+ *
+ * \param  writer - function called with the line.
+ * \param  pContext - pointer passed to the writer.
+ * \param  pFormat - printf format of the line.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void metricsLine(metricsWriter writer, void* pContext, const char* pFormat, ...)
+{
+    char line[METRICS_LINE_SIZE];
+    va_list args;
+    int len = 0;
+
+    va_start(args, pFormat);
+    len = vsnprintf(line, sizeof(line), pFormat, args);
+    va_end(args);
+
+    if (len > 0)
+    {
+        writer(line, (len < (int)sizeof(line)) ? (size_t)len : sizeof(line) - 1, pContext);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing one histogram, with the header of its family
+ *         if it is the first one of the family.
+ *
+ * \param  metric - histogram.
+ * \param  writer - function called with the pieces of the text.
+ * \param  pContext - pointer passed to the writer.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void metricsWriteHistogram(metricId metric, metricsWriter writer, void* pContext)
+{
+    const metricsName* pName = &names[metric];
+    metricsHistogram* pHistogram = &histograms[metric];
+    bool hasLabels = (pName->pLabels[0] != '\0');
+    const char* pSeparator = hasLabels ? "," : "";
+    const char* pOpen = hasLabels ? "{" : "";
+    const char* pClose = hasLabels ? "}" : "";
+    uint32_t cumulative = 0;
+    uint8_t bucket = 0;
+
+    if (metric == 0 || strcmp(names[metric - 1].pFamily, pName->pFamily) != 0)
+    {
+        metricsLine(writer, pContext, "# HELP %s %s\n", pName->pFamily, pName->pHelp);
+        metricsLine(writer, pContext, "# TYPE %s histogram\n", pName->pFamily);
+    }
+
+    for (bucket = 0; bucket < METRICS_BUCKETS; bucket++)
+    {
+        cumulative += atomic_load_explicit(&pHistogram->buckets[bucket], memory_order_relaxed);
+        if (bucket < METRICS_BUCKETS - 1)
+        {
+            metricsLine(writer, pContext, "%s_bucket{%s%sle=\"%g\"} %lu\n", pName->pFamily, pName->pLabels,
+                        pSeparator, bucketBounds[bucket] / 1000000.0, (unsigned long)cumulative);
+        }
+        else
+        {
+            metricsLine(writer, pContext, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", pName->pFamily, pName->pLabels,
+                        pSeparator, (unsigned long)cumulative);
+        }
+    }
+    metricsLine(writer, pContext, "%s_sum%s%s%s %.6f\n", pName->pFamily, pOpen, pName->pLabels, pClose,
+                atomic_load_explicit(&pHistogram->sumUs, memory_order_relaxed) / 1000000.0);
+    metricsLine(writer, pContext, "%s_count%s%s%s %lu\n", pName->pFamily, pOpen, pName->pLabels, pClose,
+                (unsigned long)atomic_load_explicit(&pHistogram->count, memory_order_relaxed));
+}
+
+#if CONFIG_METRICS_ENDPOINT
+/*********************************************************************/
+/*!
+ * \brief  Sending a piece of the metrics text as a chunk of the response.
+ *
+ * \param  pText - piece of the text.
+ * \param  len - length of the piece.
+ * \param  pContext - request.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void metricsSendChunk(const char* pText, size_t len, void* pContext)
+{
+    httpd_resp_send_chunk((httpd_req_t*)pContext, pText, len);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  GET /metrics handler.
+ *
+ * \param  pRequest - request.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t metricsHandler(httpd_req_t* pRequest)
+{
+    httpd_resp_set_type(pRequest, "text/plain; version=0.0.4");
+    metricsWrite(metricsSendChunk, pRequest);
+    return httpd_resp_send_chunk(pRequest, NULL, 0);
+}
+#endif
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Metrics initialization, starts the /metrics endpoint
+ *         if CONFIG_METRICS_ENDPOINT is set.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void metricsInit(void)
+{
+#if CONFIG_METRICS_ENDPOINT
+    esp_err_t err = ESP_FAIL;
+    httpd_handle_t server = NULL;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    httpd_uri_t uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metricsHandler,
+    };
+
+    config.server_port = CONFIG_METRICS_PORT;
+    /* Only one connection is needed by a scraper. */
+    config.max_open_sockets = 2;
+
+    err = httpd_start(&server, &config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start metrics endpoint: %s", esp_err_to_name(err));
+        return;
+    }
+
+    err = httpd_register_uri_handler(server, &uri);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to register /metrics: %s", esp_err_to_name(err));
+        return;
+    }
+
+    ESP_LOGI(TAG, "Metrics on port %d", CONFIG_METRICS_PORT);
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Current time for latency measurements.
+ *
+ * \param  None
+ *
+ * \return Time [us].
+ *
+ */
+/*********************************************************************/
+int64_t metricsStart(void)
+{
+    return esp_timer_get_time();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Recording the latency since the start time.
+ *         May be called from any task.
+ *
+ * \param  metric - measured latency.
+ * \param  start - value returned by metricsStart().
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void metricsObserve(metricId metric, int64_t start)
+{
+    metricsHistogram* pHistogram = &histograms[metric];
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    uint8_t bucket = 0;
+
+    while (bucket < METRICS_BUCKETS - 1 && elapsed > bucketBounds[bucket])
+    {
+        bucket++;
+    }
+
+    atomic_fetch_add_explicit(&pHistogram->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pHistogram->sumUs, elapsed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pHistogram->count, 1, memory_order_relaxed);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reporting the stack high-water mark of the calling task.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void metricsRegisterTask(void)
+{
+    unsigned int index = atomic_fetch_add(&tasks.count, 1);
+
+    if (index >= METRICS_MAX_TASKS)
+    {
+        atomic_store(&tasks.count, METRICS_MAX_TASKS);
+        ESP_LOGW(TAG, "Too many tasks, %s not reported", pcTaskGetName(NULL));
+        return;
+    }
+    tasks.handles[index] = xTaskGetCurrentTaskHandle();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing all metrics in the Prometheus text format.
+ *
+ * \param  writer - function called with the pieces of the text.
+ * \param  pContext - pointer passed to the writer.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void metricsWrite(metricsWriter writer, void* pContext)
+{
+    unsigned int count = atomic_load(&tasks.count);
+    unsigned int task = 0;
+    uint8_t metric = 0;
+    httpStats stats;
+    powerStats power;
+
+    for (metric = 0; metric < metricCount; metric++)
+    {
+        metricsWriteHistogram(metric, writer, pContext);
+    }
+
+    metricsLine(writer, pContext, "# HELP garden_task_stack_free_bytes Smallest free stack since the task started.\n");
+    metricsLine(writer, pContext, "# TYPE garden_task_stack_free_bytes gauge\n");
+    for (task = 0; task < count && task < METRICS_MAX_TASKS; task++)
+    {
+        if (tasks.handles[task] != NULL)
+        {
+            metricsLine(writer, pContext, "garden_task_stack_free_bytes{task=\"%s\"} %lu\n",
+                        pcTaskGetName(tasks.handles[task]),
+                        (unsigned long)uxTaskGetStackHighWaterMark(tasks.handles[task]));
+        }
+    }
+
+#if !CONFIG_IDF_TARGET_LINUX
+    metricsLine(writer, pContext, "# TYPE garden_heap_free_bytes gauge\n");
+    metricsLine(writer, pContext, "garden_heap_free_bytes %lu\n", (unsigned long)esp_get_free_heap_size());
+    metricsLine(writer, pContext, "# TYPE garden_heap_min_free_bytes gauge\n");
+    metricsLine(writer, pContext, "garden_heap_min_free_bytes %lu\n", (unsigned long)esp_get_minimum_free_heap_size());
+#endif
+
+    restGetStats(&stats);
+    metricsLine(writer, pContext, "# TYPE garden_http_requests_total counter\n");
+    metricsLine(writer, pContext, "garden_http_requests_total %lu\n", (unsigned long)stats.requests);
+    metricsLine(writer, pContext, "# TYPE garden_http_failures_total counter\n");
+    metricsLine(writer, pContext, "garden_http_failures_total %lu\n", (unsigned long)stats.failures);
+    metricsLine(writer, pContext, "# TYPE garden_http_connections_total counter\n");
+    metricsLine(writer, pContext, "garden_http_connections_total %lu\n", (unsigned long)stats.connections);
+    metricsLine(writer, pContext, "# TYPE garden_http_reuses_total counter\n");
+    metricsLine(writer, pContext, "garden_http_reuses_total %lu\n", (unsigned long)stats.reuses);
+    metricsLine(writer, pContext, "# TYPE garden_http_conditional_total counter\n");
+    metricsLine(writer, pContext, "garden_http_conditional_total %lu\n", (unsigned long)stats.conditional);
+    metricsLine(writer, pContext, "# TYPE garden_http_not_modified_total counter\n");
+    metricsLine(writer, pContext, "garden_http_not_modified_total %lu\n", (unsigned long)stats.notModified);
+    metricsLine(writer, pContext, "# TYPE garden_push_streams_total counter\n");
+    metricsLine(writer, pContext, "garden_push_streams_total %lu\n", (unsigned long)stats.pushStreams);
+    metricsLine(writer, pContext, "# TYPE garden_push_events_total counter\n");
+    metricsLine(writer, pContext, "garden_push_events_total %lu\n", (unsigned long)stats.pushEvents);
+    metricsLine(writer, pContext, "# TYPE garden_link_downs_total counter\n");
+    metricsLine(writer, pContext, "garden_link_downs_total %lu\n", (unsigned long)stats.linkDowns);
+    metricsLine(writer, pContext, "# TYPE garden_reconnects_total counter\n");
+    metricsLine(writer, pContext, "garden_reconnects_total %lu\n", (unsigned long)stats.reconnects);
+    metricsLine(writer, pContext, "# HELP garden_boot_link_up_seconds Boot to the first IP address.\n");
+    metricsLine(writer, pContext, "# TYPE garden_boot_link_up_seconds gauge\n");
+    metricsLine(writer, pContext, "garden_boot_link_up_seconds %.6f\n", stats.linkUpUs / 1e6);
+    metricsLine(writer, pContext, "# HELP garden_boot_first_post_seconds Boot to the first successful POST.\n");
+    metricsLine(writer, pContext, "# TYPE garden_boot_first_post_seconds gauge\n");
+    metricsLine(writer, pContext, "garden_boot_first_post_seconds %.6f\n", stats.firstPostUs / 1e6);
+
+    powerGetStats(&power);
+    metricsLine(writer, pContext, "# TYPE garden_wake_cycles_total counter\n");
+    metricsLine(writer, pContext, "garden_wake_cycles_total %lu\n", (unsigned long)power.cycles);
+    metricsLine(writer, pContext, "# TYPE garden_radio_cycles_total counter\n");
+    metricsLine(writer, pContext, "garden_radio_cycles_total %lu\n", (unsigned long)power.radioCycles);
+    metricsLine(writer, pContext, "# TYPE garden_active_seconds_total counter\n");
+    metricsLine(writer, pContext, "garden_active_seconds_total %.3f\n", power.totalActiveUs / 1e6);
+    metricsLine(writer, pContext, "# TYPE garden_sleep_seconds_total counter\n");
+    metricsLine(writer, pContext, "garden_sleep_seconds_total %.3f\n", power.totalSleepMs / 1e3);
+
+    metricsLine(writer, pContext, "# HELP garden_samples_dropped_total Samples lost because the sample buffer was full.\n");
+    metricsLine(writer, pContext, "# TYPE garden_samples_dropped_total counter\n");
+    metricsLine(writer, pContext, "garden_samples_dropped_total %u\n", taskSamplesDropped());
+
+    metricsLine(writer, pContext, "# TYPE garden_uptime_seconds gauge\n");
+    metricsLine(writer, pContext, "garden_uptime_seconds %lld\n", (long long)(esp_timer_get_time() / 1000000));
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+/*********************************************************************/
+/*!
+*   \file   metrics.h
+*
+*   \brief  Runtime metrics of the tasks in the Prometheus text format.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Number of latency buckets, the last one is +Inf. */
+#define METRICS_BUCKETS 11
+/* Maximum number of tasks with a reported stack. */
+#define METRICS_MAX_TASKS 8
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Measured latency. */
+typedef enum
+{
+    metricLoopSensor,       //Iteration of taskSensor.
+    metricLoopWifi,         //Iteration of taskWifi.
+    metricLoopUploader,     //Iteration of taskUploader.
+    metricLoopSprinklers,   //Iteration of taskSprinklers.
+    metricHttpGet,          //HTTP GET round trip.
+    metricHttpPost,         //HTTP POST round trip.
+    metricAdc,              //ADC acquisition of all sensors.
+    metricWakeSample,       //Wake-up to the first sample of the cycle.
+    metricCycleActive,      //Active time of one wake cycle.
+    metricCount,
+} metricId;
+
+/* Called with every piece of the metrics text. */
+typedef void (*metricsWriter)(const char* pText, size_t len, void* pContext);
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Metrics initialization, starts the /metrics endpoint
+ *         if CONFIG_METRICS_ENDPOINT is set.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void metricsInit(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Current time for latency measurements.
+ *
+ * \param  None
+ *
+ * \return Time [us].
+ *
+ */
+/*********************************************************************/
+int64_t metricsStart(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Recording the latency since the start time.
+ *         May be called from any task.
+ *
+ * \param  metric - measured latency.
+ * \param  start - value returned by metricsStart().
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void metricsObserve(metricId metric, int64_t start);
+
+/*********************************************************************/
+/*!
+ * \brief  Reporting the stack high-water mark of the calling task.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void metricsRegisterTask(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Writing all metrics in the Prometheus text format.
+ *
+ * \param  writer - function called with the pieces of the text.
+ * \param  pContext - pointer passed to the writer.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void metricsWrite(metricsWriter writer, void* pContext);
+
+#endif /*METRICS_H*/
\ No newline at end of file
@@ -0,0 +1,324 @@
+/*********************************************************************/
+/*!
+*   \file   offline_queue.c
+*
+*   \brief  Flash-backed queue of samples which could not be sent.
+*
+*           Samples are kept in NVS blobs of OFFLINE_PAGE_SAMPLES samples,
+*           NVS takes care of wear levelling. Pages are numbered with
+*           a running sequence, "head" is the oldest page and "tail" the
+*           page being filled. Only the uploader task uses the queue.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "offline_queue.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define TAG "offline"
+
+#define NVS_NAMESPACE "offline"
+#define NVS_KEY_HEAD "head"
+#define NVS_KEY_TAIL "tail"
+
+/* Maximum number of pages kept in flash. */
+#define OFFLINE_QUEUE_PAGES CONFIG_OFFLINE_QUEUE_PAGES
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* State of the queue. */
+typedef struct
+{
+    nvs_handle_t nvs;                               //NVS namespace handle.
+    uint32_t head;                                  //Sequence of the oldest page.
+    uint32_t tail;                                  //Sequence of the page being filled.
+    size_t tailCount;                               //Samples in the page being filled.
+    sensorSample tailPage[OFFLINE_PAGE_SAMPLES];    //Copy of the page being filled.
+    bool ready;                                     //Queue initialized.
+} offlineQueue;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+static offlineQueue queue;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  NVS key of the page.
+ *
+ * \param  sequence - page sequence.
+ * \param  pKey - where the key is stored (NVS_KEY_NAME_MAX_SIZE).
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void pageKey(uint32_t sequence, char* pKey)
+{
+    snprintf(pKey, NVS_KEY_NAME_MAX_SIZE, "p%lu", (unsigned long)(sequence % OFFLINE_QUEUE_PAGES));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing the page being filled.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t tailPageWrite(void)
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    pageKey(queue.tail, key);
+    return nvs_set_blob(queue.nvs, key, queue.tailPage, queue.tailCount * sizeof(sensorSample));
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Dropping the oldest full page.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t headPageErase(void)
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    esp_err_t err = ESP_OK;
+
+    pageKey(queue.head, key);
+    err = nvs_erase_key(queue.nvs, key);
+    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    {
+        return err;
+    }
+
+    queue.head++;
+    return nvs_set_u32(queue.nvs, NVS_KEY_HEAD, queue.head);
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Queue initialization, restores samples stored before reset.
+ *         NVS has to be initialized first.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t offlineQueueInit(void)
+{
+    esp_err_t err = ESP_FAIL;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    size_t size = sizeof(queue.tailPage);
+
+    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &queue.nvs);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    queue.head = 0;
+    queue.tail = 0;
+    nvs_get_u32(queue.nvs, NVS_KEY_HEAD, &queue.head);
+    nvs_get_u32(queue.nvs, NVS_KEY_TAIL, &queue.tail);
+    if (queue.tail - queue.head >= OFFLINE_QUEUE_PAGES)
+    {
+        /* Sequences do not match the configuration, start over. */
+        queue.head = queue.tail;
+    }
+
+    pageKey(queue.tail, key);
+    if (nvs_get_blob(queue.nvs, key, queue.tailPage, &size) != ESP_OK)
+    {
+        size = 0;
+    }
+    queue.tailCount = size / sizeof(sensorSample);
+    queue.ready = true;
+
+    ESP_LOGI(TAG, "Offline queue holds %u samples", (unsigned)offlineQueueCount());
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Appending samples at the end of the queue.
+ *         When the queue is full the oldest page is dropped.
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t offlineQueuePush(const sensorSample* pSamples, size_t count)
+{
+    esp_err_t err = ESP_OK;
+    size_t i = 0;
+
+    if (!queue.ready)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (i = 0; i < count && err == ESP_OK; i++)
+    {
+        queue.tailPage[queue.tailCount++] = pSamples[i];
+        if (queue.tailCount < OFFLINE_PAGE_SAMPLES)
+        {
+            continue;
+        }
+
+        /* Page full, continue with the next one. */
+        err = tailPageWrite();
+        queue.tail++;
+        queue.tailCount = 0;
+        if (err == ESP_OK && queue.tail - queue.head >= OFFLINE_QUEUE_PAGES)
+        {
+            ESP_LOGW(TAG, "Offline queue full, oldest samples dropped");
+            err = headPageErase();
+        }
+    }
+
+    if (err == ESP_OK && queue.tailCount > 0)
+    {
+        err = tailPageWrite();
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_set_u32(queue.nvs, NVS_KEY_TAIL, queue.tail);
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(queue.nvs);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to store samples: %s", esp_err_to_name(err));
+    }
+
+    return err;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the oldest page without removing it.
+ *
+ * \param  pSamples - where OFFLINE_PAGE_SAMPLES samples can be stored.
+ *
+ * \return Number of samples in the page, 0 if the queue is empty.
+ *
+ */
+/*********************************************************************/
+size_t offlineQueuePeekPage(sensorSample* pSamples)
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    size_t size = OFFLINE_PAGE_SAMPLES * sizeof(sensorSample);
+
+    if (!queue.ready)
+    {
+        return 0;
+    }
+
+    if (queue.head == queue.tail)
+    {
+        memcpy(pSamples, queue.tailPage, queue.tailCount * sizeof(sensorSample));
+        return queue.tailCount;
+    }
+
+    pageKey(queue.head, key);
+    if (nvs_get_blob(queue.nvs, key, pSamples, &size) != ESP_OK)
+    {
+        /* Lost page, skip it. */
+        ESP_LOGW(TAG, "Offline page %s not readable, dropped", key);
+        offlineQueueDropPage();
+        return 0;
+    }
+
+    return size / sizeof(sensorSample);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Removing the oldest page.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t offlineQueueDropPage(void)
+{
+    esp_err_t err = ESP_OK;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    if (!queue.ready)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (queue.head == queue.tail)
+    {
+        /* The page being filled is emptied, not advanced. */
+        queue.tailCount = 0;
+        pageKey(queue.tail, key);
+        err = nvs_erase_key(queue.nvs, key);
+        if (err == ESP_ERR_NVS_NOT_FOUND)
+        {
+            err = ESP_OK;
+        }
+    }
+    else
+    {
+        err = headPageErase();
+    }
+
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(queue.nvs);
+    }
+    return err;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Number of samples in the queue.
+ *
+ * \param  None
+ *
+ * \return Number of samples.
+ *
+ */
+/*********************************************************************/
+size_t offlineQueueCount(void)
+{
+    return (queue.tail - queue.head) * OFFLINE_PAGE_SAMPLES + queue.tailCount;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*********************************************************************/
+/*!
+*   \file   offline_queue.h
+*
+*   \brief  Flash-backed queue of samples which could not be sent.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef OFFLINE_QUEUE_H
+#define OFFLINE_QUEUE_H
+
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "sample_ring.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Number of samples stored in one flash page (NVS blob). */
+#define OFFLINE_PAGE_SAMPLES 16
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Queue initialization, restores samples stored before reset.
+ *         NVS has to be initialized first.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t offlineQueueInit(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Appending samples at the end of the queue.
+ *         When the queue is full the oldest page is dropped.
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t offlineQueuePush(const sensorSample* pSamples, size_t count);
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the oldest page without removing it.
+ *
+ * \param  pSamples - where OFFLINE_PAGE_SAMPLES samples can be stored.
+ *
+ * \return Number of samples in the page, 0 if the queue is empty.
+ *
+ */
+/*********************************************************************/
+size_t offlineQueuePeekPage(sensorSample* pSamples);
+
+/*********************************************************************/
+/*!
+ * \brief  Removing the oldest page.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t offlineQueueDropPage(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Number of samples in the queue.
+ *
+ * \param  None
+ *
+ * \return Number of samples.
+ *
+ */
+/*********************************************************************/
+size_t offlineQueueCount(void);
+
+#endif /*OFFLINE_QUEUE_H*/
\ No newline at end of file
@@ -0,0 +1,357 @@
+/*********************************************************************/
+/*!
+*   \file   power.c
+*
+*   \brief  Power saving between sensor passes.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdatomic.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+
+#include "hal.h"
+#include "metrics.h"
+#include "power.h"
+#include "servo.h"
+#include "wifi.h"
+#include "wifi_api.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define TAG "power"
+
+/* Marks valid kept state, anything else is a power-on. */
+#define POWER_MAGIC 0x50575231u
+
+/* Radio work of every wake with the radio. */
+#define POWER_WORK_ALL (powerWorkCommands | powerWorkUpload)
+/* How often finished radio work is checked while waiting [ms]. */
+#define POWER_POLL_MS 1000
+/* Sleep before a wake which starts the radio [ms]. */
+#define POWER_RADIO_RESTART_MS 1
+/* Longest wait for the valve to finish its last move before deep sleep [ms]. */
+#define POWER_SERVO_WAIT_MS 3000
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* State kept through deep sleep. */
+typedef struct
+{
+    uint32_t magic;         //POWER_MAGIC if the members are valid.
+    wifiApi command;        //Last command from the website.
+    bool radioNext;         //Next wake starts the radio.
+    powerStats stats;       //Cycle statistics.
+} powerRetained;
+
+/* State of the current wake cycle. */
+typedef struct
+{
+    bool resumed;           //Woke from deep sleep with the state kept.
+    bool radio;             //Radio is used in this cycle.
+    bool sampled;           //First sample of the cycle taken.
+    int64_t wakeUs;         //Start of the cycle (metricsStart() time).
+    atomic_uint work;       //Finished radio work (powerWork bits).
+    SemaphoreHandle_t lock; //Access to the statistics.
+} powerCycle;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+HAL_RETAINED static powerRetained retained;
+static powerCycle cycle;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Recording the active time of the finished cycle.
+ *
+ * \param  sleepMs - sleep which follows [ms].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void powerCycleEnd(uint32_t sleepMs)
+{
+    uint32_t activeUs = (uint32_t)(metricsStart() - cycle.wakeUs);
+
+    metricsObserve(metricCycleActive, cycle.wakeUs);
+
+    xSemaphoreTake(cycle.lock, portMAX_DELAY);
+    retained.stats.cycles++;
+    retained.stats.radioCycles += cycle.radio ? 1 : 0;
+    retained.stats.lastActiveUs = activeUs;
+    retained.stats.totalActiveUs += activeUs;
+    retained.stats.totalSleepMs += sleepMs;
+    xSemaphoreGive(cycle.lock);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting a new cycle after a wake-up.
+ *
+ * \param  radio - radio is used in the cycle.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void powerCycleBegin(bool radio)
+{
+    cycle.radio = radio;
+    cycle.sampled = false;
+    cycle.wakeUs = metricsStart();
+    atomic_store(&cycle.work, 0);
+}
+
+#if CONFIG_POWER_SAVE_DEEP
+/*********************************************************************/
+/*!
+ * \brief  Keeping the state and entering deep sleep.
+ *
+ * \param  ms - sleep time [ms].
+ * \param  radioNext - the next wake starts the radio.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void powerDeepSleep(uint32_t ms, bool radioNext)
+{
+    powerCycleEnd(ms);
+    wifiApiRead(&retained.command);
+    retained.radioNext = radioNext;
+
+    ESP_LOGI(TAG, "Cycle %lu: first sample after %lu us, active %lu us, sleeping %lu ms%s",
+             (unsigned long)retained.stats.cycles, (unsigned long)retained.stats.lastWakeToSampleUs,
+             (unsigned long)retained.stats.lastActiveUs, (unsigned long)ms, radioNext ? ", radio next" : "");
+
+    if (cycle.radio)
+    {
+        wifiStop();
+    }
+    /* Deep sleep cuts the PWM, a closing valve would stay half open. */
+    if (!servoWaitIdle(POWER_SERVO_WAIT_MS))
+    {
+        ESP_LOGW(TAG, "Servo still moving, sleeping anyway");
+    }
+    halDeepSleep(ms);
+
+    /* Only a failed restart of the simulation gets here, with the whole memory kept. */
+    powerCycleBegin(radioNext);
+}
+#endif
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Power initialization, restores the kept command after
+ *         a deep sleep. wifiApiInit() has to be called first.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerInit(void)
+{
+    esp_err_t err = ESP_OK;
+
+    cycle.lock = xSemaphoreCreateMutex();
+    if (cycle.lock == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create power lock");
+    }
+
+    cycle.resumed = halWokeFromDeepSleep() && retained.magic == POWER_MAGIC;
+    if (cycle.resumed)
+    {
+        wifiApiRestore(&retained.command);
+    }
+    else
+    {
+        memset(&retained, 0, sizeof(retained));
+        retained.magic = POWER_MAGIC;
+    }
+
+    powerCycleBegin(!cycle.resumed || retained.radioNext);
+    /* esp_timer counts from the reset, which is the wake-up. */
+    cycle.wakeUs = 0;
+
+#if CONFIG_POWER_SAVE_LIGHT
+    err = halLightSleepEnable();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to enable light sleep: %s", esp_err_to_name(err));
+    }
+#endif
+
+    ESP_LOGI(TAG, "%s, radio %s", cycle.resumed ? "Woke from deep sleep" : "Power-on",
+             cycle.radio ? "on" : "off");
+    (void)err;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the board woke from deep sleep with its state kept.
+ *
+ * \param  None
+ *
+ * \return True after a deep sleep.
+ *
+ */
+/*********************************************************************/
+bool powerResumed(void)
+{
+    return cycle.resumed;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the radio is used in this wake cycle.
+ *
+ * \param  None
+ *
+ * \return True if wifiInit() and the network tasks are needed.
+ *
+ */
+/*********************************************************************/
+bool powerRadioOn(void)
+{
+    return cycle.radio;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reporting a finished sensor pass, the first one
+ *         of the cycle gives the wake-to-first-sample latency.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerSampled(void)
+{
+    if (cycle.sampled)
+    {
+        return;
+    }
+    cycle.sampled = true;
+
+    metricsObserve(metricWakeSample, cycle.wakeUs);
+    xSemaphoreTake(cycle.lock, portMAX_DELAY);
+    retained.stats.lastWakeToSampleUs = (uint32_t)(metricsStart() - cycle.wakeUs);
+    xSemaphoreGive(cycle.lock);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reporting finished radio work of the cycle.
+ *         May be called from any task.
+ *
+ * \param  work - finished work.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerRadioDone(powerWork work)
+{
+    atomic_fetch_or(&cycle.work, work);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting for the next sensor pass, sleeping if possible.
+ *         Returns earlier when the commands change. In deep sleep mode
+ *         the target does not return, it starts again from app_main().
+ *
+ * \param  interval - time to the next pass [ms].
+ * \param  busy - watering is active, the board has to stay awake.
+ * \param  uploadDue - samples wait for upload, the radio is needed.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerIdle(uint32_t interval, bool busy, bool uploadDue)
+{
+#if CONFIG_POWER_SAVE_DEEP
+    int64_t end = metricsStart() + (int64_t)interval * 1000;
+    int64_t remaining = 0;
+
+    if (!busy && !cycle.radio)
+    {
+        /* Samples only go out from a wake with the radio. */
+        if (uploadDue)
+        {
+            powerDeepSleep(POWER_RADIO_RESTART_MS, true);
+        }
+        else
+        {
+            powerDeepSleep(interval, false);
+        }
+        return;
+    }
+
+    /* The radio sleeps once the commands are read and the samples sent. */
+    while (!busy && (remaining = (end - metricsStart()) / 1000) > 0)
+    {
+        if ((atomic_load(&cycle.work) & POWER_WORK_ALL) == POWER_WORK_ALL ||
+            metricsStart() - cycle.wakeUs >= CONFIG_POWER_RADIO_TIMEOUT_S * 1000000LL)
+        {
+            powerDeepSleep(remaining, false);
+            return;
+        }
+        if (wifiApiWaitChange(WIFI_API_SENSOR_BIT, ((remaining < POWER_POLL_MS) ? remaining : POWER_POLL_MS) / portTICK_PERIOD_MS))
+        {
+            return;
+        }
+    }
+    if (!busy)
+    {
+        return;
+    }
+#endif
+
+    /* Light sleep, if enabled, happens by itself while the task waits. */
+    powerCycleEnd(interval);
+    wifiApiWaitChange(WIFI_API_SENSOR_BIT, interval / portTICK_PERIOD_MS);
+    powerCycleBegin(cycle.radio);
+    (void)busy;
+    (void)uploadDue;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the sleep cycle statistics.
+ *
+ * \param  pStats - Pointer where the statistics are stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerGetStats(powerStats* pStats)
+{
+    xSemaphoreTake(cycle.lock, portMAX_DELAY);
+    *pStats = retained.stats;
+    xSemaphoreGive(cycle.lock);
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+/*********************************************************************/
+/*!
+*   \file   power.h
+*
+*   \brief  Power saving between sensor passes.
+*
+*           CONFIG_POWER_SAVE_LIGHT lets the chip light sleep whenever
+*           all tasks are blocked. CONFIG_POWER_SAVE_DEEP puts the board
+*           into deep sleep while no watering is active; the samples,
+*           filters and the last command are kept in RTC memory and
+*           most wakes only sample, without starting the radio.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Radio work finished before the board may sleep again. */
+typedef enum
+{
+    powerWorkCommands = 1,  //Commands read from the website.
+    powerWorkUpload = 2,    //Samples sent.
+} powerWork;
+
+/* Statistics of the sleep cycles, kept through deep sleep. */
+typedef struct
+{
+    uint32_t cycles;                //Finished wake cycles.
+    uint32_t radioCycles;           //Cycles with the radio started.
+    uint32_t lastWakeToSampleUs;    //Wake-up to the first sample of the last cycle [us].
+    uint32_t lastActiveUs;          //Active time of the last cycle [us].
+    uint64_t totalActiveUs;         //Active time of all cycles [us].
+    uint64_t totalSleepMs;          //Requested sleep of all cycles [ms].
+} powerStats;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Power initialization, restores the kept command after
+ *         a deep sleep. wifiApiInit() has to be called first.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerInit(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the board woke from deep sleep with its state kept.
+ *
+ * \param  None
+ *
+ * \return True after a deep sleep.
+ *
+ */
+/*********************************************************************/
+bool powerResumed(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the radio is used in this wake cycle.
+ *
+ * \param  None
+ *
+ * \return True if wifiInit() and the network tasks are needed.
+ *
+ */
+/*********************************************************************/
+bool powerRadioOn(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Reporting a finished sensor pass, the first one
+ *         of the cycle gives the wake-to-first-sample latency.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerSampled(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Reporting finished radio work of the cycle.
+ *         May be called from any task.
+ *
+ * \param  work - finished work.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerRadioDone(powerWork work);
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting for the next sensor pass, sleeping if possible.
+ *         Returns earlier when the commands change. In deep sleep mode
+ *         the target does not return, it starts again from app_main().
+ *
+ * \param  interval - time to the next pass [ms].
+ * \param  busy - watering is active, the board has to stay awake.
+ * \param  uploadDue - samples wait for upload, the radio is needed.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerIdle(uint32_t interval, bool busy, bool uploadDue);
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the sleep cycle statistics.
+ *
+ * \param  pStats - Pointer where the statistics are stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void powerGetStats(powerStats* pStats);
+
+#endif /*POWER_H*/
\ No newline at end of file
@@ -0,0 +1,137 @@
+/*********************************************************************/
+/*!
+*   \file   sample_rate.c
+*
+*   \brief  Sampling interval adapted to the change of the readings.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <string.h>
+
+#include "sample_rate.h"
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the interval state, sampling starts fast.
+ *
+ * \param  pRate - interval state.
+ * \param  minInterval - shortest interval [ms].
+ * \param  maxInterval - longest interval [ms].
+ * \param  threshold - change between samples regarded as movement [%].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRateInit(sampleRate* pRate, uint32_t minInterval, uint32_t maxInterval, uint8_t threshold)
+{
+    memset(pRate, 0, sizeof(*pRate));
+    pRate->minInterval = minInterval;
+    pRate->maxInterval = (maxInterval > minInterval) ? maxInterval : minInterval;
+    pRate->threshold = (threshold > 0) ? threshold : 1;
+    pRate->interval = minInterval;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a reading of one sensor to the current pass.
+ *
+ * \param  pRate - interval state.
+ * \param  sensor - index of the sensor (0 - SENSOR_MAX-1).
+ * \param  percentage - reading [%].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRateAdd(sampleRate* pRate, uint8_t sensor, uint8_t percentage)
+{
+    uint8_t change = 0;
+
+    if (sensor >= SENSOR_MAX)
+    {
+        return;
+    }
+
+    /* The first reading of a sensor has nothing to compare with. */
+    if (pRate->known & (1 << sensor))
+    {
+        change = (percentage > pRate->last[sensor]) ? percentage - pRate->last[sensor]
+                                                     : pRate->last[sensor] - percentage;
+        if (change > pRate->change)
+        {
+            pRate->change = change;
+        }
+    }
+    pRate->last[sensor] = percentage;
+    pRate->known |= (1 << sensor);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Forgetting the last reading of a sensor which is not sampled.
+ *
+ * \param  pRate - interval state.
+ * \param  sensor - index of the sensor (0 - SENSOR_MAX-1).
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRateForget(sampleRate* pRate, uint8_t sensor)
+{
+    if (sensor < SENSOR_MAX)
+    {
+        pRate->known &= ~(1 << sensor);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Going back to the shortest interval, e.g. while watering.
+ *
+ * \param  pRate - interval state.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRateBoost(sampleRate* pRate)
+{
+    pRate->interval = pRate->minInterval;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the pass and choosing the next interval.
+ *
+ * \param  pRate - interval state.
+ *
+ * \return Time to the next pass [ms].
+ *
+ */
+/*********************************************************************/
+uint32_t sampleRateNext(sampleRate* pRate)
+{
+    if (pRate->change >= pRate->threshold)
+    {
+        /* Moving readings, full resolution at once. */
+        pRate->interval = pRate->minInterval;
+    }
+    else if (pRate->interval < pRate->maxInterval / 2)
+    {
+        pRate->interval *= 2;
+    }
+    else
+    {
+        pRate->interval = pRate->maxInterval;
+    }
+    pRate->change = 0;
+
+    return pRate->interval;
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*********************************************************************/
+/*!
+*   \file   sample_rate.h
+*
+*   \brief  Sampling interval adapted to the change of the readings.
+*
+*           Moving readings are sampled at the shortest interval,
+*           every flat pass doubles it up to the longest one.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef SAMPLE_RATE_H
+#define SAMPLE_RATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sensor.h"
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Interval state, no dynamic memory is used. */
+typedef struct
+{
+    uint32_t minInterval;           //Shortest interval [ms].
+    uint32_t maxInterval;           //Longest interval [ms].
+    uint8_t threshold;              //Change regarded as movement [%].
+
+    uint32_t interval;              //Current interval [ms].
+    uint8_t last[SENSOR_MAX];       //Last reading of each sensor [%].
+    uint8_t known;                  //Bit per sensor, last reading is valid.
+    uint8_t change;                 //Largest change in the current pass [%].
+} sampleRate;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the interval state, sampling starts fast.
+ *
+ * \param  pRate - interval state.
+ * \param  minInterval - shortest interval [ms].
+ * \param  maxInterval - longest interval [ms].
+ * \param  threshold - change between samples regarded as movement [%].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRateInit(sampleRate* pRate, uint32_t minInterval, uint32_t maxInterval, uint8_t threshold);
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a reading of one sensor to the current pass.
+ *
+ * \param  pRate - interval state.
+ * \param  sensor - index of the sensor (0 - SENSOR_MAX-1).
+ * \param  percentage - reading [%].
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRateAdd(sampleRate* pRate, uint8_t sensor, uint8_t percentage);
+
+/*********************************************************************/
+/*!
+ * \brief  Forgetting the last reading of a sensor which is not sampled.
+ *
+ * \param  pRate - interval state.
+ * \param  sensor - index of the sensor (0 - SENSOR_MAX-1).
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRateForget(sampleRate* pRate, uint8_t sensor);
+
+/*********************************************************************/
+/*!
+ * \brief  Going back to the shortest interval, e.g. while watering.
+ *
+ * \param  pRate - interval state.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRateBoost(sampleRate* pRate);
+
+/*********************************************************************/
+/*!
+ * \brief  Finishing the pass and choosing the next interval.
+ *
+ * \param  pRate - interval state.
+ *
+ * \return Time to the next pass [ms].
+ *
+ */
+/*********************************************************************/
+uint32_t sampleRateNext(sampleRate* pRate);
+
+#endif /*SAMPLE_RATE_H*/
\ No newline at end of file
@@ -0,0 +1,156 @@
+/*********************************************************************/
+/*!
+*   \file   sample_ring.c
+*
+*   \brief  Lock-free ring buffer of sensor samples waiting for upload.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "sample_ring.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define SAMPLE_RING_MASK (SAMPLE_RING_SIZE - 1)
+
+_Static_assert((SAMPLE_RING_SIZE & SAMPLE_RING_MASK) == 0, "SAMPLE_RING_SIZE has to be a power of two");
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Ring initialization.
+ *
+ * \param  pRing - ring.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRingInit(sampleRing* pRing)
+{
+    atomic_init(&pRing->head, 0);
+    atomic_init(&pRing->tail, 0);
+    atomic_init(&pRing->dropped, 0);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a sample, called only by the producer.
+ *
+ * \param  pRing - ring.
+ * \param  pSample - sample to add.
+ *
+ * \return False if the ring is full and the sample was dropped.
+ *
+ */
+/*********************************************************************/
+bool sampleRingPush(sampleRing* pRing, const sensorSample* pSample)
+{
+    unsigned int head = atomic_load_explicit(&pRing->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&pRing->tail, memory_order_acquire);
+
+    if (head - tail >= SAMPLE_RING_SIZE)
+    {
+        atomic_fetch_add_explicit(&pRing->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    pRing->samples[head & SAMPLE_RING_MASK] = *pSample;
+    /* Publish the sample only after it was written. */
+    atomic_store_explicit(&pRing->head, head + 1, memory_order_release);
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Copying the oldest samples without removing them,
+ *         called only by the consumer.
+ *
+ * \param  pRing - ring.
+ * \param  pSamples - where the samples are copied.
+ * \param  max - maximum number of samples to copy.
+ *
+ * \return Number of copied samples.
+ *
+ */
+/*********************************************************************/
+size_t sampleRingPeek(sampleRing* pRing, sensorSample* pSamples, size_t max)
+{
+    unsigned int tail = atomic_load_explicit(&pRing->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&pRing->head, memory_order_acquire);
+    size_t count = head - tail;
+    size_t i = 0;
+
+    if (count > max)
+    {
+        count = max;
+    }
+    for (i = 0; i < count; i++)
+    {
+        pSamples[i] = pRing->samples[(tail + i) & SAMPLE_RING_MASK];
+    }
+
+    return count;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Removing the oldest samples, called only by the consumer.
+ *
+ * \param  pRing - ring.
+ * \param  count - number of samples to remove.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRingDrop(sampleRing* pRing, size_t count)
+{
+    unsigned int tail = atomic_load_explicit(&pRing->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&pRing->head, memory_order_acquire);
+
+    if (count > head - tail)
+    {
+        count = head - tail;
+    }
+    /* Release the slots only after they were read. */
+    atomic_store_explicit(&pRing->tail, tail + count, memory_order_release);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Number of samples in the ring.
+ *
+ * \param  pRing - ring.
+ *
+ * \return Number of samples.
+ *
+ */
+/*********************************************************************/
+size_t sampleRingCount(sampleRing* pRing)
+{
+    unsigned int tail = atomic_load_explicit(&pRing->tail, memory_order_acquire);
+    unsigned int head = atomic_load_explicit(&pRing->head, memory_order_acquire);
+
+    return head - tail;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Number of samples dropped because the ring was full.
+ *
+ * \param  pRing - ring.
+ *
+ * \return Dropped samples since the initialization.
+ *
+ */
+/*********************************************************************/
+unsigned int sampleRingDropped(sampleRing* pRing)
+{
+    return atomic_load_explicit(&pRing->dropped, memory_order_relaxed);
+}
\ No newline at end of file
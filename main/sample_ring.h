@@ -0,0 +1,128 @@
+/*********************************************************************/
+/*!
+*   \file   sample_ring.h
+*
+*   \brief  Lock-free ring buffer of sensor samples waiting for upload.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sensor.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Number of samples in the ring, has to be a power of two. */
+#define SAMPLE_RING_SIZE 64
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Single measurement with its time. */
+typedef struct
+{
+    int64_t timestamp;  //Time of the measurement since the epoch, since boot if not timeValid [ms].
+    sensorData data;    //Measured values.
+    bool timeValid;     //Wall-clock time was set by SNTP.
+} sensorSample;
+
+/* Ring with one producer and one consumer task. */
+typedef struct
+{
+    sensorSample samples[SAMPLE_RING_SIZE];     //Stored samples.
+    atomic_uint head;                           //Next write position, owned by the producer.
+    atomic_uint tail;                           //Next read position, owned by the consumer.
+    atomic_uint dropped;                        //Samples lost because the ring was full.
+} sampleRing;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Ring initialization.
+ *
+ * \param  pRing - ring.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRingInit(sampleRing* pRing);
+
+/*********************************************************************/
+/*!
+ * \brief  Adding a sample, called only by the producer.
+ *
+ * \param  pRing - ring.
+ * \param  pSample - sample to add.
+ *
+ * \return False if the ring is full and the sample was dropped.
+ *
+ */
+/*********************************************************************/
+bool sampleRingPush(sampleRing* pRing, const sensorSample* pSample);
+
+/*********************************************************************/
+/*!
+ * \brief  Copying the oldest samples without removing them,
+ *         called only by the consumer.
+ *
+ * \param  pRing - ring.
+ * \param  pSamples - where the samples are copied.
+ * \param  max - maximum number of samples to copy.
+ *
+ * \return Number of copied samples.
+ *
+ */
+/*********************************************************************/
+size_t sampleRingPeek(sampleRing* pRing, sensorSample* pSamples, size_t max);
+
+/*********************************************************************/
+/*!
+ * \brief  Removing the oldest samples, called only by the consumer.
+ *
+ * \param  pRing - ring.
+ * \param  count - number of samples to remove.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sampleRingDrop(sampleRing* pRing, size_t count);
+
+/*********************************************************************/
+/*!
+ * \brief  Number of samples in the ring.
+ *
+ * \param  pRing - ring.
+ *
+ * \return Number of samples.
+ *
+ */
+/*********************************************************************/
+size_t sampleRingCount(sampleRing* pRing);
+
+/*********************************************************************/
+/*!
+ * \brief  Number of samples dropped because the ring was full.
+ *
+ * \param  pRing - ring.
+ *
+ * \return Dropped samples since the initialization.
+ *
+ */
+/*********************************************************************/
+unsigned int sampleRingDropped(sampleRing* pRing);
+
+#endif /*SAMPLE_RING_H*/
\ No newline at end of file
@@ -0,0 +1,178 @@
+/*********************************************************************/
+/*!
+*   \file   schedule.c
+*
+*   \brief  Watering schedule, cron-like windows starting phase tables.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include "schedule.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Days searched for the next start, a week and one day for DST changes. */
+#define SCHEDULE_SEARCH_DAYS 8
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Start of a window on a day relative to the given time.
+ *
+ * \param  pWindow - window.
+ * \param  pDay - local time on the day.
+ * \param  offset - days added to the day.
+ *
+ * \return Start time, 0 if the window does not run on that day.
+ *
+ */
+/*********************************************************************/
+static time_t scheduleStart(const scheduleWindow* pWindow, const struct tm* pDay, int offset)
+{
+    struct tm start = *pDay;
+    time_t time = 0;
+
+    start.tm_mday += offset;
+    start.tm_hour = pWindow->hour;
+    start.tm_min = pWindow->minute;
+    start.tm_sec = 0;
+    /* The C library decides about the daylight saving time. */
+    start.tm_isdst = -1;
+
+    time = mktime(&start);
+    if (time == (time_t)-1 || !(pWindow->days & (1 << start.tm_wday)))
+    {
+        return 0;
+    }
+    return time;
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Checking a received schedule.
+ *
+ * \param  pTable - schedule.
+ *
+ * \return True if every window starts an existing, non-empty program
+ *         at a valid time and every phase lasts 1 ms to SCHEDULE_MAX_PHASE_MS.
+ *
+ */
+/*********************************************************************/
+bool scheduleValid(const scheduleTable* pTable)
+{
+    uint8_t i = 0;
+    uint8_t phase = 0;
+
+    if (pTable->windowCount > SCHEDULE_MAX_WINDOWS || pTable->programCount > SCHEDULE_MAX_PROGRAMS)
+    {
+        return false;
+    }
+    for (i = 0; i < pTable->programCount; i++)
+    {
+        if (pTable->programs[i].phaseCount == 0 || pTable->programs[i].phaseCount > WATERING_MAX_PHASES)
+        {
+            return false;
+        }
+        for (phase = 0; phase < pTable->programs[i].phaseCount; phase++)
+        {
+            if (pTable->programs[i].phases[phase].durationMs == 0 ||
+                pTable->programs[i].phases[phase].durationMs > SCHEDULE_MAX_PHASE_MS)
+            {
+                return false;
+            }
+        }
+    }
+    for (i = 0; i < pTable->windowCount; i++)
+    {
+        if (pTable->windows[i].days > SCHEDULE_EVERY_DAY || pTable->windows[i].hour > 23 || pTable->windows[i].minute > 59 ||
+            pTable->windows[i].program >= pTable->programCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finding the latest window start in (since, now].
+ *
+ * \param  pTable - schedule.
+ * \param  since - end of the already handled time.
+ * \param  now - current time.
+ * \param  pWindow - where the index of the window is stored.
+ *
+ * \return Start time, 0 if no window starts in the range.
+ *
+ */
+/*********************************************************************/
+time_t scheduleDue(const scheduleTable* pTable, time_t since, time_t now, uint8_t* pWindow)
+{
+    struct tm day;
+    time_t latest = 0;
+    time_t start = 0;
+    uint8_t window = 0;
+    int offset = 0;
+
+    localtime_r(&now, &day);
+    /* Only today and yesterday are searched, ranges are shorter than a day. */
+    for (window = 0; window < pTable->windowCount; window++)
+    {
+        for (offset = -1; offset <= 0; offset++)
+        {
+            start = scheduleStart(&pTable->windows[window], &day, offset);
+            if (start > since && start <= now && start > latest)
+            {
+                latest = start;
+                *pWindow = window;
+            }
+        }
+    }
+    return latest;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Finding the first window start after now.
+ *
+ * \param  pTable - schedule.
+ * \param  now - current time.
+ *
+ * \return Start time, 0 if the schedule has no windows.
+ *
+ */
+/*********************************************************************/
+time_t scheduleNext(const scheduleTable* pTable, time_t now)
+{
+    struct tm day;
+    time_t next = 0;
+    time_t start = 0;
+    uint8_t window = 0;
+    int offset = 0;
+
+    localtime_r(&now, &day);
+    for (window = 0; window < pTable->windowCount; window++)
+    {
+        for (offset = 0; offset < SCHEDULE_SEARCH_DAYS; offset++)
+        {
+            start = scheduleStart(&pTable->windows[window], &day, offset);
+            if (start > now)
+            {
+                if (next == 0 || start < next)
+                {
+                    next = start;
+                }
+                break;
+            }
+        }
+    }
+    return next;
+}
\ No newline at end of file
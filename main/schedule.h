@@ -0,0 +1,114 @@
+/*********************************************************************/
+/*!
+*   \file   schedule.h
+*
+*   \brief  Watering schedule, cron-like windows starting phase tables.
+*
+*           A window starts its program at a local time of the day on the
+*           selected days of the week. The schedule is sent by the website
+*           and kept on the board, so it runs without the server.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "sdkconfig.h"
+
+#include "watering.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Maximum number of windows. */
+#define SCHEDULE_MAX_WINDOWS 8
+/* Maximum number of programs. */
+#define SCHEDULE_MAX_PROGRAMS 4
+
+/* Every day of the week, bit 0 is Sunday like in tm_wday. */
+#define SCHEDULE_EVERY_DAY 0x7F
+
+/* Longest phase of a program. */
+#define SCHEDULE_MAX_PHASE_MS ((uint32_t)CONFIG_SCHEDULE_MAX_PHASE_S * 1000)
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Start of a program. */
+typedef struct
+{
+    uint8_t days;           //Days of the week, bit 0 is Sunday.
+    uint8_t hour;           //Local start hour (0 - 23).
+    uint8_t minute;         //Local start minute (0 - 59).
+    uint8_t program;        //Started program.
+} scheduleWindow;
+
+/* Phases run once by a window. */
+typedef struct
+{
+    wateringPhase phases[WATERING_MAX_PHASES];  //Phases of the program.
+    uint8_t phaseCount;                         //Number of phases.
+} scheduleProgram;
+
+/* Whole schedule, stored in NVS as it is. */
+typedef struct
+{
+    uint32_t version;                               //Version given by the website.
+    scheduleWindow windows[SCHEDULE_MAX_WINDOWS];   //Windows.
+    uint8_t windowCount;                            //Number of windows.
+    scheduleProgram programs[SCHEDULE_MAX_PROGRAMS];//Programs.
+    uint8_t programCount;                           //Number of programs.
+} scheduleTable;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Checking a received schedule.
+ *
+ * \param  pTable - schedule.
+ *
+ * \return True if every window starts an existing, non-empty program
+ *         at a valid time and every phase lasts 1 ms to SCHEDULE_MAX_PHASE_MS.
+ *
+ */
+/*********************************************************************/
+bool scheduleValid(const scheduleTable* pTable);
+
+/*********************************************************************/
+/*!
+ * \brief  Finding the latest window start in (since, now].
+ *
+ * \param  pTable - schedule.
+ * \param  since - end of the already handled time.
+ * \param  now - current time.
+ * \param  pWindow - where the index of the window is stored.
+ *
+ * \return Start time, 0 if no window starts in the range.
+ *
+ */
+/*********************************************************************/
+time_t scheduleDue(const scheduleTable* pTable, time_t since, time_t now, uint8_t* pWindow);
+
+/*********************************************************************/
+/*!
+ * \brief  Finding the first window start after now.
+ *
+ * \param  pTable - schedule.
+ * \param  now - current time.
+ *
+ * \return Start time, 0 if the schedule has no windows.
+ *
+ */
+/*********************************************************************/
+time_t scheduleNext(const scheduleTable* pTable, time_t now);
+
+#endif /*SCHEDULE_H*/
\ No newline at end of file
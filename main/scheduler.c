@@ -0,0 +1,273 @@
+/*********************************************************************/
+/*!
+*   \file   scheduler.c
+*
+*   \brief  Running the watering schedule against the wall clock.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "hal.h"
+#include "schedule.h"
+#include "scheduler.h"
+#include "watering.h"
+#include "wifi_api.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define TAG "scheduler"
+
+#define NVS_NAMESPACE "schedule"
+#define NVS_KEY_TABLE "table"
+#define NVS_KEY_LAST "last"
+/* Longest time between polls, the clock may be set or corrected meanwhile [ms]. */
+#define SCHEDULER_POLL_MAX_MS 60000
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Scheduler context. */
+typedef struct
+{
+    SemaphoreHandle_t lock;     //Access from the parsing and the sprinklers task.
+    scheduleTable table;        //Current schedule.
+    time_t lastRun;             //Start of the last handled window.
+} scheduler;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+static scheduler context;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Storing a value in the scheduler namespace.
+ *
+ * \param  pKey - NVS key.
+ * \param  pData - value.
+ * \param  size - size of the value.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t schedulerStore(const char* pKey, const void* pData, size_t size)
+{
+    esp_err_t err = ESP_OK;
+    nvs_handle_t nvs;
+
+    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    err = nvs_set_blob(nvs, pKey, pData, size);
+    if (err == ESP_OK)
+    {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+
+    return err;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Applying a schedule from the website.
+ *         Called from the parsing task with every complete response.
+ *
+ * \param  pTable - received schedule.
+ *
+ * \return True if a new schedule was applied.
+ *
+ */
+/*********************************************************************/
+static bool schedulerApply(const scheduleTable* pTable)
+{
+    esp_err_t err = ESP_OK;
+
+    if (pTable->version == context.table.version)
+    {
+        return false;
+    }
+    if (!scheduleValid(pTable))
+    {
+        ESP_LOGE(TAG, "Schedule %lu is not valid, ignored", (unsigned long)pTable->version);
+        return false;
+    }
+
+    xSemaphoreTake(context.lock, portMAX_DELAY);
+    context.table = *pTable;
+    xSemaphoreGive(context.lock);
+
+    /* The website sends the schedule again if it is lost, the board goes on anyway. */
+    err = schedulerStore(NVS_KEY_TABLE, pTable, sizeof(*pTable));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to store schedule: %s", esp_err_to_name(err));
+    }
+
+    ESP_LOGI(TAG, "Schedule %lu: %u windows, %u programs", (unsigned long)pTable->version,
+             (unsigned)pTable->windowCount, (unsigned)pTable->programCount);
+    return true;
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Scheduler initialization, restores the schedule from NVS
+ *         and starts a program which is due. NVS, wifiApiInit()
+ *         and wateringInit() have to be initialized first.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void schedulerInit(void)
+{
+    nvs_handle_t nvs;
+    size_t size = sizeof(context.table);
+    int64_t lastRun = 0;
+
+    context.lock = xSemaphoreCreateMutex();
+    if (context.lock == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create scheduler lock");
+    }
+
+    /* Windows are given in the local time of the garden. */
+    setenv("TZ", CONFIG_SCHEDULE_TZ, 1);
+    tzset();
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK)
+    {
+        if (nvs_get_blob(nvs, NVS_KEY_TABLE, &context.table, &size) != ESP_OK ||
+            size != sizeof(context.table) || !scheduleValid(&context.table))
+        {
+            memset(&context.table, 0, sizeof(context.table));
+        }
+        size = sizeof(lastRun);
+        if (nvs_get_blob(nvs, NVS_KEY_LAST, &lastRun, &size) == ESP_OK)
+        {
+            context.lastRun = (time_t)lastRun;
+        }
+        nvs_close(nvs);
+    }
+
+    wifiApiSetScheduleCallback(schedulerApply);
+    ESP_LOGI(TAG, "Schedule %lu restored, %u windows", (unsigned long)context.table.version,
+             (unsigned)context.table.windowCount);
+
+    /* A wake-up for a window starts it before the tasks run. */
+    schedulerPoll();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting a program whose window has begun.
+ *
+ * \param  None
+ *
+ * \return Time to the next call [ms].
+ *
+ */
+/*********************************************************************/
+uint32_t schedulerPoll(void)
+{
+    time_t now = time(NULL);
+    time_t since = now - CONFIG_SCHEDULE_CATCH_UP_MIN * 60;
+    time_t start = 0;
+    int64_t lastRun = 0;
+    uint8_t window = 0;
+    const scheduleProgram* pProgram = NULL;
+    uint32_t wait = 0;
+
+    if (now < HAL_CLOCK_VALID_S)
+    {
+        return SCHEDULER_POLL_MAX_MS;
+    }
+
+    xSemaphoreTake(context.lock, portMAX_DELAY);
+
+    /* Windows missed while the board was off are started late, if not too late. */
+    if (context.lastRun > since)
+    {
+        since = context.lastRun;
+    }
+    start = scheduleDue(&context.table, since, now, &window);
+    if (start != 0)
+    {
+        context.lastRun = start;
+        pProgram = &context.table.programs[context.table.windows[window].program];
+        if (wateringRunProgram(pProgram->phases, pProgram->phaseCount))
+        {
+            ESP_LOGI(TAG, "Window %u started program %u", (unsigned)window,
+                     (unsigned)context.table.windows[window].program);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Window %u skipped, valve controlled by the website", (unsigned)window);
+        }
+    }
+    xSemaphoreGive(context.lock);
+
+    /* A window is not repeated after a reset. */
+    if (start != 0)
+    {
+        lastRun = start;
+        schedulerStore(NVS_KEY_LAST, &lastRun, sizeof(lastRun));
+    }
+
+    wait = schedulerUntilNext();
+    return (wait < SCHEDULER_POLL_MAX_MS) ? wait : SCHEDULER_POLL_MAX_MS;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Time to the next window start, the board has to be
+ *         awake by then.
+ *
+ * \param  None
+ *
+ * \return Time [ms], UINT32_MAX without a known start.
+ *
+ */
+/*********************************************************************/
+uint32_t schedulerUntilNext(void)
+{
+    time_t now = time(NULL);
+    time_t next = 0;
+
+    if (now < HAL_CLOCK_VALID_S)
+    {
+        return UINT32_MAX;
+    }
+    xSemaphoreTake(context.lock, portMAX_DELAY);
+    next = scheduleNext(&context.table, now);
+    xSemaphoreGive(context.lock);
+    if (next == 0 || next - now > UINT32_MAX / 1000)
+    {
+        return UINT32_MAX;
+    }
+    return (uint32_t)(next - now) * 1000;
+}
\ No newline at end of file
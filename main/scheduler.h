@@ -0,0 +1,62 @@
+/*********************************************************************/
+/*!
+*   \file   scheduler.h
+*
+*   \brief  Running the watering schedule against the wall clock.
+*
+*           The schedule received from the website is kept in NVS and
+*           runs on the local time set by SNTP, also while the server
+*           is not reachable.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Scheduler initialization, restores the schedule from NVS
+ *         and starts a program which is due. NVS, wifiApiInit()
+ *         and wateringInit() have to be initialized first.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void schedulerInit(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Starting a program whose window has begun.
+ *
+ * \param  None
+ *
+ * \return Time to the next call [ms].
+ *
+ */
+/*********************************************************************/
+uint32_t schedulerPoll(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Time to the next window start, the board has to be
+ *         awake by then.
+ *
+ * \param  None
+ *
+ * \return Time [ms], UINT32_MAX without a known start.
+ *
+ */
+/*********************************************************************/
+uint32_t schedulerUntilNext(void);
+
+#endif /*SCHEDULER_H*/
\ No newline at end of file
@@ -8,9 +8,10 @@
 *
 */
 /*********************************************************************/
-#include "esp_adc_cal.h"
 #include "esp_log.h"
 
+#include "filter.h"
+#include "hal.h"
 #include "sensor.h"
 
 /**********************************************************************
@@ -19,6 +20,86 @@ Macros
 
 #define TAG "sensor"
 
+/* Resolution of the raw data used by the conversions. */
+#define SENSOR_RAW_BITS HAL_ADC_BITS
+#define SENSOR_LUT_SIZE (1 << SENSOR_RAW_BITS)
+
+/* Filter chain applied to the mean of every measurement. */
+#define SENSOR_FILTER_MAX_DELTA 200     // Largest raw change between measurements.
+#define SENSOR_FILTER_MAX_REJECTS 2     // Measurements after which a larger change is real.
+#define SENSOR_FILTER_MEDIAN 3          // Running median window.
+#define SENSOR_FILTER_ALPHA 128         // EMA weight of a new measurement in 1/256.
+
+/* Percentage of the raw value for the default bounds (a wet sensor gives lower values). */
+#define SENSOR_PERCENT(raw) \
+    ((raw) > SENSOR_RAW_DRY ? 0 : (raw) < SENSOR_RAW_WET ? 100 : ((raw) - SENSOR_RAW_DRY) * 100 / (SENSOR_RAW_WET - SENSOR_RAW_DRY))
+
+/* Compile-time generation of the default percentage table. */
+#define SENSOR_LUT_4(n) SENSOR_PERCENT(n), SENSOR_PERCENT((n) + 1), SENSOR_PERCENT((n) + 2), SENSOR_PERCENT((n) + 3)
+#define SENSOR_LUT_16(n) SENSOR_LUT_4(n), SENSOR_LUT_4((n) + 4), SENSOR_LUT_4((n) + 8), SENSOR_LUT_4((n) + 12)
+#define SENSOR_LUT_64(n) SENSOR_LUT_16(n), SENSOR_LUT_16((n) + 16), SENSOR_LUT_16((n) + 32), SENSOR_LUT_16((n) + 48)
+#define SENSOR_LUT_256(n) SENSOR_LUT_64(n), SENSOR_LUT_64((n) + 64), SENSOR_LUT_64((n) + 128), SENSOR_LUT_64((n) + 192)
+#define SENSOR_LUT_1024(n) SENSOR_LUT_256(n), SENSOR_LUT_256((n) + 256), SENSOR_LUT_256((n) + 512), SENSOR_LUT_256((n) + 768)
+#define SENSOR_LUT_2048(n) SENSOR_LUT_1024(n), SENSOR_LUT_1024((n) + 1024)
+
+#define SENSOR_COUNT (sizeof(sensorConfigs) / sizeof(sensorConfigs[0]))
+
+/* Number of one-shot reads averaged into a single measurement. */
+#define SENSOR_ONESHOT_SAMPLES 20
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Sensor of the registry. */
+typedef struct
+{
+    uint8_t channel;            //ADC1 channel of the probe.
+    uint16_t sensorId;          //Sensor ID on the website.
+} sensorConfig;
+
+/* Measurement being reduced from a continuous frame or a one-shot burst. */
+typedef struct
+{
+    sensorData* pData;          //Results of all sensors.
+    uint8_t mask;               //Sensors to reduce (bit n - sensor n).
+    uint8_t measured;           //Sensors with samples in the frame.
+    uint32_t sums[SENSOR_MAX];  //Sum of the raw samples of every sensor.
+    uint32_t counts[SENSOR_MAX];//Number of the raw samples of every sensor.
+} sensorFrame;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+/* Raw value to voltage [mV], built from the characteristics. */
+static uint16_t voltageLut[SENSOR_LUT_SIZE];
+/* Raw value to percentage, default bounds are built at compile time. */
+static uint8_t percentLut[SENSOR_LUT_SIZE] = { SENSOR_LUT_2048(0) };
+/* Filters removing spikes (e.g. from the valve servo) and noise, one chain per sensor.
+   Kept through deep sleep, so the filters do not start over on every wake. */
+HAL_RETAINED static filterChain sensorFilters[SENSOR_MAX];
+/* Last results, reported again when a pass could not measure a sensor. */
+HAL_RETAINED static sensorData lastResults[SENSOR_MAX];
+
+/* Sensors of the board. */
+static const sensorConfig sensorConfigs[] =
+{
+    { CONFIG_SENSOR_1_CHANNEL, CONFIG_SENSOR_1_ID },
+#if CONFIG_SENSOR_COUNT >= 2
+    { CONFIG_SENSOR_2_CHANNEL, CONFIG_SENSOR_2_ID },
+#endif
+#if CONFIG_SENSOR_COUNT >= 3
+    { CONFIG_SENSOR_3_CHANNEL, CONFIG_SENSOR_3_ID },
+#endif
+#if CONFIG_SENSOR_COUNT >= 4
+    { CONFIG_SENSOR_4_CHANNEL, CONFIG_SENSOR_4_ID },
+#endif
+};
+
+_Static_assert(SENSOR_COUNT <= SENSOR_MAX, "Too many sensors configured");
+
+_Static_assert(SENSOR_LUT_SIZE == 2048, "SENSOR_LUT_2048 has to match SENSOR_RAW_BITS");
+
 /**********************************************************************
 Local Function
 **********************************************************************/
@@ -43,28 +124,208 @@ static int8_t mape(int16_t sample, int16_t inMin, int16_t inMax, uint8_t outMin,
 
 /*********************************************************************/
 /*!
- * \brief  Averaging the received data.
+ * \brief  Index of the raw value in the lookup tables.
  *
- * \param  pData - Pointer where the result is stored.
+ * \param  raw - raw data.
+ *
+ * \return Table index.
+ *
+ */
+/*********************************************************************/
+static uint16_t lutIndex(uint16_t raw)
+{
+    return (raw < SENSOR_LUT_SIZE) ? raw : SENSOR_LUT_SIZE - 1;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Building the voltage table from the ADC characteristics.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void sensorCalibrate(void)
+{
+    uint16_t raw = 0;
+
+    for (raw = 0; raw < SENSOR_LUT_SIZE; raw++)
+    {
+        voltageLut[raw] = halAdcToVoltage(raw);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Configuring the ADC channels and the voltage table.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void sensorAdcInit(void)
+{
+    esp_err_t err = ESP_FAIL;
+    uint8_t channels[SENSOR_MAX];
+    uint8_t sensor = 0;
+
+    for (sensor = 0; sensor < SENSOR_COUNT; sensor++)
+    {
+        channels[sensor] = sensorConfigs[sensor].channel;
+    }
+
+    err = halAdcInit(channels, SENSOR_COUNT);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to configure ADC: %s", esp_err_to_name(err));
+    }
+
+    sensorCalibrate();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Adding one raw sample to the mean of its sensor.
+ *
+ * \param  pFrame - measurement being reduced.
+ * \param  sensor - sensor of the sample.
+ * \param  raw - raw data.
  *
  * \return None
  *
  */
 /*********************************************************************/
-static void averageResult(sensorData* pData)
+static void sensorFrameAdd(sensorFrame* pFrame, uint8_t sensor, uint16_t raw)
 {
-    int32_t tempData = 0;
+    pFrame->pData[sensor].rawData = raw;
+    pFrame->sums[sensor] += raw;
+    pFrame->counts[sensor]++;
+    pFrame->measured |= (1 << sensor);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Filtering the means of the measured sensors, once per
+ *         measurement. The mean removes the fast noise of the burst,
+ *         the chain removes the slow spikes between measurements.
+ *
+ * \param  pFrame - reduced measurement.
+ *
+ * \return Sensors which were measured.
+ *
+ */
+/*********************************************************************/
+static uint8_t sensorFrameFinish(sensorFrame* pFrame)
+{
+    uint8_t sensor = 0;
+
+    for (sensor = 0; sensor < SENSOR_COUNT; sensor++)
+    {
+        if (pFrame->measured & (1 << sensor))
+        {
+            pFrame->pData[sensor].averageData =
+                filterChainApply(&sensorFilters[sensor], pFrame->sums[sensor] / pFrame->counts[sensor]);
+        }
+    }
+    return pFrame->measured;
+}
+
+#if CONFIG_SENSOR_CONTINUOUS
+/*********************************************************************/
+/*!
+ * \brief  Adding one sample of a continuous frame.
+ *
+ * \param  channel - ADC1 channel of the sample.
+ * \param  raw - raw data.
+ * \param  pContext - measurement being reduced.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void sensorFrameSample(uint8_t channel, uint16_t raw, void* pContext)
+{
+    sensorFrame* pFrame = (sensorFrame*)pContext;
+    uint8_t sensor = 0;
+
+    for (sensor = 0; sensor < SENSOR_COUNT; sensor++)
+    {
+        if (channel == sensorConfigs[sensor].channel)
+        {
+            break;
+        }
+    }
+    if (sensor == SENSOR_COUNT || !(pFrame->mask & (1 << sensor)))
+    {
+        return;
+    }
+
+    sensorFrameAdd(pFrame, sensor, raw);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reducing a whole DMA frame with samples of all channels at once.
+ *
+ * \param  pData - Pointer where the results of all sensors are stored.
+ * \param  mask - sensors to reduce (bit n - sensor n).
+ *
+ * \return Sensors with samples in the frame, 0 if it could not be read.
+ *
+ */
+/*********************************************************************/
+static uint8_t sensorReadFrame(sensorData* pData, uint8_t mask)
+{
+    sensorFrame frame = {
+        .pData = pData,
+        .mask = mask,
+    };
+
+    halAdcReadFrame(sensorFrameSample, &frame);
+    return sensorFrameFinish(&frame);
+}
+#endif
+
+/*********************************************************************/
+/*!
+ * \brief  Filtering the received data of the selected sensors
+ *         in one acquisition pass.
+ *
+ * \param  pData - Pointer where the results of all sensors are stored.
+ * \param  mask - sensors to measure (bit n - sensor n).
+ *
+ * \return Sensors which were measured.
+ *
+ */
+/*********************************************************************/
+static uint8_t averageResult(sensorData* pData, uint8_t mask)
+{
+#if CONFIG_SENSOR_CONTINUOUS
+    return sensorReadFrame(pData, mask);
+#else
+    sensorFrame frame = {
+        .pData = pData,
+        .mask = mask,
+    };
     uint8_t sample = 0;
-    uint8_t nrOfAvgValues = 20;
+    uint8_t sensor = 0;
 
-    for(sample = 0; sample < nrOfAvgValues; sample++)
+    for(sample = 0; sample < SENSOR_ONESHOT_SAMPLES; sample++)
     {
-        sensorGetRawData(pData);
-        uint16_t value = pData->rawData;
-        tempData += value;
+        for (sensor = 0; sensor < SENSOR_COUNT; sensor++)
+        {
+            if (mask & (1 << sensor))
+            {
+                sensorFrameAdd(&frame, sensor, halAdcRead(sensorConfigs[sensor].channel));
+            }
+        }
     }
-    tempData = tempData / nrOfAvgValues;
-    pData->averageData = tempData;
+    return sensorFrameFinish(&frame);
+#endif
 }
 
 /**********************************************************************
@@ -82,25 +343,108 @@ static void averageResult(sensorData* pData)
 /*********************************************************************/
 void sensorInit(void)
 {
-    esp_err_t err = ESP_FAIL;
+    uint8_t sensor = 0;
 
-    err = adc1_config_width(ADC_WIDTH_BIT_11);
-    if (err != ESP_OK)
+    sensorAdcInit();
+
+    for (sensor = 0; sensor < SENSOR_COUNT; sensor++)
     {
-        ESP_LOGE(TAG, "Failed to configure ADC width: %s", esp_err_to_name(err));
+        filterChainInit(&sensorFilters[sensor]);
+        filterAddRateLimit(&sensorFilters[sensor], SENSOR_FILTER_MAX_DELTA, SENSOR_FILTER_MAX_REJECTS);
+        filterAddMedian(&sensorFilters[sensor], SENSOR_FILTER_MEDIAN);
+        filterAddEma(&sensorFilters[sensor], SENSOR_FILTER_ALPHA);
     }
 
-    err = adc1_config_channel_atten( ADC1_CHANNEL_0, ADC_ATTEN_DB_11);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure ADC channel attenuation: %s", esp_err_to_name(err));
-    }
+    ESP_LOGI(TAG, "ADC configuration successful, %u sensors", (unsigned)SENSOR_COUNT);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Sensor initialization after a deep sleep,
+ *         the filters continue with their kept state.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sensorResume(void)
+{
+    sensorAdcInit();
+}
 
-    ESP_LOGI(TAG, "ADC configuration successful");
+/*********************************************************************/
+/*!
+ * \brief  Number of sensors of the board.
+ *
+ * \param  None
+ *
+ * \return Number of sensors.
+ *
+ */
+/*********************************************************************/
+uint8_t sensorCount(void)
+{
+    return SENSOR_COUNT;
 }
 
 /*********************************************************************/
 /*!
- * \brief  Reading raw data from the sensor.
+ * \brief  Sensor ID on the website.
+ *
+ * \param  sensor - sensor index.
+ *
+ * \return Sensor ID.
+ *
+ */
+/*********************************************************************/
+uint16_t sensorGetId(uint8_t sensor)
+{
+    return (sensor < SENSOR_COUNT) ? sensorConfigs[sensor].sensorId : 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Measuring the selected sensors in one acquisition pass.
+ *         Sensors which could not be measured get their last result.
+ *
+ * \param  pData - Pointer where the results are stored (SENSOR_MAX entries).
+ * \param  mask - sensors to measure (bit n - sensor n).
+ *
+ * \return Sensors which were measured, the others should be skipped.
+ *
+ */
+/*********************************************************************/
+uint8_t sensorScan(sensorData* pData, uint8_t mask)
+{
+    uint8_t sensor = 0;
+    uint8_t measured = 0;
+    uint16_t index = 0;
+
+    measured = averageResult(pData, mask);
+    for (sensor = 0; sensor < SENSOR_COUNT; sensor++)
+    {
+        if (measured & (1 << sensor))
+        {
+            index = lutIndex(pData[sensor].averageData);
+            pData[sensor].voltage = voltageLut[index];
+            pData[sensor].percentageResult = percentLut[index];
+            pData[sensor].sensorId = sensorConfigs[sensor].sensorId;
+            lastResults[sensor] = pData[sensor];
+        }
+        else if (mask & (1 << sensor))
+        {
+            pData[sensor] = lastResults[sensor];
+            pData[sensor].sensorId = sensorConfigs[sensor].sensorId;
+        }
+    }
+    return measured;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading raw data from the first sensor.
  *
  * \param  pData - Pointer where the result is stored.
  *
@@ -110,12 +454,16 @@ void sensorInit(void)
 /*********************************************************************/
 void sensorGetRawData(sensorData* pData)
 {
-    pData->rawData = adc1_get_raw(ADC1_CHANNEL_0);
+#if CONFIG_SENSOR_CONTINUOUS
+    sensorReadFrame(pData, 1);
+#else
+    pData->rawData = halAdcRead(sensorConfigs[0].channel);
+#endif
 }
 
 /*********************************************************************/
 /*!
- * \brief  Converting of averaged data to a voltage value.
+ * \brief  Converting of averaged data of the first sensor to a voltage value.
  *
  * \param  pData - Pointer where the result is stored.
  *
@@ -125,16 +473,13 @@ void sensorGetRawData(sensorData* pData)
 /*********************************************************************/
 void sensorGetVoltageResult(sensorData* pData)
 {
-    esp_adc_cal_characteristics_t adc_cal;
-
-    esp_adc_cal_characterize( ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_11, 1100, &adc_cal);
-    averageResult(pData);
-    pData->voltage = esp_adc_cal_raw_to_voltage((pData->averageData), &adc_cal);
+    averageResult(pData, 1);
+    pData->voltage = voltageLut[lutIndex(pData->averageData)];
 }
 
 /*********************************************************************/
 /*!
- * \brief  Converting of averaged data to a percentage value.
+ * \brief  Converting of averaged data of the first sensor to a percentage value.
  *
  * \param  pData - Pointer where the result is stored.
  *
@@ -144,22 +489,61 @@ void sensorGetVoltageResult(sensorData* pData)
 /*********************************************************************/
 void sensorGetPercentageResult(sensorData* pData)
 {
-    uint8_t tempData = 0;
+    averageResult(pData, 1);
+    pData->percentageResult = percentLut[lutIndex(pData->averageData)];
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Converting of averaged data of the first sensor to voltage
+ *         and percentage values from the same measurement.
+ *
+ * \param  pData - Pointer where the result is stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sensorGetResult(sensorData* pData)
+{
+    sensorScan(pData, 1);
+}
 
-    averageResult(pData);
+/*********************************************************************/
+/*!
+ * \brief  Changing the raw values of the dry and wet sensor
+ *         and rebuilding the percentage table.
+ *
+ * \param  rawDry - raw value of 0 %.
+ * \param  rawWet - raw value of 100 %.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sensorSetCalibration(uint16_t rawDry, uint16_t rawWet)
+{
+    uint16_t raw = 0;
 
-    if (pData->averageData > 1530)
+    if (rawDry <= rawWet)
     {
-        pData->percentageResult = 0;
+        ESP_LOGE(TAG, "Invalid calibration: dry %u, wet %u", rawDry, rawWet);
         return;
     }
-    if (pData->averageData < 680)
+
+    for (raw = 0; raw < SENSOR_LUT_SIZE; raw++)
     {
-        pData->percentageResult = 100;
-        return;
+        if (raw > rawDry)
+        {
+            percentLut[raw] = 0;
+        }
+        else if (raw < rawWet)
+        {
+            percentLut[raw] = 100;
+        }
+        else
+        {
+            percentLut[raw] = mape(raw, rawDry, rawWet, 0, 100);
+        }
     }
-
-    tempData = mape(pData->averageData, 1530, 680, 0, 100);
-
-    pData->percentageResult = tempData;
 }
\ No newline at end of file
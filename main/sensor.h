@@ -11,7 +11,19 @@
 #ifndef SENSOR_H
 #define SENSOR_H
 
-#include "driver/adc.h"
+#include <stdint.h>
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Default raw value of a dry sensor (0 %). */
+#define SENSOR_RAW_DRY 1530
+/* Default raw value of a wet sensor (100 %). */
+#define SENSOR_RAW_WET 680
+
+/* Maximum number of sensors of one board. */
+#define SENSOR_MAX 4
 
 /**********************************************************************
 Data Types
@@ -23,6 +35,7 @@ typedef struct
     uint16_t averageData;       //Averaged value.
     uint16_t voltage;           //Voltage value.
     uint8_t percentageResult;   //Percentage value.
+    uint16_t sensorId;          //Sensor ID on the website.
 } sensorData;
 
 /**********************************************************************
@@ -42,7 +55,58 @@ void sensorInit(void);
 
 /*********************************************************************/
 /*!
- * \brief  Reading raw data from the sensor.
+ * \brief  Sensor initialization after a deep sleep,
+ *         the filters continue with their kept state.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sensorResume(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Number of sensors of the board.
+ *
+ * \param  None
+ *
+ * \return Number of sensors.
+ *
+ */
+/*********************************************************************/
+uint8_t sensorCount(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Sensor ID on the website.
+ *
+ * \param  sensor - sensor index.
+ *
+ * \return Sensor ID.
+ *
+ */
+/*********************************************************************/
+uint16_t sensorGetId(uint8_t sensor);
+
+/*********************************************************************/
+/*!
+ * \brief  Measuring the selected sensors in one acquisition pass.
+ *         Sensors which could not be measured get their last result.
+ *
+ * \param  pData - Pointer where the results are stored (SENSOR_MAX entries).
+ * \param  mask - sensors to measure (bit n - sensor n).
+ *
+ * \return Sensors which were measured, the others should be skipped.
+ *
+ */
+/*********************************************************************/
+uint8_t sensorScan(sensorData* pData, uint8_t mask);
+
+/*********************************************************************/
+/*!
+ * \brief  Reading raw data from the first sensor.
  *
  * \param  data - Pointer where the result is stored.
  *
@@ -54,7 +118,7 @@ void sensorGetRawData(sensorData* pData);
 
 /*********************************************************************/
 /*!
- * \brief  Converting of averaged data to a voltage value.
+ * \brief  Converting of averaged data of the first sensor to a voltage value.
  *
  * \param  data - Pointer where the result is stored.
  *
@@ -66,7 +130,7 @@ void sensorGetVoltageResult(sensorData* pData);
 
 /*********************************************************************/
 /*!
- * \brief  Converting of averaged data to a percentage value.
+ * \brief  Converting of averaged data of the first sensor to a percentage value.
  *
  * \param  pData - Pointer where the result is stored.
  *
@@ -76,4 +140,31 @@ void sensorGetVoltageResult(sensorData* pData);
 /*********************************************************************/
 void sensorGetPercentageResult(sensorData* pData);
 
+/*********************************************************************/
+/*!
+ * \brief  Converting of averaged data of the first sensor to voltage
+ *         and percentage values from the same measurement.
+ *
+ * \param  pData - Pointer where the result is stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sensorGetResult(sensorData* pData);
+
+/*********************************************************************/
+/*!
+ * \brief  Changing the raw values of the dry and wet sensor
+ *         and rebuilding the percentage table.
+ *
+ * \param  rawDry - raw value of 0 %.
+ * \param  rawWet - raw value of 100 %.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void sensorSetCalibration(uint16_t rawDry, uint16_t rawWet);
+
 #endif /*SENSOR_H*/
\ No newline at end of file
@@ -1,6 +1,6 @@
 /*********************************************************************/
 /*!
-*   \file   sensor.c
+*   \file   servo.c
 *
 *   \brief  Servo support.
 *
@@ -8,11 +8,15 @@
 *
 */
 /*********************************************************************/
-#include <driver/ledc.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 
+#include "hal.h"
+#include "metrics.h"
 #include "servo.h"
 
 /**********************************************************************
@@ -21,6 +25,192 @@ Macros
 
 #define TAG "Servo"
 
+/* PWM frequency of the servo [Hz]. */
+#define SERVO_FREQUENCY 50
+/* Time for the servo to reach the position before the PWM is stopped. */
+#define SERVO_SETTLE_MS 1000
+/* Number of moves waiting for the servo task. */
+#define SERVO_QUEUE_LENGTH 8
+/* Delay of the next settle event when the queue was full. */
+#define SERVO_SETTLE_RETRY_MS 50
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Kind of the servo task event. */
+typedef enum
+{
+  servoEventMove,       // New target position.
+  servoEventSettled,    // Settle timer expired.
+  servoEventWait,       // A task waits for the servo to stop.
+} servoEventType;
+
+/* Event handled by the servo task. */
+typedef struct
+{
+  servoEventType type;      // Kind of the event.
+  float pulse;              // Target pulse time (move).
+  servoCallback callback;   // Completion callback (move).
+  void* pArg;               // Callback argument (move).
+} servoEvent;
+
+/* State of the servo driver, owned by the servo task. */
+typedef struct
+{
+  QueueHandle_t queue;        // Events for the servo task.
+  esp_timer_handle_t timer;   // Settle timer.
+  float position;             // Last requested pulse time, < 0 - unknown.
+  bool moving;                // PWM is running.
+  servoCallback callback;     // Completion callback of the current move.
+  void* pArg;                 // Callback argument of the current move.
+  SemaphoreHandle_t idle;     // Given when the servo stopped for a waiting task.
+  bool waiting;               // A task waits for idle.
+} servoDriver;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+static servoDriver servo = { .position = -1.0 };
+
+/**********************************************************************
+ Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Calling and clearing the completion callback of the current move.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void servoComplete(void)
+{
+  servoCallback callback = servo.callback;
+
+  servo.callback = NULL;
+  if (callback != NULL)
+  {
+    callback(servo.position, servo.pArg);
+  }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Settle timer expired, handled in the servo task.
+ *         The timer is armed again if the queue is full, a lost
+ *         event would leave the PWM running.
+ *
+ * \param  pArg - not used.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void servoSettleTimer(void* pArg)
+{
+  servoEvent event = {
+        .type = servoEventSettled
+  };
+
+  if (xQueueSend(servo.queue, &event, 0) != pdTRUE)
+  {
+    ESP_LOGW(TAG, "Servo queue full, settle delayed.");
+    esp_timer_start_once(servo.timer, SERVO_SETTLE_RETRY_MS * 1000);
+  }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting a move to the new position.
+ *
+ * \param  pEvent - move event.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void servoStartMove(const servoEvent* pEvent)
+{
+  esp_err_t err = ESP_OK;
+
+  /* A move replaced by a newer one is reported as finished. */
+  servoComplete();
+  servo.callback = pEvent->callback;
+  servo.pArg = pEvent->pArg;
+
+  if (pEvent->pulse == servo.position)
+  {
+    /* Already there or on the way. */
+    if (!servo.moving)
+    {
+      servoComplete();
+    }
+    return;
+  }
+
+  int duty = (int)(100.0 * (pEvent->pulse / 20.0) * 81.91);
+
+  ESP_ERROR_CHECK(halPwmSetDuty(duty));
+  servo.position = pEvent->pulse;
+  servo.moving = true;
+
+  /* Restarting the timer gives the new position the full settle time.
+     A settle retry armed in between is stopped again. */
+  do
+  {
+    esp_timer_stop(servo.timer);
+    err = esp_timer_start_once(servo.timer, SERVO_SETTLE_MS * 1000);
+  } while (err == ESP_ERR_INVALID_STATE);
+  ESP_ERROR_CHECK(err);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Servo task, the only owner of the LEDC channel.
+ *
+ * \param  pvParameters - Pointer that will be used as the parameter for the task being created.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void servoTask(void *pvParameters)
+{
+  servoEvent event;
+
+  metricsRegisterTask();
+  while (1)
+  {
+    xQueueReceive(servo.queue, &event, portMAX_DELAY);
+
+    if (event.type == servoEventMove)
+    {
+      servoStartMove(&event);
+    }
+    else if (event.type == servoEventWait)
+    {
+      /* Moves requested before the wait are already started. */
+      servo.waiting = true;
+    }
+    else if (servo.moving && !esp_timer_is_active(servo.timer))
+    {
+      /* Events of a restarted timer are skipped by the activity check. */
+      ESP_ERROR_CHECK(halPwmStop());
+      servo.moving = false;
+      servoComplete();
+    }
+
+    if (servo.waiting && !servo.moving)
+    {
+      servo.waiting = false;
+      xSemaphoreGive(servo.idle);
+    }
+  }
+}
+
 /**********************************************************************
  Global Function
 **********************************************************************/
@@ -36,29 +226,84 @@ Macros
 /*********************************************************************/
 void servoInit(void)
 {
-  ledc_timer_config_t ledc_timer = {
-        .speed_mode       = LEDC_LOW_SPEED_MODE,
-        .timer_num        = LEDC_TIMER_0,
-        .duty_resolution  = LEDC_TIMER_13_BIT,
-        .freq_hz          = 50,
-        .clk_cfg          = LEDC_AUTO_CLK
-  };
-  ESP_ERROR_CHECK(ledc_timer_config(&ledc_timer));
-
-  ledc_channel_config_t ledc_channel = {
-        .speed_mode     = LEDC_LOW_SPEED_MODE,
-        .channel        = LEDC_CHANNEL_0,
-        .timer_sel      = LEDC_TIMER_0,
-        .intr_type      = LEDC_INTR_DISABLE,
-        .gpio_num       = pinServo,
-        .duty           = 0,
-        .hpoint         = 0
+  ESP_ERROR_CHECK(halPwmInit(pinServo, SERVO_FREQUENCY));
+
+  esp_timer_create_args_t timerArgs = {
+        .callback = servoSettleTimer,
+        .name = "servo_settle"
   };
-  ESP_ERROR_CHECK(ledc_channel_config(&ledc_channel));
+  ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &servo.timer));
+
+  servo.idle = xSemaphoreCreateBinary();
+  servo.queue = xQueueCreate(SERVO_QUEUE_LENGTH, sizeof(servoEvent));
+  xTaskCreatePinnedToCore(servoTask, "Task_servo", 2048, NULL, 3, NULL, 1);
 
   ESP_LOGI(TAG, "Init servo finished.");
 }
 
+/*********************************************************************/
+/*!
+ * \brief  Requesting a move without waiting for it.
+ *
+ * \param  customData - pulse time.
+ * \param  callback - called from the servo task when the move is finished
+ *                    or replaced by a newer one (NULL - none).
+ * \param  pArg - callback argument.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t servoMove(float customData, servoCallback callback, void* pArg)
+{
+  servoEvent event = {
+        .type = servoEventMove,
+        .pulse = customData,
+        .callback = callback,
+        .pArg = pArg
+  };
+
+  if (xQueueSend(servo.queue, &event, 0) != pdTRUE)
+  {
+    ESP_LOGE(TAG, "Servo queue full, move dropped.");
+    return ESP_ERR_NO_MEM;
+  }
+
+  return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting until all requested moves are finished and the PWM
+ *         is stopped. Called from one task at a time.
+ *
+ * \param  timeoutMs - maximum wait [ms].
+ *
+ * \return True if the servo stopped, also without servoInit().
+ *
+ */
+/*********************************************************************/
+bool servoWaitIdle(uint32_t timeoutMs)
+{
+  servoEvent event = {
+        .type = servoEventWait
+  };
+
+  if (servo.queue == NULL)
+  {
+    return true;
+  }
+
+  /* A give after an earlier timeout is not this wait's. */
+  xSemaphoreTake(servo.idle, 0);
+  if (xQueueSend(servo.queue, &event, pdMS_TO_TICKS(timeoutMs)) != pdTRUE)
+  {
+    return false;
+  }
+
+  return xSemaphoreTake(servo.idle, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+}
+
 /*********************************************************************/
 /*!
  * \brief  Setting the servo mechanism to custom degrees.
@@ -71,12 +316,7 @@ void servoInit(void)
 /*********************************************************************/
 void servoDegCustom(float customData)
 {
-  int duty = (int)(100.0 * (customData / 20.0) * 81.91);
-
-  ESP_ERROR_CHECK(ledc_set_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, duty));
-  ESP_ERROR_CHECK(ledc_update_duty(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0));
-  vTaskDelay( 1000 / portTICK_PERIOD_MS );
-  ESP_ERROR_CHECK(ledc_stop(LEDC_LOW_SPEED_MODE, LEDC_CHANNEL_0, 0));
+  servoMove(customData, NULL, NULL);
 }
 
 /*********************************************************************/
@@ -11,6 +11,11 @@
 #ifndef SERVO_H
 #define SERVO_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
 /**********************************************************************
 Macros
 **********************************************************************/
@@ -21,6 +26,12 @@ Macros
 #define ServoMsMax 2.1      // 90 degrees.
 #define ServoMsAvg ((ServoMsMax-ServoMsMin)/2.0)
 
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Called when a move is finished, with the reached pulse time. */
+typedef void (*servoCallback)(float pulse, void* pArg);
+
 /**********************************************************************
 Function Declarations
 **********************************************************************/
@@ -36,6 +47,34 @@ Function Declarations
 /*********************************************************************/
 void servoInit(void);
 
+/*********************************************************************/
+/*!
+ * \brief  Requesting a move without waiting for it.
+ *
+ * \param  customData - pulse time.
+ * \param  callback - called from the servo task when the move is finished
+ *                    or replaced by a newer one (NULL - none).
+ * \param  pArg - callback argument.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+esp_err_t servoMove(float customData, servoCallback callback, void* pArg);
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting until all requested moves are finished and the PWM
+ *         is stopped. Called from one task at a time.
+ *
+ * \param  timeoutMs - maximum wait [ms].
+ *
+ * \return True if the servo stopped, also without servoInit().
+ *
+ */
+/*********************************************************************/
+bool servoWaitIdle(uint32_t timeoutMs);
+
 /*********************************************************************/
 /*!
  * \brief  Setting the servo mechanism to custom degrees.
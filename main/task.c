@@ -8,14 +8,25 @@
 *
 */
 /*********************************************************************/
+#include <sys/time.h>
 
 #include "esp_log.h"
+#include "esp_timer.h"
 
+#include "controller.h"
+#include "hal.h"
+#include "metrics.h"
+#include "offline_queue.h"
+#include "power.h"
+#include "sample_rate.h"
+#include "sample_ring.h"
+#include "scheduler.h"
 #include "wifi.h"
 #include "sensor.h"
 #include "leds.h"
 #include "wifi_api.h"
 #include "servo.h"
+#include "watering.h"
 
 #include "task.h"
 
@@ -24,27 +35,316 @@
 Macros
 **********************************************************************/
 
-/* Time when we are not irrigating. */
-#define NORMAL_MEASURMENT_TIME 1000 //* 60 * 60 / 2
-/* Time when we are irrigating. */
-#define WATERING_MEASURMENT_TIME 1000 //TIME_WATERING_1 + TIME_PAUSE_1 + TIME_WATERING_2 + TIME_PAUSE_2
-/* Time when we are irrigating manual. */
-#define MANUAL_WATERING_MEASURMENT_TIME 1000 //* 60 
-/* How often data will be downloaded from the site. */
-#define GET_DELAY 1000
-
-/* Watering sequence times. */
-#define TIME_WATERING_1 1000 //* 60 * 2
-#define TIME_PAUSE_1 1000 //* 60 * 10
-#define TIME_WATERING_2 1000 //* 60 * 1
-#define TIME_PAUSE_2 1000 //* 60 * 5
-
 #define TRUE 1
 #define FALSE 0
 
+#define TAG "task"
+
+/* Longest limit of the moisture controller taken from the website [s]. */
+#define CONTROL_LIMIT_MAX_S 86400
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+/* Samples waiting for upload, kept through deep sleep. */
+HAL_RETAINED static sampleRing samples;
+/* Uploader task, woken up when a full batch is ready. */
+static TaskHandle_t uploaderTask;
+/* Moisture controller, its soak time goes on through deep sleep. */
+HAL_RETAINED static moistureController controller;
+
 /**********************************************************************
 Local Function
 **********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Wall-clock time set by SNTP.
+ *
+ * \param  pMs - where the time since the epoch is stored [ms].
+ *
+ * \return False if the clock was not set yet.
+ *
+ */
+/*********************************************************************/
+static bool taskWallClockMs(int64_t* pMs)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    if (now.tv_sec < HAL_CLOCK_VALID_S)
+    {
+        return false;
+    }
+    *pMs = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Stamping a sample, with the time since boot until the
+ *         wall-clock time is set.
+ *
+ * \param  pSample - sample.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void taskSampleStamp(sensorSample* pSample)
+{
+    pSample->timeValid = taskWallClockMs(&pSample->timestamp);
+    if (!pSample->timeValid)
+    {
+        pSample->timestamp = halClockUs() / 1000;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Moving samples taken before the clock was set to the
+ *         wall-clock time. The boot clock keeps running through deep
+ *         sleep, so the offset holds for every sample still in RAM.
+ *
+ * \param  pSamples - samples.
+ * \param  count - number of samples.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void taskSampleTimeFix(sensorSample* pSamples, size_t count)
+{
+    int64_t nowMs = 0;
+    int64_t offset = 0;
+    size_t i = 0;
+
+    if (!taskWallClockMs(&nowMs))
+    {
+        return;
+    }
+    offset = nowMs - halClockUs() / 1000;
+    for (i = 0; i < count; i++)
+    {
+        if (!pSamples[i].timeValid)
+        {
+            pSamples[i].timestamp += offset;
+            pSamples[i].timeValid = true;
+        }
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Waking up the uploader when the link is back.
+ *
+ * \param  connected - link state.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void taskUploaderLinkChanged(bool connected)
+{
+    if (connected && uploaderTask != NULL)
+    {
+        xTaskNotifyGive(uploaderTask);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Moving samples from RAM to the flash queue.
+ *
+ * \param  pBatch - buffer for CONFIG_UPLOAD_BATCH_SIZE samples.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void taskUploaderStore(sensorSample *pBatch)
+{
+    size_t count = 0;
+    size_t kept = 0;
+    size_t i = 0;
+
+    while ((count = sampleRingPeek(&samples, pBatch, CONFIG_UPLOAD_BATCH_SIZE)) > 0)
+    {
+        /* Stored pages outlive a power cycle, which restarts the boot clock. */
+        taskSampleTimeFix(pBatch, count);
+        for (i = 0, kept = 0; i < count; i++)
+        {
+            if (pBatch[i].timeValid)
+            {
+                pBatch[kept++] = pBatch[i];
+            }
+        }
+        if (kept < count)
+        {
+            ESP_LOGW(TAG, "%u samples without the wall-clock time not stored", (unsigned)(count - kept));
+        }
+        if (kept > 0 && offlineQueuePush(pBatch, kept) != ESP_OK)
+        {
+            break;
+        }
+        sampleRingDrop(&samples, count);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Sending samples stored while the link was down, oldest first.
+ *         At most CONFIG_OFFLINE_REPLAY_PAGES pages are sent per call.
+ *         Pages rejected by the server are dropped, pages which failed
+ *         to reach it are kept.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void taskUploaderReplay(void)
+{
+    static sensorSample page[OFFLINE_PAGE_SAMPLES];
+    esp_err_t err = ESP_OK;
+    size_t count = 0;
+    uint8_t pages = 0;
+
+    for (pages = 0; pages < CONFIG_OFFLINE_REPLAY_PAGES; pages++)
+    {
+        count = offlineQueuePeekPage(page);
+        if (count == 0)
+        {
+            break;
+        }
+        err = restPostBatch(page, count);
+        if (err == ESP_ERR_INVALID_ARG || err == ESP_ERR_NOT_SUPPORTED)
+        {
+            /* The server would reject it forever and block the newer pages. */
+            ESP_LOGE(TAG, "Stored page of %u samples rejected, dropped", (unsigned)count);
+        }
+        else if (err != ESP_OK)
+        {
+            break;
+        }
+        offlineQueueDropPage();
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if a wake without the radio has to start it,
+ *         because a batch is full or the oldest sample waits too long.
+ *
+ * \param  None
+ *
+ * \return True if the samples should be sent.
+ *
+ */
+/*********************************************************************/
+static bool taskUploadDue(void)
+{
+#if CONFIG_POWER_SAVE_DEEP
+    sensorSample oldest;
+    int64_t nowMs = 0;
+
+    /* With the radio on the uploader owns the ring. */
+    if (powerRadioOn())
+    {
+        return false;
+    }
+    if (sampleRingCount(&samples) >= CONFIG_UPLOAD_BATCH_SIZE)
+    {
+        return true;
+    }
+    if (sampleRingPeek(&samples, &oldest, 1) == 0)
+    {
+        return false;
+    }
+    taskSampleTimeFix(&oldest, 1);
+    if (!oldest.timeValid || !taskWallClockMs(&nowMs))
+    {
+        nowMs = halClockUs() / 1000;
+    }
+    return nowMs - oldest.timestamp >= CONFIG_POWER_UPLOAD_MAX_DELAY_S * 1000LL;
+#else
+    return false;
+#endif
+}
+
+#if CONFIG_CONTROL_LOCAL && BOARD == 0
+/*********************************************************************/
+/*!
+ * \brief  Converting a limit of the website to milliseconds.
+ *
+ * \param  seconds - limit from the website, 0 if not given.
+ * \param  fallback - limit used when none is given [s].
+ *
+ * \return Limit [ms], at most CONTROL_LIMIT_MAX_S.
+ *
+ */
+/*********************************************************************/
+static uint32_t taskControlLimitMs(int seconds, int fallback)
+{
+    if (seconds <= 0)
+    {
+        seconds = fallback;
+    }
+    if (seconds > CONTROL_LIMIT_MAX_S)
+    {
+        seconds = CONTROL_LIMIT_MAX_S;
+    }
+    return (uint32_t)seconds * 1000;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Driving the valve from the readings and the targets
+ *         of the website, without waiting for the server.
+ *
+ * \param  pReadings - readings of the sensor pass.
+ * \param  measured - bit per measured sensor.
+ * \param  pCommand - targets and limits from the website.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void taskControl(const sensorData* pReadings, uint8_t measured, const wifiApi* pCommand)
+{
+    controllerLimits limits = {
+        .band = (pCommand->controlBand > 0) ? pCommand->controlBand : CONFIG_CONTROL_BAND,
+        .maxOnMs = taskControlLimitMs(pCommand->controlMaxOnS, CONFIG_CONTROL_MAX_ON_S),
+        .minOffMs = taskControlLimitMs(pCommand->controlMinOffS, CONFIG_CONTROL_MIN_OFF_S),
+    };
+    int64_t now = halClockUs() / 1000;
+    int32_t deficit = CONTROLLER_NO_TARGET;
+    int32_t target = 0;
+    uint8_t sensor = 0;
+    wateringState state = wateringGetState(NULL);
+
+    /* Commands and schedules own the valve, the soak time follows them. */
+    if (state != wateringIdle && state != wateringControlled)
+    {
+        controllerStop(&controller, now);
+        return;
+    }
+
+    /* One valve waters the whole bed, the sensor furthest below its target decides. */
+    for (sensor = 0; sensor < pCommand->sensorCount; sensor++)
+    {
+        target = (int32_t)pCommand->sensors[sensor].humidity;
+        if ((measured & (1 << sensor)) && target > 0 && target - pReadings[sensor].percentageResult > deficit)
+        {
+            deficit = target - pReadings[sensor].percentageResult;
+        }
+    }
+
+    wateringControl(controllerUpdate(&controller, deficit, &limits, now));
+}
+#endif
+
 /*********************************************************************/
 /*!
  * \brief  Lighting up different LEDs depending on hydration status.
@@ -78,6 +378,37 @@ static void taskLedStatus(sensorData *pData)
 /**********************************************************************
 Global Function
 **********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the state shared by the tasks after a cold boot.
+ *         After a deep sleep the kept state goes on.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void taskInit(void)
+{
+    sampleRingInit(&samples);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Number of samples dropped because the sample buffer was full.
+ *
+ * \param  None
+ *
+ * \return Dropped samples since the cold boot.
+ *
+ */
+/*********************************************************************/
+unsigned int taskSamplesDropped(void)
+{
+    return sampleRingDropped(&samples);
+}
+
 /*********************************************************************/
 /*!
  * \brief  Reading/sending data from the sensor to the rest api
@@ -90,32 +421,167 @@ Global Function
  */
 /*********************************************************************/
 void taskSensor(void *pvParameters) {
-    sensorData data;
+    sensorData readings[SENSOR_MAX];
+    sensorSample sample;
+    wifiApi command;
+    sensorData *pDriest = NULL;
+    uint8_t enabled = 0;
+    uint8_t measured = 0;
+    uint8_t sensor = 0;
+    int64_t start = 0;
+    int64_t scanStart = 0;
+    HAL_RETAINED static sampleRate rate;
+    uint32_t interval = 0;
+    bool busy = false;
 
+    metricsRegisterTask();
+    /* After a deep sleep the rate goes on from the kept trend. */
+    if (!powerResumed())
+    {
+        sampleRateInit(&rate, CONFIG_SAMPLE_INTERVAL_MIN_MS, CONFIG_SAMPLE_INTERVAL_MAX_MS, CONFIG_SAMPLE_RATE_THRESHOLD);
+        controllerInit(&controller);
+    }
+    wifiApiRead(&command);
     while (TRUE) {
-        sensorGetPercentageResult(&data);
-        restPost(&data);
-        taskLedStatus(&data);
+        start = metricsStart();
+        /* Sensors turned off on the website are not sampled. */
+        enabled = 0;
+        for (sensor = 0; sensor < command.sensorCount; sensor++)
+        {
+            if (command.sensors[sensor].isSensorOn == TRUE)
+            {
+                enabled |= (1 << sensor);
+            }
+        }
 
-        if ( wifi_api.sprinklerState == TRUE)
+        /* All channels in one pass, each reading goes out in the same batch. */
+        scanStart = metricsStart();
+        measured = sensorScan(readings, enabled);
+        metricsObserve(metricAdc, scanStart);
+        taskSampleStamp(&sample);
+        pDriest = NULL;
+        for (sensor = 0; sensor < command.sensorCount; sensor++)
         {
-            vTaskDelay(MANUAL_WATERING_MEASURMENT_TIME / portTICK_PERIOD_MS);
+            if (!(enabled & (1 << sensor)))
+            {
+                sampleRateForget(&rate, sensor);
+                continue;
+            }
+            /* A failed read keeps the trend, its reading is not sent. */
+            if (!(measured & (1 << sensor)))
+            {
+                continue;
+            }
+            sampleRateAdd(&rate, sensor, readings[sensor].percentageResult);
+            sample.data = readings[sensor];
+            if (!sampleRingPush(&samples, &sample))
+            {
+                ESP_LOGW(TAG, "Sample buffer full, %u samples dropped", sampleRingDropped(&samples));
+            }
+            if (pDriest == NULL || readings[sensor].percentageResult < pDriest->percentageResult)
+            {
+                pDriest = &readings[sensor];
+            }
         }
-        else if (wifi_api.wateringProcess == TRUE)
+#if CONFIG_CONTROL_LOCAL && BOARD == 0
+        taskControl(readings, measured, &command);
+#endif
+        if (uploaderTask != NULL && sampleRingCount(&samples) >= CONFIG_UPLOAD_BATCH_SIZE)
         {
-            vTaskDelay(WATERING_MEASURMENT_TIME / portTICK_PERIOD_MS);
+            xTaskNotifyGive(uploaderTask);
         }
-        else
+        /* The bed is as dry as its driest sensor. */
+        if (pDriest != NULL)
         {
-            vTaskDelay(NORMAL_MEASURMENT_TIME / portTICK_PERIOD_MS);
+            taskLedStatus(pDriest);
         }
+        metricsObserve(metricLoopSensor, start);
+        powerSampled();
 
+        /* Moving readings keep the rate up, flat ones slow it down. */
+        interval = sampleRateNext(&rate);
+        /* A new command ends the delay, so the rate follows it at once. */
+        wifiApiRead(&command);
+        busy = command.sprinklerState == TRUE || command.wateringProcess == TRUE;
+#if BOARD == 0
+        busy |= wateringGetState(NULL) != wateringIdle;
+#endif
+        if (busy)
+        {
+            /* Irrigation is followed at full rate, the trend takes over after it. */
+            sampleRateBoost(&rate);
+            interval = CONFIG_SAMPLE_INTERVAL_MIN_MS;
+        }
+#if BOARD == 0
+        /* A sleeping board has to be awake for the next scheduled window. */
+        if (schedulerUntilNext() < interval)
+        {
+            interval = schedulerUntilNext();
+        }
+#endif
+        /* Watering keeps the board awake, otherwise it may sleep until the next pass. */
+        powerIdle(interval, busy, taskUploadDue());
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Sending collected samples to the rest api in batches.
+ *
+ * \param  pvParameters - Pointer that will be used as the parameter for the task being created.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void taskUploader(void *pvParameters) {
+    static sensorSample batch[CONFIG_UPLOAD_BATCH_SIZE];
+    size_t count = 0;
+    int64_t start = 0;
+
+    metricsRegisterTask();
+    uploaderTask = xTaskGetCurrentTaskHandle();
+    wifiSetLinkCallback(taskUploaderLinkChanged);
+
+    while (TRUE) {
+        /* Wait for a full batch, but not longer than the flush interval. */
+        ulTaskNotifyTake(pdTRUE, CONFIG_UPLOAD_FLUSH_INTERVAL_MS / portTICK_PERIOD_MS);
+        start = metricsStart();
+
+        if (!wifiIsConnected())
+        {
+            taskUploaderStore(batch);
+            metricsObserve(metricLoopUploader, start);
+            continue;
+        }
+
+        while ((count = sampleRingPeek(&samples, batch, CONFIG_UPLOAD_BATCH_SIZE)) > 0)
+        {
+            taskSampleTimeFix(batch, count);
+            /* Samples stay in the ring until the server accepted them. */
+            if (restPostBatch(batch, count) != ESP_OK)
+            {
+                taskUploaderStore(batch);
+                break;
+            }
+            sampleRingDrop(&samples, count);
+        }
+
+        /* Stored samples are sent only when the server is reachable. */
+        if (count == 0)
+        {
+            taskUploaderReplay();
+            powerRadioDone(powerWorkUpload);
+        }
+        metricsObserve(metricLoopUploader, start);
     }
 }
 
 /*********************************************************************/
 /*!
  * \brief  Reading data from the page.
+ *         Commands pushed by the server are preferred, polling is used
+ *         while the stream is down or when the server does not offer it.
  *
  * \param  pvParameters - Pointer that will be used as the parameter for the task being created.
  *
@@ -124,9 +590,29 @@ void taskSensor(void *pvParameters) {
  */
 /*********************************************************************/
 void taskWifi(void *pvParameters) {
+    int64_t start = 0;
+    int64_t pushRetry = 0;
+
+    metricsRegisterTask();
     while (TRUE) {
+        /* Requests without the link would only wait for their timeouts. */
+        wifiWaitConnected(portMAX_DELAY);
+#if CONFIG_COMMAND_PUSH
+        if (esp_timer_get_time() >= pushRetry && restListen() == ESP_ERR_NOT_SUPPORTED)
+        {
+            ESP_LOGW(TAG, "Command stream not offered, polling");
+            pushRetry = esp_timer_get_time() + CONFIG_COMMAND_PUSH_RETRY_S * 1000000LL;
+        }
+#endif
+        /* One GET also covers the commands missed while the stream was down. */
+        start = metricsStart();
         restGet();
-        vTaskDelay(GET_DELAY / portTICK_PERIOD_MS);
+        if (wifiIsConnected())
+        {
+            powerRadioDone(powerWorkCommands);
+        }
+        metricsObserve(metricLoopWifi, start);
+        vTaskDelay(CONFIG_COMMAND_POLL_MS / portTICK_PERIOD_MS);
     }
 }
 
@@ -143,46 +629,21 @@ void taskWifi(void *pvParameters) {
 #if BOARD == 0
 void taskSprinklers(void *pvParameters)
 {
+    wifiApi command;
+    int64_t start = 0;
+    uint32_t wait = 0;
+
+    metricsRegisterTask();
     while (TRUE)
     {
-        /* Automatic watering. */
-        if (wifi_api.wateringProcess == TRUE && wifi_api.sprinklerState == FALSE)
-        {
-            turnOnLed(servoStatus);
-
-            /* Step one: first watering. */
-            servoDeg180();
-            vTaskDelay(TIME_WATERING_1 / portTICK_PERIOD_MS);
-
-            /* Step two: waiting for the water to absorb. */
-            servoDeg0();
-            vTaskDelay(TIME_PAUSE_1 / portTICK_PERIOD_MS);
-
-            /* Step three: second watering. */
-            servoDeg180();
-            vTaskDelay(TIME_WATERING_2 / portTICK_PERIOD_MS);
-
-            /* Step four: waiting for the water to absorb. */
-            servoDeg0();
-            vTaskDelay(TIME_PAUSE_2 / portTICK_PERIOD_MS);
-
-            turnOffLed(servoStatus);
-        }
-
-        /* Manual opening of the valve. */
-        if (wifi_api.sprinklerState == TRUE)
-        {
-            servoDeg180();
-            turnOnLed(servoStatus);
-        }
-        else
-        {
-            servoDeg0();
-            turnOffLed(servoStatus);
-        }
-
-        /* Half-second response time delay. */
-        vTaskDelay(500 / portTICK_PERIOD_MS);
+        /* The watering sequence runs on its own timer, only commands are passed. */
+        start = metricsStart();
+        wifiApiRead(&command);
+        wateringCommand(command.wateringProcess == TRUE, command.sprinklerState == TRUE);
+        /* The schedule runs on its own, the website only changes it. */
+        wait = schedulerPoll();
+        metricsObserve(metricLoopSprinklers, start);
+        wifiApiWaitChange(WIFI_API_SPRINKLERS_BIT, wait / portTICK_PERIOD_MS);
     }
 }
 #endif
\ No newline at end of file
@@ -21,6 +21,31 @@
 /**********************************************************************
 Function Declarations
 **********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Preparing the state shared by the tasks after a cold boot.
+ *         After a deep sleep the kept state goes on.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void taskInit(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Number of samples dropped because the sample buffer was full.
+ *
+ * \param  None
+ *
+ * \return Dropped samples since the cold boot.
+ *
+ */
+/*********************************************************************/
+unsigned int taskSamplesDropped(void);
+
 /*********************************************************************/
 /*!
  * \brief  Reading/sending data from the sensor to the rest api
@@ -34,6 +59,18 @@ Function Declarations
 /*********************************************************************/
 void taskSensor(void *pvParameters);
 
+/*********************************************************************/
+/*!
+ * \brief  Sending collected samples to the rest api in batches.
+ *
+ * \param  pvParameters - Pointer that will be used as the parameter for the task being created.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void taskUploader(void *pvParameters);
+
 /*********************************************************************/
 /*!
  * \brief  Reading data from the page.
@@ -0,0 +1,390 @@
+/*********************************************************************/
+/*!
+*   \file   watering.c
+*
+*   \brief  Watering sequence state machine.
+*
+*           Phases of the automatic watering are run by a one-shot
+*           esp_timer, so a new command is handled as soon as it arrives
+*           instead of after the whole sequence. Scheduled programs use
+*           the same timer and run their phases once.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <stdatomic.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "leds.h"
+#include "servo.h"
+
+#include "watering.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define TAG "watering"
+
+/* Watering sequence times. */
+#define TIME_WATERING_1 1000 //* 60 * 2
+#define TIME_PAUSE_1 1000 //* 60 * 10
+#define TIME_WATERING_2 1000 //* 60 * 1
+#define TIME_PAUSE_2 1000 //* 60 * 5
+
+#define WATERING_PHASES (sizeof(wateringPhases) / sizeof(wateringPhases[0]))
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* State machine context. */
+typedef struct
+{
+    SemaphoreHandle_t lock;     //Access from the command task and the timer.
+    esp_timer_handle_t timer;   //End of the current phase.
+    atomic_uint generation;     //Changed whenever the timer is started or stopped.
+    wateringState state;        //Current state.
+    uint8_t phase;              //Current sequence phase.
+    const wateringPhase* pPhases;               //Phases of the running sequence.
+    uint8_t phaseCount;                         //Number of the phases.
+    wateringPhase program[WATERING_MAX_PHASES]; //Phases of the scheduled program.
+} wateringMachine;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+/* Automatic watering sequence. */
+static const wateringPhase wateringPhases[] =
+{
+    { true, TIME_WATERING_1 },  //Step one: first watering.
+    { false, TIME_PAUSE_1 },    //Step two: waiting for the water to absorb.
+    { true, TIME_WATERING_2 },  //Step three: second watering.
+    { false, TIME_PAUSE_2 },    //Step four: waiting for the water to absorb.
+};
+
+static wateringMachine machine;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Setting the valve.
+ *
+ * \param  open - open or close.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wateringValve(bool open)
+{
+    if (open)
+    {
+        servoDeg180();
+    }
+    else
+    {
+        servoDeg0();
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Stopping the timer of the current phase. A callback already
+ *         waiting for the lock sees the new generation and does nothing.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wateringStopPhase(void)
+{
+    atomic_fetch_add(&machine.generation, 1);
+    esp_timer_stop(machine.timer);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting the given phase of the sequence.
+ *         The valve is closed if the timer cannot be started.
+ *
+ * \param  phase - phase index.
+ *
+ * \return True if the phase started.
+ *
+ */
+/*********************************************************************/
+static bool wateringStartPhase(uint8_t phase)
+{
+    esp_err_t err = ESP_OK;
+
+    atomic_fetch_add(&machine.generation, 1);
+    machine.phase = phase;
+    wateringValve(machine.pPhases[phase].valveOpen);
+    err = esp_timer_start_once(machine.timer, (uint64_t)machine.pPhases[phase].durationMs * 1000);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to start phase timer: %s", esp_err_to_name(err));
+        wateringValve(false);
+        return false;
+    }
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Changing the state and the status LED.
+ *
+ * \param  state - new state.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wateringSetState(wateringState state)
+{
+    machine.state = state;
+    if (state == wateringIdle)
+    {
+        turnOffLed(servoStatus);
+    }
+    else
+    {
+        turnOnLed(servoStatus);
+    }
+    ESP_LOGI(TAG, "Watering state %d", state);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  End of a phase, runs in the esp_timer task.
+ *
+ * \param  pArg - not used.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wateringTimer(void* pArg)
+{
+    unsigned int generation = atomic_load(&machine.generation);
+
+    xSemaphoreTake(machine.lock, portMAX_DELAY);
+
+    /* esp_timer_stop() cannot cancel a running callback. A command which
+       stopped or restarted the phase while this one waited for the lock
+       changed the generation, or armed the timer again before it was read. */
+    if (generation != atomic_load(&machine.generation) || esp_timer_is_active(machine.timer))
+    {
+        xSemaphoreGive(machine.lock);
+        return;
+    }
+
+    /* A command may have ended the sequence while the timer fired. */
+    if (machine.state == wateringSequence)
+    {
+        /* The sequence repeats as long as automatic watering is on. */
+        if (!wateringStartPhase((machine.phase + 1) % machine.phaseCount))
+        {
+            wateringSetState(wateringIdle);
+        }
+    }
+    else if (machine.state == wateringScheduled)
+    {
+        /* A program runs once and closes the valve at its end. */
+        if (machine.phase + 1 >= machine.phaseCount || !wateringStartPhase(machine.phase + 1))
+        {
+            wateringValve(false);
+            wateringSetState(wateringIdle);
+        }
+    }
+
+    xSemaphoreGive(machine.lock);
+}
+
+/**********************************************************************
+Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Watering initialization, the servo has to be initialized first.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wateringInit(void)
+{
+    esp_timer_create_args_t timerArgs = {
+        .callback = wateringTimer,
+        .name = "watering"
+    };
+
+    machine.lock = xSemaphoreCreateMutex();
+    ESP_ERROR_CHECK(esp_timer_create(&timerArgs, &machine.timer));
+    machine.state = wateringIdle;
+
+    ESP_LOGI(TAG, "Watering initialized, %u phases", (unsigned)WATERING_PHASES);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Applying the commands from the website.
+ *         The running sequence is stopped at once by the manual command
+ *         or when the automatic watering is switched off.
+ *
+ * \param  wateringProcess - automatic watering enabled.
+ * \param  sprinklerState - valve opened manually.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wateringCommand(bool wateringProcess, bool sprinklerState)
+{
+    wateringState next = wateringIdle;
+
+    if (sprinklerState)
+    {
+        next = wateringManual;
+    }
+    else if (wateringProcess)
+    {
+        next = wateringSequence;
+    }
+
+    xSemaphoreTake(machine.lock, portMAX_DELAY);
+
+    /* Both commands off leave a scheduled program or the controller running. */
+    if (next != machine.state &&
+        !(next == wateringIdle && (machine.state == wateringScheduled || machine.state == wateringControlled)))
+    {
+        wateringStopPhase();
+
+        switch (next)
+        {
+        case wateringManual:
+            wateringValve(true);
+            break;
+        case wateringSequence:
+            machine.pPhases = wateringPhases;
+            machine.phaseCount = WATERING_PHASES;
+            if (!wateringStartPhase(0))
+            {
+                next = wateringIdle;
+            }
+            break;
+        default:
+            wateringValve(false);
+            break;
+        }
+        wateringSetState(next);
+    }
+
+    xSemaphoreGive(machine.lock);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Running the phases of a scheduled program once.
+ *         Commands from the website take precedence, the program
+ *         does not start while the valve is controlled by them.
+ *
+ * \param  pPhases - phases, copied.
+ * \param  count - number of phases (1 - WATERING_MAX_PHASES).
+ *
+ * \return True if the program started.
+ *
+ */
+/*********************************************************************/
+bool wateringRunProgram(const wateringPhase* pPhases, uint8_t count)
+{
+    bool started = false;
+
+    if (count == 0 || count > WATERING_MAX_PHASES)
+    {
+        return false;
+    }
+
+    xSemaphoreTake(machine.lock, portMAX_DELAY);
+
+    if (machine.state == wateringIdle || machine.state == wateringScheduled || machine.state == wateringControlled)
+    {
+        wateringStopPhase();
+        memcpy(machine.program, pPhases, count * sizeof(wateringPhase));
+        machine.pPhases = machine.program;
+        machine.phaseCount = count;
+        started = wateringStartPhase(0);
+        wateringSetState(started ? wateringScheduled : wateringIdle);
+    }
+
+    xSemaphoreGive(machine.lock);
+
+    return started;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Opening or closing the valve by the moisture controller.
+ *         Commands and scheduled programs take precedence.
+ *
+ * \param  open - valve state wanted by the controller.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wateringControl(bool open)
+{
+    xSemaphoreTake(machine.lock, portMAX_DELAY);
+
+    if (open && machine.state == wateringIdle)
+    {
+        wateringValve(true);
+        wateringSetState(wateringControlled);
+    }
+    else if (!open && machine.state == wateringControlled)
+    {
+        wateringValve(false);
+        wateringSetState(wateringIdle);
+    }
+
+    xSemaphoreGive(machine.lock);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the current state.
+ *
+ * \param  pPhase - where the current sequence phase is stored (may be NULL).
+ *
+ * \return Current state.
+ *
+ */
+/*********************************************************************/
+wateringState wateringGetState(uint8_t* pPhase)
+{
+    wateringState state = wateringIdle;
+
+    xSemaphoreTake(machine.lock, portMAX_DELAY);
+    state = machine.state;
+    if (pPhase != NULL)
+    {
+        *pPhase = machine.phase;
+    }
+    xSemaphoreGive(machine.lock);
+
+    return state;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+/*********************************************************************/
+/*!
+*   \file   watering.h
+*
+*   \brief  Watering sequence state machine.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#ifndef WATERING_H
+#define WATERING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Maximum number of phases of a scheduled program. */
+#define WATERING_MAX_PHASES 8
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* State of the valve control. */
+typedef enum
+{
+    wateringIdle,       //Valve closed.
+    wateringManual,     //Valve opened by the manual command.
+    wateringSequence,   //Automatic watering sequence in progress.
+    wateringScheduled,  //Scheduled program in progress.
+    wateringControlled, //Valve opened by the moisture controller.
+} wateringState;
+
+/* Single step of the automatic watering sequence. */
+typedef struct
+{
+    bool valveOpen;         //Valve state during the phase.
+    uint32_t durationMs;    //Duration of the phase [ms].
+} wateringPhase;
+
+/**********************************************************************
+Function Declarations
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Watering initialization, the servo has to be initialized first.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wateringInit(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Applying the commands from the website.
+ *         The running sequence is stopped at once by the manual command
+ *         or when the automatic watering is switched off.
+ *
+ * \param  wateringProcess - automatic watering enabled.
+ * \param  sprinklerState - valve opened manually.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wateringCommand(bool wateringProcess, bool sprinklerState);
+
+/*********************************************************************/
+/*!
+ * \brief  Running the phases of a scheduled program once.
+ *         Commands from the website take precedence, the program
+ *         does not start while the valve is controlled by them.
+ *
+ * \param  pPhases - phases, copied.
+ * \param  count - number of phases (1 - WATERING_MAX_PHASES).
+ *
+ * \return True if the program started.
+ *
+ */
+/*********************************************************************/
+bool wateringRunProgram(const wateringPhase* pPhases, uint8_t count);
+
+/*********************************************************************/
+/*!
+ * \brief  Opening or closing the valve by the moisture controller.
+ *         Commands and scheduled programs take precedence.
+ *
+ * \param  open - valve state wanted by the controller.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wateringControl(bool open);
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the current state.
+ *
+ * \param  pPhase - where the current sequence phase is stored (may be NULL).
+ *
+ * \return Current state.
+ *
+ */
+/*********************************************************************/
+wateringState wateringGetState(uint8_t* pPhase);
+
+#endif /*WATERING_H*/
\ No newline at end of file
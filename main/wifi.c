@@ -8,16 +8,26 @@
 *
 */
 /*********************************************************************/
+#include <string.h>
+#include <strings.h>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_wifi.h"
-#include "nvs_flash.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "nvs.h"
 #include "esp_netif.h"
+#include "esp_netif_sntp.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
 
+#include "backoff.h"
+#include "event_stream.h"
+#include "metrics.h"
 #include "wifi.h"
 #include "wifi_api.h"
 #include "leds.h"
@@ -26,14 +36,322 @@
 Macros
 **********************************************************************/
 
-#define URL "http://192.168.0.185:5000/mainview"
 #define TAG "wifi"
 #define TAG_POST "post"
 #define TAG_GET "get"
 
+/* Link state bits. */
+#define WIFI_CONNECTED_BIT BIT0
+
+/* Access point of the last connection, kept in NVS. */
+#define NVS_NAMESPACE "wifi"
+#define NVS_KEY_AP "ap"
+
+/* How many times a request is repeated after a stale keep-alive connection. */
+#define SESSION_RETRY 1
+
+/* Content types of the request and response bodies. */
+#define CONTENT_TYPE_JSON "application/json"
+#define CONTENT_TYPE_CBOR "application/cbor"
+
+/* Maximum length of an entity tag, longer ones are not used. */
+#define SESSION_ETAG_SIZE 48
+
+/* Longest silence on the command stream, the server sends comments more often [ms]. */
+#define PUSH_TIMEOUT_MS 60000
+/* Buffer for reading the command stream. */
+#define PUSH_BUFFER_SIZE 256
+
+/* Buffer for the batch of samples. */
+#define POST_BATCH_BUFFER_SIZE (POST_BATCH_MAX * POST_SAMPLE_SIZE + 2)
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Long-lived HTTP session to the rest api. */
+typedef struct
+{
+    esp_http_client_handle_t client;    //Client handle reused between requests.
+    SemaphoreHandle_t lock;             //Access to the session from many tasks.
+    esp_http_client_method_t method;    //Method of the request in progress.
+    int64_t requestStart;               //Start of the request in progress [us].
+    bool newConnection;                 //Request in progress opened a new connection.
+    char etag[SESSION_ETAG_SIZE];       //Entity tag of the last parsed GET response.
+    char newEtag[SESSION_ETAG_SIZE];    //Entity tag of the response in progress.
+    wifiApiFormat responseFormat;       //Encoding of the response in progress.
+    bool parsing;                       //Body of the response in progress is being parsed.
+    bool cborRefused;                   //Server answered 415 to a CBOR body.
+    httpStats stats;                    //Session statistics.
+} httpSession;
+
+/* Command stream pushed by the server. */
+typedef struct
+{
+    eventStream parser;                 //Parser of the stream.
+    bool isEventStream;                 //Response is a text/event-stream.
+} pushStream;
+
+/* Access point and address of the last connection. */
+typedef struct
+{
+    uint8_t bssid[6];                   //BSSID of the access point.
+    uint8_t channel;                    //Primary channel of the access point.
+    esp_netif_ip_info_t ip;             //Last DHCP lease, zero if not kept.
+    esp_ip4_addr_t dns;                 //DNS server of the lease.
+} wifiApCache;
+
+/* State of the WiFi link. */
+typedef struct
+{
+    EventGroupHandle_t events;          //Link state bits.
+    wifiLinkCallback callback;          //Called when the link goes up or down.
+    esp_netif_t* netif;                 //Station interface.
+    wifiApCache cache;                  //Access point of the last connection.
+    bool cacheValid;                    //Cache was read from NVS.
+    bool fastConnect;                   //Connecting with the cache, no scan.
+    bool pinned;                        //Station configuration holds the cached BSSID.
+    uint32_t linkUpUs;                  //Boot to the first IP address [us].
+    TimerHandle_t reconnect;            //Next reconnect attempt.
+    backoff retry;                      //Delay of the reconnect attempts.
+    bool stopped;                       //Radio stopped on purpose, no reconnect.
+    uint32_t linkDowns;                 //Lost links.
+    uint32_t reconnects;                //Reconnect attempts.
+} wifiLink;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+static httpSession session;
+static wifiLink linkState;
+static pushStream push;
+static char batchBuffer[POST_BATCH_BUFFER_SIZE];
+
 /**********************************************************************
 Local Function
 **********************************************************************/
+#if CONFIG_WIFI_FAST_CONNECT
+/*********************************************************************/
+/*!
+ * \brief  Reading the access point of the last connection from NVS.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wifiCacheLoad(void)
+{
+    nvs_handle_t nvs;
+    size_t size = sizeof(linkState.cache);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return;
+    }
+    linkState.cacheValid = nvs_get_blob(nvs, NVS_KEY_AP, &linkState.cache, &size) == ESP_OK &&
+                           size == sizeof(linkState.cache) && linkState.cache.channel != 0;
+    nvs_close(nvs);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Storing the access point of the connection in NVS.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wifiCacheStore(void)
+{
+    esp_err_t err = ESP_OK;
+    nvs_handle_t nvs;
+
+    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK)
+    {
+        err = nvs_set_blob(nvs, NVS_KEY_AP, &linkState.cache, sizeof(linkState.cache));
+        if (err == ESP_OK)
+        {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to store access point: %s", esp_err_to_name(err));
+        return;
+    }
+    linkState.cacheValid = true;
+}
+
+#endif
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the station configuration, with the cached
+ *         access point and address if fast is set.
+ *
+ * \param  fast - connect with the cache, without a scan.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wifiConfigure(bool fast)
+{
+    esp_err_t err = ESP_OK;
+#if CONFIG_WIFI_STATIC_IP
+    esp_netif_dns_info_t dns = { 0 };
+#endif
+    wifi_config_t wifi_configuration = {
+        .sta = {
+            .ssid = CONFIG_ESP_WIFI_SSID,
+            .password = CONFIG_ESP_WIFI_PASSWORD,
+            .failure_retry_cnt = CONFIG_ESP_MAXIMUM_RETRY}};
+
+    linkState.fastConnect = fast;
+    linkState.pinned = fast;
+    if (fast)
+    {
+        /* A known channel and BSSID skip the scan of all channels. */
+        memcpy(wifi_configuration.sta.bssid, linkState.cache.bssid, sizeof(wifi_configuration.sta.bssid));
+        wifi_configuration.sta.bssid_set = true;
+        wifi_configuration.sta.channel = linkState.cache.channel;
+    }
+
+    err = esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_configuration);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed esp wifi set config: %s", esp_err_to_name(err));
+    }
+
+#if CONFIG_WIFI_STATIC_IP
+    /* The last lease saves the DHCP exchange. */
+    if (fast && linkState.cache.ip.ip.addr != 0)
+    {
+        esp_netif_dhcpc_stop(linkState.netif);
+        err = esp_netif_set_ip_info(linkState.netif, &linkState.cache.ip);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to set static ip: %s", esp_err_to_name(err));
+        }
+        dns.ip.type = ESP_IPADDR_TYPE_V4;
+        dns.ip.u_addr.ip4 = linkState.cache.dns;
+        esp_netif_set_dns_info(linkState.netif, ESP_NETIF_DNS_MAIN, &dns);
+    }
+    else
+    {
+        err = esp_netif_dhcpc_start(linkState.netif);
+        if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STARTED)
+        {
+            ESP_LOGE(TAG, "Failed to start dhcp client: %s", esp_err_to_name(err));
+        }
+    }
+#endif
+}
+
+#if CONFIG_WIFI_FAST_CONNECT
+/*********************************************************************/
+/*!
+ * \brief  Keeping the access point and the lease of a new connection.
+ *         NVS is written only when they changed.
+ *
+ * \param  pEvent - got IP event data.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wifiCacheUpdate(const ip_event_got_ip_t* pEvent)
+{
+    wifiApCache cache = { 0 };
+    wifi_ap_record_t ap;
+#if CONFIG_WIFI_STATIC_IP
+    esp_netif_dns_info_t dns;
+#endif
+
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK)
+    {
+        return;
+    }
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    cache.channel = ap.primary;
+#if CONFIG_WIFI_STATIC_IP
+    if (!linkState.fastConnect || linkState.cache.ip.ip.addr == 0)
+    {
+        cache.ip = pEvent->ip_info;
+        if (esp_netif_get_dns_info(linkState.netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK)
+        {
+            cache.dns = dns.ip.u_addr.ip4;
+        }
+    }
+    else
+    {
+        cache.ip = linkState.cache.ip;
+        cache.dns = linkState.cache.dns;
+    }
+#endif
+    (void)pEvent;
+
+    if (linkState.cacheValid && memcmp(&cache, &linkState.cache, sizeof(cache)) == 0)
+    {
+        return;
+    }
+    linkState.cache = cache;
+    wifiCacheStore();
+}
+#endif
+
+/*********************************************************************/
+/*!
+ * \brief  Reconnect attempt, called by the timer.
+ *
+ * \param  timer - reconnect timer.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wifiReconnect(TimerHandle_t timer)
+{
+    esp_err_t err = ESP_OK;
+
+    if (linkState.stopped)
+    {
+        return;
+    }
+    linkState.reconnects++;
+    err = esp_wifi_connect();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed esp wifi connect: %s", esp_err_to_name(err));
+        /* No disconnect event follows, the next attempt is planned here. */
+        xTimerChangePeriod(timer, backoffNext(&linkState.retry, esp_random()) / portTICK_PERIOD_MS + 1, 0);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Planning the next reconnect attempt.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wifiReconnectLater(void)
+{
+    uint32_t delay = backoffNext(&linkState.retry, esp_random());
+
+    ESP_LOGW(TAG, "Reconnect attempt %lu in %lu ms", (unsigned long)linkState.retry.attempts, (unsigned long)delay);
+    xTimerChangePeriod(linkState.reconnect, delay / portTICK_PERIOD_MS + 1, 0);
+}
+
 /*********************************************************************/
 /*!
  * \brief  WiFi event support.
@@ -49,6 +367,29 @@ Local Function
 /*********************************************************************/
 static void wifiEventHandler(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
+    if (event_base == IP_EVENT)
+    {
+        if (event_id == IP_EVENT_STA_GOT_IP)
+        {
+            ESP_LOGI(TAG_GET, "IP_EVENT_STA_GOT_IP");
+            if (linkState.linkUpUs == 0)
+            {
+                linkState.linkUpUs = (uint32_t)esp_timer_get_time();
+            }
+#if CONFIG_WIFI_FAST_CONNECT
+            wifiCacheUpdate((const ip_event_got_ip_t*)event_data);
+            linkState.fastConnect = false;
+#endif
+            backoffReset(&linkState.retry);
+            xEventGroupSetBits(linkState.events, WIFI_CONNECTED_BIT);
+            if (linkState.callback != NULL)
+            {
+                linkState.callback(true);
+            }
+        }
+        return;
+    }
+
     switch (event_id)
     {
     case WIFI_EVENT_STA_START:
@@ -61,9 +402,36 @@ static void wifiEventHandler(void *event_handler_arg, esp_event_base_t event_bas
     case WIFI_EVENT_STA_DISCONNECTED:
         ESP_LOGE(TAG_GET, "WIFI_EVENT_STA_DISCONNECTED");
         turnOffLed(wifiUiStatus);
-        break;
-    case IP_EVENT_STA_GOT_IP:
-        ESP_LOGI(TAG_GET, "IP_EVENT_STA_GOT_IP");
+        if (xEventGroupGetBits(linkState.events) & WIFI_CONNECTED_BIT)
+        {
+            linkState.linkDowns++;
+            xEventGroupClearBits(linkState.events, WIFI_CONNECTED_BIT);
+            if (linkState.callback != NULL)
+            {
+                linkState.callback(false);
+            }
+        }
+        if (linkState.stopped)
+        {
+            break;
+        }
+#if CONFIG_WIFI_FAST_CONNECT
+        /* The access point moved or the lease expired, the next attempt scans. */
+        if (linkState.fastConnect)
+        {
+            ESP_LOGW(TAG, "Fast connect failed, scanning");
+            wifiConfigure(false);
+            esp_wifi_connect();
+            break;
+        }
+        /* A lost link may mean a new access point or channel, reconnects scan. */
+        if (linkState.pinned)
+        {
+            wifiConfigure(false);
+        }
+#endif
+        /* Boards which lost the same access point spread their attempts. */
+        wifiReconnectLater();
         break;
     default:
         break;
@@ -94,16 +462,44 @@ static esp_err_t clientEventGetHandler(esp_http_client_event_handle_t evt)
         break;
     case HTTP_EVENT_HEADERS_SENT:
         ESP_LOGI(TAG_GET, "HTTP_EVENT_HEADERS_SENT");
+        session.responseFormat = wifiApiJson;
+        session.parsing = false;
         break;
     case HTTP_EVENT_ON_HEADER:
         ESP_LOGI(TAG_GET, "HTTP_EVENT_ON_HEADER");
+        if (strcasecmp(evt->header_key, "ETag") == 0 && strlen(evt->header_value) < SESSION_ETAG_SIZE)
+        {
+            strcpy(session.newEtag, evt->header_value);
+        }
+        else if (strcasecmp(evt->header_key, "Content-Type") == 0 &&
+                 strncasecmp(evt->header_value, CONTENT_TYPE_CBOR, strlen(CONTENT_TYPE_CBOR)) == 0)
+        {
+            session.responseFormat = wifiApiCbor;
+        }
         break;
     case HTTP_EVENT_ON_DATA:
         ESP_LOGI(TAG_GET, "HTTP_EVENT_ON_DATA");
-        getData((char *)evt->data);
+        /* Error pages and other non-200 bodies carry no commands. */
+        if (esp_http_client_get_status_code(evt->client) != 200)
+        {
+            break;
+        }
+        /* The decoder is chosen once all headers were read. */
+        if (!session.parsing)
+        {
+            getDataBegin(session.responseFormat);
+            session.parsing = true;
+        }
+        getDataChunk((const char *)evt->data, evt->data_len);
         break;
     case HTTP_EVENT_ON_FINISH:
         ESP_LOGI(TAG_GET, "HTTP_EVENT_ON_FINISH");
+        /* 304 Not Modified has no body, the last commands stay. */
+        if (esp_http_client_get_status_code(evt->client) == 200 && session.parsing)
+        {
+            getDataEnd();
+            strcpy(session.etag, session.newEtag);
+        }
         break;
     case HTTP_EVENT_DISCONNECTED:
         ESP_LOGE(TAG_GET, "HTTP_EVENT_DISCONNECTED");
@@ -165,6 +561,271 @@ static esp_err_t clientEventPostHandler(esp_http_client_event_handle_t evt)
     return err;
 }
 
+/*********************************************************************/
+/*!
+ * \brief  Client event of the session, dispatched by request method.
+ *
+ * \param  evt - HTTP Client events data.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t clientEventSessionHandler(esp_http_client_event_handle_t evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_CONNECTED)
+    {
+        /* Only reported when the connection is really opened. */
+        uint32_t handshake = (uint32_t)(esp_timer_get_time() - session.requestStart);
+
+        session.newConnection = true;
+        session.stats.connections++;
+        session.stats.lastHandshakeUs = handshake;
+        session.stats.totalHandshakeUs += handshake;
+    }
+
+    if (session.method == HTTP_METHOD_POST)
+    {
+        return clientEventPostHandler(evt);
+    }
+    return clientEventGetHandler(evt);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Passing the events of the command stream to the GET parser.
+ *
+ * \param  part - part of the event.
+ * \param  pData - piece of the event data.
+ * \param  len - length of the piece.
+ * \param  pContext - not used.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void pushEvent(eventStreamPart part, const char* pData, size_t len, void* pContext)
+{
+    switch (part)
+    {
+    case eventStreamBegin:
+        getDataBegin(wifiApiJson);
+        break;
+    case eventStreamData:
+        getDataChunk(pData, (int)len);
+        break;
+    case eventStreamEnd:
+        getDataEnd();
+        xSemaphoreTake(session.lock, portMAX_DELAY);
+        session.stats.pushEvents++;
+        xSemaphoreGive(session.lock);
+        break;
+    default:
+        break;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Client event of the command stream.
+ *         Body pieces are parsed as they arrive, the stream never ends
+ *         on its own.
+ *
+ * \param  evt - HTTP Client events data.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t clientEventPushHandler(esp_http_client_event_handle_t evt)
+{
+    switch (evt->event_id)
+    {
+    case HTTP_EVENT_ON_HEADER:
+        if (strcasecmp(evt->header_key, "Content-Type") == 0 &&
+            strncasecmp(evt->header_value, "text/event-stream", 17) == 0)
+        {
+            push.isEventStream = true;
+            xSemaphoreTake(session.lock, portMAX_DELAY);
+            session.stats.pushStreams++;
+            xSemaphoreGive(session.lock);
+        }
+        break;
+    case HTTP_EVENT_ON_DATA:
+        if (push.isEventStream && esp_http_client_get_status_code(evt->client) == 200)
+        {
+            eventStreamFeed(&push.parser, (const char *)evt->data, evt->data_len);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Creating the session client if it does not exist.
+ *
+ * \param  None
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t sessionOpen(void)
+{
+    if (session.client != NULL)
+    {
+        return ESP_OK;
+    }
+
+    esp_http_client_config_t config = {
+        .url = CONFIG_REST_API_URL,
+        .method = HTTP_METHOD_GET,
+        .cert_pem = NULL,
+        .keep_alive_enable = true,
+        .event_handler = clientEventSessionHandler};
+
+    session.client = esp_http_client_init(&config);
+    if (session.client == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        return ESP_FAIL;
+    }
+#if CONFIG_TELEMETRY_CBOR
+    esp_http_client_set_header(session.client, "Accept", CONTENT_TYPE_CBOR ", " CONTENT_TYPE_JSON ";q=0.5");
+#endif
+
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Performing a request on the session connection.
+ *         A request which failed on a reused connection is repeated
+ *         once on a new one, because the server may have closed it.
+ *
+ * \param  method - request method.
+ * \param  pContentType - type of the body.
+ * \param  pBody - request body (NULL if none).
+ * \param  len - length of the body.
+ *
+ * \return Error status, ESP_ERR_NOT_SUPPORTED if the server refused
+ *         the type of the body, ESP_ERR_INVALID_ARG if it rejected
+ *         the request (4xx), ESP_ERR_INVALID_RESPONSE on a server error (5xx).
+ *
+ */
+/*********************************************************************/
+static esp_err_t sessionPerform(esp_http_client_method_t method, const char* pContentType, const char* pBody, int len)
+{
+    esp_err_t err = ESP_FAIL;
+    uint8_t retry = 0;
+    int64_t start = 0;
+    int status = 0;
+    bool conditional = false;
+
+    /* Without the link the request would only wait for its timeout. */
+    if (!wifiIsConnected())
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(session.lock, portMAX_DELAY);
+
+    if (sessionOpen() != ESP_OK)
+    {
+        xSemaphoreGive(session.lock);
+        return ESP_FAIL;
+    }
+
+    session.method = method;
+    esp_http_client_set_method(session.client, method);
+    /* The server answers 304 without a body if the commands did not change. */
+    conditional = (method == HTTP_METHOD_GET && session.etag[0] != '\0');
+    if (conditional)
+    {
+        esp_http_client_set_header(session.client, "If-None-Match", session.etag);
+    }
+    else
+    {
+        esp_http_client_delete_header(session.client, "If-None-Match");
+    }
+    if (pBody != NULL)
+    {
+        esp_http_client_set_header(session.client, "Content-Type", pContentType);
+    }
+    else
+    {
+        esp_http_client_delete_header(session.client, "Content-Type");
+    }
+    esp_http_client_set_post_field(session.client, pBody, len);
+
+    start = metricsStart();
+    for (retry = 0; retry <= SESSION_RETRY; retry++)
+    {
+        session.newConnection = false;
+        session.requestStart = esp_timer_get_time();
+        session.newEtag[0] = '\0';
+
+        err = esp_http_client_perform(session.client);
+        if (err == ESP_OK)
+        {
+            status = esp_http_client_get_status_code(session.client);
+            if (status == 415)
+            {
+                err = ESP_ERR_NOT_SUPPORTED;
+            }
+            else if (status >= 500)
+            {
+                err = ESP_ERR_INVALID_RESPONSE;
+            }
+            else if (status >= 400)
+            {
+                /* Sending the same request again would not help. */
+                err = ESP_ERR_INVALID_ARG;
+            }
+            break;
+        }
+
+        /* Drop the broken connection, the next attempt reconnects. */
+        esp_http_client_close(session.client);
+        if (session.newConnection)
+        {
+            break;
+        }
+        ESP_LOGW(TAG, "Keep-alive connection lost, reconnecting");
+    }
+
+    metricsObserve((method == HTTP_METHOD_GET) ? metricHttpGet : metricHttpPost, start);
+    session.stats.requests++;
+    if (conditional)
+    {
+        session.stats.conditional++;
+        if (err == ESP_OK && status == 304)
+        {
+            session.stats.notModified++;
+        }
+    }
+    if (err != ESP_OK)
+    {
+        session.stats.failures++;
+    }
+    else if (!session.newConnection)
+    {
+        session.stats.reuses++;
+    }
+    if (err == ESP_OK && method == HTTP_METHOD_POST && session.stats.firstPostUs == 0)
+    {
+        session.stats.firstPostUs = (uint32_t)esp_timer_get_time();
+        ESP_LOGI(TAG, "First POST %lu ms after boot", (unsigned long)(session.stats.firstPostUs / 1000));
+    }
+
+    xSemaphoreGive(session.lock);
+    return err;
+}
+
 /**********************************************************************
  Global Function
 **********************************************************************/
@@ -181,11 +842,14 @@ static esp_err_t clientEventPostHandler(esp_http_client_event_handle_t evt)
 void wifiInit(void)
 {
     esp_err_t err = ESP_OK;
+    int64_t start = esp_timer_get_time();
 
-    err = nvs_flash_init();
-    if (err != ESP_OK)
+    linkState.events = xEventGroupCreate();
+    backoffInit(&linkState.retry, CONFIG_WIFI_RECONNECT_MIN_MS, CONFIG_WIFI_RECONNECT_MAX_MS);
+    linkState.reconnect = xTimerCreate("wifi_reconnect", 1, pdFALSE, NULL, wifiReconnect);
+    if (linkState.reconnect == NULL)
     {
-        ESP_LOGE(TAG, "Failed to init nvs flash: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to create reconnect timer");
     }
 
     err = esp_netif_init();
@@ -199,7 +863,15 @@ void wifiInit(void)
     {
         ESP_LOGE(TAG, "Failed esp event loop create: %s", esp_err_to_name(err));
     }
-    esp_netif_create_default_wifi_sta();
+    linkState.netif = esp_netif_create_default_wifi_sta();
+
+    /* The watering schedule runs on the wall clock. */
+    esp_sntp_config_t sntpConfig = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_SNTP_SERVER);
+    err = esp_netif_sntp_init(&sntpConfig);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to init sntp: %s", esp_err_to_name(err));
+    }
 
     wifi_init_config_t wifi_initiation = WIFI_INIT_CONFIG_DEFAULT();
 
@@ -221,17 +893,10 @@ void wifiInit(void)
         ESP_LOGE(TAG, "Failed esp event handler register: %s", esp_err_to_name(err));
     }
 
-    wifi_config_t wifi_configuration = {
-        .sta = {
-            .ssid = CONFIG_ESP_WIFI_SSID,
-            .password = CONFIG_ESP_WIFI_PASSWORD,
-            .failure_retry_cnt = CONFIG_ESP_MAXIMUM_RETRY}};
-
-    err = esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_configuration);
-    if (err != ESP_OK)
-    {
-        ESP_LOGE(TAG, "Failed esp wifi set config: %s", esp_err_to_name(err));
-    }
+#if CONFIG_WIFI_FAST_CONNECT
+    wifiCacheLoad();
+#endif
+    wifiConfigure(linkState.cacheValid);
 
     err = esp_wifi_start();
     if (err != ESP_OK)
@@ -245,10 +910,92 @@ void wifiInit(void)
         ESP_LOGE(TAG, "Failed esp wifi connect: %s", esp_err_to_name(err));
     }
 
-    //delay for proper wifi initialization
-    vTaskDelay(2000 / portTICK_PERIOD_MS);
+    session.lock = xSemaphoreCreateMutex();
+    if (session.lock == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create HTTP session lock");
+    }
 
-    ESP_LOGI(TAG, "WIFI was initiated\n");
+    /* The tasks start without the link after the timeout, they wait for it. */
+    if (wifiWaitConnected(CONFIG_WIFI_CONNECT_TIMEOUT_MS / portTICK_PERIOD_MS))
+    {
+        ESP_LOGI(TAG, "WIFI connected in %lld ms", (long long)((esp_timer_get_time() - start) / 1000));
+    }
+    else
+    {
+        ESP_LOGW(TAG, "WIFI not connected after %d ms", CONFIG_WIFI_CONNECT_TIMEOUT_MS);
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Stopping the radio before deep sleep.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiStop(void)
+{
+    esp_err_t err = ESP_OK;
+
+    linkState.stopped = true;
+    xTimerStop(linkState.reconnect, 0);
+    err = esp_wifi_stop();
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to stop wifi: %s", esp_err_to_name(err));
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the station has an IP address.
+ *
+ * \param  None
+ *
+ * \return True if connected.
+ *
+ */
+/*********************************************************************/
+bool wifiIsConnected(void)
+{
+    return (xEventGroupGetBits(linkState.events) & WIFI_CONNECTED_BIT) != 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting until the station has an IP address.
+ *
+ * \param  timeout - maximum waiting time [ticks].
+ *
+ * \return True if connected.
+ *
+ */
+/*********************************************************************/
+bool wifiWaitConnected(uint32_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(linkState.events, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, timeout);
+
+    return (bits & WIFI_CONNECTED_BIT) != 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the function called when the link goes up or down.
+ *
+ * \param  callback - function called from the event loop task.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiSetLinkCallback(wifiLinkCallback callback)
+{
+    linkState.callback = callback;
 }
 
 /*********************************************************************/
@@ -264,24 +1011,72 @@ void wifiInit(void)
 void restGet(void)
 {
     esp_err_t err = ESP_FAIL;
-    esp_http_client_config_t config_get = {
-        .url = URL,
+
+    err = sessionPerform(HTTP_METHOD_GET, NULL, NULL, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Receiving commands pushed by the server (Server-Sent Events).
+ *         Blocks while the stream is open, every event is parsed
+ *         like a GET response.
+ *
+ * \param  None
+ *
+ * \return ESP_ERR_NOT_SUPPORTED if the server does not offer the stream,
+ *         ESP_OK when an open stream ended, other errors if it could
+ *         not be opened.
+ *
+ */
+/*********************************************************************/
+esp_err_t restListen(void)
+{
+#if CONFIG_COMMAND_PUSH
+    esp_err_t err = ESP_FAIL;
+    esp_http_client_handle_t client = NULL;
+    int status = 0;
+
+    /* The stream has its own connection, requests keep the session one. */
+    esp_http_client_config_t config = {
+        .url = CONFIG_COMMAND_PUSH_URL,
         .method = HTTP_METHOD_GET,
-        .cert_pem = NULL,
-        .event_handler = clientEventGetHandler};
+        .timeout_ms = PUSH_TIMEOUT_MS,
+        .buffer_size = PUSH_BUFFER_SIZE,
+        .event_handler = clientEventPushHandler};
 
-    esp_http_client_handle_t client = esp_http_client_init(&config_get);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return;
+    client = esp_http_client_init(&config);
+    if (client == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to initialize stream client");
+        return ESP_FAIL;
     }
+    esp_http_client_set_header(client, "Accept", "text/event-stream");
+    esp_http_client_set_header(client, "Cache-Control", "no-cache");
+
+    push.isEventStream = false;
+    eventStreamInit(&push.parser, pushEvent, NULL);
 
     err = esp_http_client_perform(client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
+    status = esp_http_client_get_status_code(client);
+    if (status == 200 && push.isEventStream)
+    {
+        ESP_LOGW(TAG, "Command stream closed: %s", esp_err_to_name(err));
+        err = ESP_OK;
+    }
+    else if (err == ESP_OK)
+    {
+        /* A server in trouble is not a server without the stream. */
+        err = (status >= 500) ? ESP_ERR_INVALID_RESPONSE : ESP_ERR_NOT_SUPPORTED;
     }
 
     esp_http_client_cleanup(client);
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 /*********************************************************************/
@@ -296,35 +1091,102 @@ void restGet(void)
 /*********************************************************************/
 void restPost(sensorData* pData)
 {
-    esp_err_t err = ESP_FAIL;
-    esp_http_client_config_t config_post = {
-        .url = URL,
-        .method = HTTP_METHOD_POST,
-        .cert_pem = NULL,
-        .event_handler = clientEventPostHandler};
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+    char json_data[POST_DATA_SIZE];
+    int len = -1;
 
-    esp_http_client_handle_t client = esp_http_client_init(&config_post);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return;
+#if CONFIG_TELEMETRY_CBOR
+    /* CBOR until the server refuses it, JSON from then on. */
+    len = session.cborRefused ? -1 : postDataCbor(pData, (uint8_t*)json_data, sizeof(json_data));
+    if (len >= 0)
+    {
+        err = sessionPerform(HTTP_METHOD_POST, CONTENT_TYPE_CBOR, json_data, len);
+        if (err == ESP_ERR_NOT_SUPPORTED)
+        {
+            ESP_LOGW(TAG, "Server does not accept CBOR, JSON is used");
+            session.cborRefused = true;
+        }
+    }
+#endif
+    if (err == ESP_ERR_NOT_SUPPORTED)
+    {
+        len = postData(pData, json_data, sizeof(json_data));
+        if (len < 0) {
+            ESP_LOGE(TAG, "POST data does not fit into the buffer");
+            return;
+        }
+        err = sessionPerform(HTTP_METHOD_POST, CONTENT_TYPE_JSON, json_data, len);
     }
 
-    char* json_data = postData(pData);
-
-    err = esp_http_client_set_post_field(client, json_data, strlen(json_data));
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP set post failed: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
     }
+}
 
-    err = esp_http_client_set_header(client, "Content-Type", "application/json");
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP set header failed: %s", esp_err_to_name(err));
+/*********************************************************************/
+/*!
+ * \brief  POST support for a batch of samples.
+ *         Only one task may send batches.
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples (at most POST_BATCH_MAX).
+ *
+ * \return Error status, ESP_ERR_INVALID_ARG or ESP_ERR_NOT_SUPPORTED
+ *         if the server rejected the samples for good.
+ *
+ */
+/*********************************************************************/
+esp_err_t restPostBatch(const sensorSample* pSamples, size_t count)
+{
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+    int len = -1;
+
+#if CONFIG_TELEMETRY_CBOR
+    /* CBOR until the server refuses it, JSON from then on. */
+    len = session.cborRefused ? -1 : postDataBatchCbor(pSamples, count, (uint8_t*)batchBuffer, sizeof(batchBuffer));
+    if (len >= 0)
+    {
+        err = sessionPerform(HTTP_METHOD_POST, CONTENT_TYPE_CBOR, batchBuffer, len);
+        if (err == ESP_ERR_NOT_SUPPORTED)
+        {
+            ESP_LOGW(TAG, "Server does not accept CBOR, JSON is used");
+            session.cborRefused = true;
+        }
+    }
+#endif
+    if (err == ESP_ERR_NOT_SUPPORTED)
+    {
+        len = postDataBatch(pSamples, count, batchBuffer, sizeof(batchBuffer));
+        if (len < 0) {
+            ESP_LOGE(TAG, "POST batch does not fit into the buffer");
+            return ESP_ERR_INVALID_SIZE;
+        }
+        err = sessionPerform(HTTP_METHOD_POST, CONTENT_TYPE_JSON, batchBuffer, len);
     }
 
-    err = esp_http_client_perform(client);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "HTTP POST batch request failed: %s", esp_err_to_name(err));
     }
 
-    esp_http_client_cleanup(client);
+    return err;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading statistics of the HTTP session.
+ *
+ * \param  pStats - Pointer where the statistics are stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void restGetStats(httpStats* pStats)
+{
+    xSemaphoreTake(session.lock, portMAX_DELAY);
+    *pStats = session.stats;
+    xSemaphoreGive(session.lock);
+    pStats->linkUpUs = linkState.linkUpUs;
+    pStats->linkDowns = linkState.linkDowns;
+    pStats->reconnects = linkState.reconnects;
 }
\ No newline at end of file
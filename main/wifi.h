@@ -11,8 +11,47 @@
 #ifndef WIFI_H
 #define WIFI_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "sample_ring.h"
 #include "sensor.h"
 
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Maximum number of samples in one POST. */
+#define POST_BATCH_MAX 32
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Statistics of the HTTP session to the rest api. */
+typedef struct
+{
+    uint32_t requests;          //Performed requests.
+    uint32_t failures;          //Failed requests.
+    uint32_t connections;       //Opened connections.
+    uint32_t reuses;            //Requests served on an already open connection.
+    uint32_t lastHandshakeUs;   //Duration of the last connection setup [us].
+    uint64_t totalHandshakeUs;  //Total duration of connection setups [us].
+    uint32_t conditional;       //GET requests with an entity tag.
+    uint32_t notModified;       //GET requests answered with 304 Not Modified.
+    uint32_t pushStreams;       //Opened command streams.
+    uint32_t pushEvents;        //Commands received on the stream.
+    uint32_t linkUpUs;          //Boot to the first IP address, 0 if not yet [us].
+    uint32_t firstPostUs;       //Boot to the first successful POST, 0 if not yet [us].
+    uint32_t linkDowns;         //Lost WiFi links.
+    uint32_t reconnects;        //WiFi reconnect attempts.
+} httpStats;
+
+/* Called when the link goes up (true) or down (false). */
+typedef void (*wifiLinkCallback)(bool connected);
+
 /**********************************************************************
 Function Declarations
 **********************************************************************/
@@ -28,6 +67,54 @@ Function Declarations
 /*********************************************************************/
 void wifiInit(void);
 
+/*********************************************************************/
+/*!
+ * \brief  Stopping the radio before deep sleep.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiStop(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the station has an IP address.
+ *
+ * \param  None
+ *
+ * \return True if connected.
+ *
+ */
+/*********************************************************************/
+bool wifiIsConnected(void);
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting until the station has an IP address.
+ *
+ * \param  timeout - maximum waiting time [ticks].
+ *
+ * \return True if connected.
+ *
+ */
+/*********************************************************************/
+bool wifiWaitConnected(uint32_t timeout);
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the function called when the link goes up or down.
+ *
+ * \param  callback - function called from the event loop task.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiSetLinkCallback(wifiLinkCallback callback);
+
 /*********************************************************************/
 /*!
  * \brief  GET support.
@@ -40,6 +127,22 @@ void wifiInit(void);
 /*********************************************************************/
 void restGet(void);
 
+/*********************************************************************/
+/*!
+ * \brief  Receiving commands pushed by the server (Server-Sent Events).
+ *         Blocks while the stream is open, every event is parsed
+ *         like a GET response.
+ *
+ * \param  None
+ *
+ * \return ESP_ERR_NOT_SUPPORTED if the server does not offer the stream,
+ *         ESP_OK when an open stream ended, other errors if it could
+ *         not be opened.
+ *
+ */
+/*********************************************************************/
+esp_err_t restListen(void);
+
 /*********************************************************************/
 /*!
  * \brief  POST support.
@@ -52,4 +155,31 @@ void restGet(void);
 /*********************************************************************/
 void restPost(sensorData* pData);
 
+/*********************************************************************/
+/*!
+ * \brief  POST support for a batch of samples.
+ *         Only one task may send batches.
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples (at most POST_BATCH_MAX).
+ *
+ * \return Error status, ESP_ERR_INVALID_ARG or ESP_ERR_NOT_SUPPORTED
+ *         if the server rejected the samples for good.
+ *
+ */
+/*********************************************************************/
+esp_err_t restPostBatch(const sensorSample* pSamples, size_t count);
+
+/*********************************************************************/
+/*!
+ * \brief  Reading statistics of the HTTP session.
+ *
+ * \param  pStats - Pointer where the statistics are stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void restGetStats(httpStats* pStats);
+
 #endif /*WIFI_H*/
\ No newline at end of file
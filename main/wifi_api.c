@@ -8,82 +8,808 @@
 *
 */
 /*********************************************************************/
-#include "cJSON.h"
+#include <stdatomic.h>
+#include <string.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+
+#include "cbor_stream.h"
+#include "cbor_writer.h"
+#include "json_stream.h"
+#include "json_writer.h"
 #include "wifi_api.h"
 
 /**********************************************************************
 Macros
 **********************************************************************/
 
-#define BOARD 0
+#define TAG "wifi_api"
+
+/* Fields of wifiApi found in the document. */
+#define FIELD_HUMIDITY          (1 << 0)
+#define FIELD_IS_SENSOR_ON      (1 << 1)
+#define FIELD_SENSOR_ID         (1 << 2)
+#define FIELD_WATERING_PROCESS  (1 << 3)
+#define FIELD_SPRINKLER_STATE   (1 << 4)
+#define FIELD_SCHEDULE          (1 << 5)
+#define FIELD_CONTROL           (1 << 6)
+
+/* Sensor not found in the registry. */
+#define SENSOR_NONE 0xFF
+
+/* Members written by writeSensorMembersCbor(). */
+#define SENSOR_MEMBERS 3
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Response being parsed, applied to the snapshot once it is complete. */
+typedef struct
+{
+    wifiApiFormat format;   //Encoding of the response.
+    union
+    {
+        jsonStream json;    //JSON parser context.
+        cborStream cbor;    //CBOR parser context.
+    } stream;
+    wifiApi update;         //Values read so far.
+    uint8_t fields;         //Fields read so far.
+    bool sensorData;        //The sensor_data array has entries.
+
+    wifiApiSensor entry;    //Current sensor_data entry, matched once it is complete.
+    uint8_t entryFields;    //Fields of the current entry read so far.
+    uint16_t entryIndex;    //Index of the current entry.
 
-#if BOARD == 0
-    #define SENSOR_NUMBER 0
-    #define TEMP_JSON "{ \"sensor_id\": 1, \"humidity\": 28, \"is_sensor_on\": 1}"
-#else
-    #define SENSOR_NUMBER 1
-    #define TEMP_JSON "{ \"sensor_id\": 2, \"humidity\": 28, \"is_sensor_on\": 1}"
-#endif
+    scheduleTable schedule; //Schedule read so far.
+    bool scheduleTruncated; //Schedule does not fit into scheduleTable.
+    bool scheduleInvalid;   //Schedule has a value out of range.
+} getDataParser;
+
+/* Data read from JSON shared between tasks, guarded by a sequence lock. */
+typedef struct
+{
+    atomic_uint sequence;   //Odd while the writer updates the data.
+    wifiApi data;           //Latest complete data.
+} wifiApiSnapshot;
 
 /**********************************************************************
-Global variables
+Local variables
 **********************************************************************/
 
-wifiApi wifi_api;
+static wifiApiSnapshot snapshot;
+
+static getDataParser parser;
+/* Signals changes of the commands to the tasks. */
+static EventGroupHandle_t commandEvents;
+/* Receives the schedules. */
+static wifiApiScheduleCallback scheduleCallback;
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Publishing new data, readers never block the writer.
+ *         Only one task may write.
+ *
+ * \param  pData - new data.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void wifiApiWrite(const wifiApi* pData)
+{
+    unsigned int sequence = atomic_load_explicit(&snapshot.sequence, memory_order_relaxed);
+
+    /* Odd sequence tells the readers that the data is being changed. */
+    atomic_store_explicit(&snapshot.sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    *(volatile wifiApi*)&snapshot.data = *pData;
+
+    atomic_store_explicit(&snapshot.sequence, sequence + 2, memory_order_release);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Applying the finished sensor_data entry to the sensor
+ *         of the board with the same ID. Entries without an ID
+ *         are matched by their position.
+ *
+ * \param  pParser - response being parsed.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void getDataEntryEnd(getDataParser* pParser)
+{
+    uint8_t sensor = SENSOR_NONE;
+    uint8_t i = 0;
+
+    if (pParser->entryFields == 0)
+    {
+        return;
+    }
+
+    if (pParser->entryFields & FIELD_SENSOR_ID)
+    {
+        for (i = 0; i < pParser->update.sensorCount; i++)
+        {
+            if (pParser->update.sensors[i].sensorId == pParser->entry.sensorId)
+            {
+                sensor = i;
+                break;
+            }
+        }
+    }
+    else if (pParser->entryIndex < pParser->update.sensorCount)
+    {
+        sensor = pParser->entryIndex;
+    }
+
+    if (sensor != SENSOR_NONE)
+    {
+        if (pParser->entryFields & FIELD_HUMIDITY)
+        {
+            pParser->update.sensors[sensor].humidity = pParser->entry.humidity;
+        }
+        if (pParser->entryFields & FIELD_IS_SENSOR_ON)
+        {
+            pParser->update.sensors[sensor].isSensorOn = pParser->entry.isSensorOn;
+        }
+    }
+    pParser->entryFields = 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking a value of the schedule before it is narrowed.
+ *
+ * \param  value - numeric value.
+ * \param  min - smallest valid value.
+ * \param  max - largest valid value.
+ * \param  pParser - response being parsed, marked if the value is out of range.
+ *
+ * \return True if the value is in range.
+ *
+ */
+/*********************************************************************/
+static bool getDataScheduleRange(int32_t value, int32_t min, int32_t max, getDataParser* pParser)
+{
+    if (value < min || value > max)
+    {
+        pParser->scheduleInvalid = true;
+        return false;
+    }
+    return true;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Storing a value of the "schedule" object.
+ *
+ * \param  pStream - parser context.
+ * \param  value - numeric value.
+ * \param  pParser - response being parsed.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void getDataSchedule(const jsonStream* pStream, int32_t value, getDataParser* pParser)
+{
+    scheduleTable* pTable = &pParser->schedule;
+    scheduleWindow* pWindow = NULL;
+    wateringPhase* pPhase = NULL;
+    uint16_t index = 0;
+    uint16_t phase = 0;
+
+    /* "version" tells the board if the schedule is new. */
+    if (pStream->depth == 2 && jsonStreamKeyIs(pStream, 1, "version"))
+    {
+        pTable->version = value;
+        pParser->fields |= FIELD_SCHEDULE;
+        return;
+    }
+
+    /* Members of "windows"[n] objects. */
+    if (pStream->depth == 4 && jsonStreamKeyIs(pStream, 1, "windows") && pStream->levels[2].isArray)
+    {
+        index = pStream->levels[2].index;
+        if (index >= SCHEDULE_MAX_WINDOWS)
+        {
+            pParser->scheduleTruncated = true;
+            return;
+        }
+        pWindow = &pTable->windows[index];
+        if (jsonStreamKeyIs(pStream, 3, "days"))
+        {
+            if (getDataScheduleRange(value, 0, SCHEDULE_EVERY_DAY, pParser))
+            {
+                pWindow->days = value;
+            }
+        }
+        else if (jsonStreamKeyIs(pStream, 3, "hour"))
+        {
+            if (getDataScheduleRange(value, 0, 23, pParser))
+            {
+                pWindow->hour = value;
+            }
+        }
+        else if (jsonStreamKeyIs(pStream, 3, "minute"))
+        {
+            if (getDataScheduleRange(value, 0, 59, pParser))
+            {
+                pWindow->minute = value;
+            }
+        }
+        else if (jsonStreamKeyIs(pStream, 3, "program"))
+        {
+            if (getDataScheduleRange(value, 0, SCHEDULE_MAX_PROGRAMS - 1, pParser))
+            {
+                pWindow->program = value;
+            }
+        }
+        if (index >= pTable->windowCount)
+        {
+            pTable->windowCount = index + 1;
+        }
+        return;
+    }
+
+    /* Members of "programs"[n][m] phase objects. */
+    if (pStream->depth == 5 && jsonStreamKeyIs(pStream, 1, "programs") &&
+        pStream->levels[2].isArray && pStream->levels[3].isArray)
+    {
+        index = pStream->levels[2].index;
+        phase = pStream->levels[3].index;
+        if (index >= SCHEDULE_MAX_PROGRAMS || phase >= WATERING_MAX_PHASES)
+        {
+            pParser->scheduleTruncated = true;
+            return;
+        }
+        pPhase = &pTable->programs[index].phases[phase];
+        if (jsonStreamKeyIs(pStream, 4, "valve"))
+        {
+            pPhase->valveOpen = (value != 0);
+        }
+        else if (jsonStreamKeyIs(pStream, 4, "seconds"))
+        {
+            if (getDataScheduleRange(value, 1, CONFIG_SCHEDULE_MAX_PHASE_S, pParser))
+            {
+                pPhase->durationMs = (uint32_t)value * 1000;
+            }
+        }
+        if (phase >= pTable->programs[index].phaseCount)
+        {
+            pTable->programs[index].phaseCount = phase + 1;
+        }
+        if (index >= pTable->programCount)
+        {
+            pTable->programCount = index + 1;
+        }
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Storing values of the response as they are parsed.
+ *
+ * \param  pStream - parser context.
+ * \param  type - type of the value.
+ * \param  pValue - value token.
+ * \param  pContext - response being parsed.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void getDataValue(const jsonStream* pStream, jsonValueType type, const char* pValue, void* pContext)
+{
+    getDataParser* pParser = (getDataParser*)pContext;
+    int32_t value = (type == jsonTrue) ? 1 : jsonStreamToInt(pValue);
+
+    if (type != jsonNumber && type != jsonTrue && type != jsonFalse)
+    {
+        return;
+    }
+
+    if (pStream->depth >= 2 && jsonStreamKeyIs(pStream, 0, "schedule"))
+    {
+        getDataSchedule(pStream, value, pParser);
+        return;
+    }
+
+    /* Limits of the moisture controller in the "control" object. */
+    if (pStream->depth == 2 && jsonStreamKeyIs(pStream, 0, "control"))
+    {
+        if (jsonStreamKeyIs(pStream, 1, "band"))
+        {
+            pParser->update.controlBand = value;
+        }
+        else if (jsonStreamKeyIs(pStream, 1, "max_on_s"))
+        {
+            pParser->update.controlMaxOnS = value;
+        }
+        else if (jsonStreamKeyIs(pStream, 1, "min_off_s"))
+        {
+            pParser->update.controlMinOffS = value;
+        }
+        pParser->fields |= FIELD_CONTROL;
+        return;
+    }
+
+    /* "watering_process" and "sprinkler_state" in the root object. */
+    if (pStream->depth == 1)
+    {
+        if (jsonStreamKeyIs(pStream, 0, "watering_process"))
+        {
+            pParser->update.wateringProcess = value;
+            pParser->fields |= FIELD_WATERING_PROCESS;
+        }
+        else if (jsonStreamKeyIs(pStream, 0, "sprinkler_state"))
+        {
+            pParser->update.sprinklerState = value;
+            pParser->fields |= FIELD_SPRINKLER_STATE;
+        }
+        return;
+    }
+
+    /* Members of "sensor_data"[n] objects. */
+    if (pStream->depth != 3 || !jsonStreamKeyIs(pStream, 0, "sensor_data") || !pStream->levels[1].isArray)
+    {
+        return;
+    }
+
+    pParser->sensorData = true;
+    if (pStream->levels[1].index != pParser->entryIndex)
+    {
+        getDataEntryEnd(pParser);
+        pParser->entryIndex = pStream->levels[1].index;
+    }
+
+    if (jsonStreamKeyIs(pStream, 2, "humidity"))
+    {
+        pParser->entry.humidity = jsonStreamToFloat(pValue);
+        pParser->entryFields |= FIELD_HUMIDITY;
+    }
+    else if (jsonStreamKeyIs(pStream, 2, "is_sensor_on"))
+    {
+        pParser->entry.isSensorOn = value;
+        pParser->entryFields |= FIELD_IS_SENSOR_ON;
+    }
+    else if (jsonStreamKeyIs(pStream, 2, "sensor_id"))
+    {
+        pParser->entry.sensorId = value;
+        pParser->entryFields |= FIELD_SENSOR_ID;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing members describing the sensor reading.
+ *
+ * \param  pWriter - writer context.
+ * \param  pData - sensor data.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void writeSensorMembers(jsonWriter* pWriter, const sensorData* pData)
+{
+    jsonWriteMemberInt(pWriter, "sensor_id", pData->sensorId);
+    jsonWriteMemberInt(pWriter, "humidity", pData->percentageResult);
+    jsonWriteMemberInt(pWriter, "is_sensor_on", 1);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Writing CBOR members describing the sensor reading.
+ *
+ * \param  pWriter - writer context.
+ * \param  pData - sensor data.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void writeSensorMembersCbor(cborWriter* pWriter, const sensorData* pData)
+{
+    cborWriteMemberInt(pWriter, "sensor_id", pData->sensorId);
+    cborWriteMemberInt(pWriter, "humidity", pData->percentageResult);
+    cborWriteMemberInt(pWriter, "is_sensor_on", 1);
+}
 
 /**********************************************************************
 Global Function
 **********************************************************************/
 /*********************************************************************/
 /*!
- * \brief  Updating data downloaded from the website.
+ * \brief  Reading a consistent copy of the data from the website.
+ *         Readers retry instead of blocking the writer.
  *
- * \param  pData - Pointer where the result is stored.
+ * \param  pData - Pointer where the copy is stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiApiRead(wifiApi* pData)
+{
+    unsigned int before = 0;
+    unsigned int after = 0;
+
+    do
+    {
+        before = atomic_load_explicit(&snapshot.sequence, memory_order_acquire);
+        *pData = *(volatile wifiApi*)&snapshot.data;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&snapshot.sequence, memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Initialization of the command change notifications
+ *         and of the sensors reported by the board.
+ *
+ * \param  pSensorIds - website IDs of the sensors, in registry order.
+ * \param  count - number of sensors.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiApiInit(const uint16_t* pSensorIds, uint8_t count)
+{
+    wifiApi data = {0};
+    uint8_t i = 0;
+
+    data.sensorCount = (count < SENSOR_MAX) ? count : SENSOR_MAX;
+    for (i = 0; i < data.sensorCount; i++)
+    {
+        /* Sensors are sampled until the website turns them off. */
+        data.sensors[i].sensorId = pSensorIds[i];
+        data.sensors[i].isSensorOn = 1;
+    }
+    wifiApiWrite(&data);
+
+    commandEvents = xEventGroupCreate();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting until the commands from the website change.
+ *
+ * \param  bit - bit of the waiting task (WIFI_API_*_BIT).
+ * \param  timeout - maximum waiting time in ticks.
+ *
+ * \return True if the commands changed, false on timeout.
+ *
+ */
+/*********************************************************************/
+bool wifiApiWaitChange(uint32_t bit, uint32_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(commandEvents, bit, pdTRUE, pdFALSE, timeout);
+
+    return (bits & bit) != 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the function called with every complete schedule
+ *         in the data from the website.
+ *
+ * \param  callback - function called from the parsing task.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiApiSetScheduleCallback(wifiApiScheduleCallback callback)
+{
+    scheduleCallback = callback;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Restoring the data kept through deep sleep.
+ *         Has to be called before the tasks start.
+ *
+ * \param  pData - data.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiApiRestore(const wifiApi* pData)
+{
+    wifiApiWrite(pData);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Starting to read a new response from the website.
+ *
+ * \param  format - encoding of the response.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void getDataBegin(wifiApiFormat format)
+{
+    parser.format = format;
+    if (format == wifiApiCbor)
+    {
+        cborStreamInit(&parser.stream.cbor, getDataValue, &parser);
+    }
+    else
+    {
+        jsonStreamInit(&parser.stream.json, getDataValue, &parser);
+    }
+    /* Only the parsing task writes, so it can read the data directly. */
+    parser.update = snapshot.data;
+    parser.fields = 0;
+    parser.sensorData = false;
+    parser.entryFields = 0;
+    parser.entryIndex = 0;
+    memset(&parser.schedule, 0, sizeof(parser.schedule));
+    parser.scheduleTruncated = false;
+    parser.scheduleInvalid = false;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the next chunk of the response.
+ *
+ * \param  pData - chunk of the response (not NUL-terminated).
+ * \param  len - length of the chunk.
  *
  * \return None
  *
  */
 /*********************************************************************/
-void getData(char* pData)
+void getDataChunk(const char* pData, int len)
 {
-    cJSON* pRoot = cJSON_Parse(pData);
-    if (pRoot == NULL)
+    if (len <= 0)
     {
         return;
     }
-    cJSON* pSensorData = cJSON_GetObjectItem(pRoot, "sensor_data");
-    int num_sensors = cJSON_GetArraySize(pSensorData);
+    if (parser.format == wifiApiCbor)
+    {
+        cborStreamFeed(&parser.stream.cbor, (const uint8_t*)pData, len);
+    }
+    else
+    {
+        jsonStreamFeed(&parser.stream.json, pData, len);
+    }
+}
 
-    if (num_sensors > 0)
+/*********************************************************************/
+/*!
+ * \brief  Updating data downloaded from the website
+ *         once the whole response was read.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void getDataEnd(void)
+{
+    bool changed = false;
+    bool complete = false;
+    uint8_t i = 0;
+
+    if (parser.format == wifiApiCbor)
+    {
+        complete = cborStreamFinish(&parser.stream.cbor);
+    }
+    else
+    {
+        complete = jsonStreamFinish(&parser.stream.json);
+    }
+    if (!complete)
+    {
+        return;
+    }
+
+    wifiApi next = snapshot.data;
+
+    /* Every section is applied on its own, a response may carry only some of them. */
+    if (parser.sensorData)
+    {
+        getDataEntryEnd(&parser);
+        for (i = 0; i < next.sensorCount; i++)
+        {
+            changed |= (next.sensors[i].isSensorOn != parser.update.sensors[i].isSensorOn);
+            next.sensors[i] = parser.update.sensors[i];
+        }
+    }
+    if (parser.fields & FIELD_WATERING_PROCESS)
+    {
+        changed |= (next.wateringProcess != parser.update.wateringProcess);
+        next.wateringProcess = parser.update.wateringProcess;
+    }
+    if (parser.fields & FIELD_SPRINKLER_STATE)
+    {
+        changed |= (next.sprinklerState != parser.update.sprinklerState);
+        next.sprinklerState = parser.update.sprinklerState;
+    }
+    /* New limits are used from the next sensor pass, no task is woken up. */
+    if (parser.fields & FIELD_CONTROL)
+    {
+        next.controlBand = parser.update.controlBand;
+        next.controlMaxOnS = parser.update.controlMaxOnS;
+        next.controlMinOffS = parser.update.controlMinOffS;
+    }
+
+    wifiApiWrite(&next);
+
+    /* The scheduler keeps the schedule, only a new version changes anything. */
+    if ((parser.fields & FIELD_SCHEDULE) && scheduleCallback != NULL)
+    {
+        if (parser.scheduleTruncated)
+        {
+            ESP_LOGW(TAG, "Schedule %lu too large, ignored", (unsigned long)parser.schedule.version);
+        }
+        else if (parser.scheduleInvalid)
+        {
+            ESP_LOGE(TAG, "Schedule %lu has values out of range, ignored", (unsigned long)parser.schedule.version);
+        }
+        else
+        {
+            changed |= scheduleCallback(&parser.schedule);
+        }
+    }
+
+    if (changed && commandEvents != NULL)
     {
-        cJSON* pSensor = cJSON_GetArrayItem(pSensorData, SENSOR_NUMBER);
-        wifi_api.humidity = cJSON_GetObjectItem(pSensor, "humidity")->valuedouble;
-        wifi_api.isSensorOn = cJSON_GetObjectItem(pSensor, "is_sensor_on")->valueint;
-        wifi_api.sensorId = cJSON_GetObjectItem(pSensor, "sensor_id")->valueint;
-        wifi_api.wateringProcess = cJSON_GetObjectItem(pRoot, "watering_process")->valueint;
-        wifi_api.sprinklerState = cJSON_GetObjectItem(pRoot, "sprinkler_state")->valueint;
+        xEventGroupSetBits(commandEvents, WIFI_API_ALL_BITS);
     }
-    cJSON_Delete(pRoot);
 }
 
 /*********************************************************************/
 /*!
- * \brief  Preparing JSON with loaded data.
+ * \brief  Updating data downloaded from the website.
+ *
+ * \param  pData - Whole response.
+ * \param  len - length of the response.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void getData(const char* pData, int len)
+{
+    getDataBegin(wifiApiJson);
+    getDataChunk(pData, len);
+    getDataEnd();
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Preparing compact JSON with loaded data, without heap allocations.
  *
  * \param  pData - Pointer where the result is stored.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
  *
- * \return Formatted JSON.
+ * \return Length of the JSON, -1 if the buffer is too small.
  *
  */
 /*********************************************************************/
-char* postData(sensorData *pData)
+int postData(const sensorData* pData, char* pBuffer, size_t size)
 {
-    char* pJsonData = TEMP_JSON;
-    cJSON* pRoot = cJSON_Parse(pJsonData);
-    cJSON_ReplaceItemInObject(pRoot, "humidity", cJSON_CreateNumber(pData->percentageResult));
-    char* pNewJsonData = cJSON_Print(pRoot);
+    jsonWriter writer;
+
+    jsonWriterInit(&writer, pBuffer, size);
+    jsonWriteObjectBegin(&writer);
+    writeSensorMembers(&writer, pData);
+    jsonWriteObjectEnd(&writer);
+
+    return jsonWriterFinish(&writer);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Preparing compact JSON array with many samples,
+ *         without heap allocations. Samples taken before the
+ *         wall-clock time was set have no timestamp.
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return Length of the JSON, -1 if the buffer is too small.
+ *
+ */
+/*********************************************************************/
+int postDataBatch(const sensorSample* pSamples, size_t count, char* pBuffer, size_t size)
+{
+    jsonWriter writer;
+    size_t i = 0;
+
+    jsonWriterInit(&writer, pBuffer, size);
+    jsonWriteArrayBegin(&writer);
+    for (i = 0; i < count; i++)
+    {
+        jsonWriteObjectBegin(&writer);
+        writeSensorMembers(&writer, &pSamples[i].data);
+        /* Without the wall-clock time the server stamps the sample on arrival. */
+        if (pSamples[i].timeValid)
+        {
+            jsonWriteMemberInt(&writer, "timestamp", pSamples[i].timestamp);
+        }
+        jsonWriteObjectEnd(&writer);
+    }
+    jsonWriteArrayEnd(&writer);
+
+    return jsonWriterFinish(&writer);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Preparing CBOR with loaded data, the members are
+ *         the same as in postData().
+ *
+ * \param  pData - Pointer where the result is stored.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return Length of the CBOR, -1 if the buffer is too small.
+ *
+ */
+/*********************************************************************/
+int postDataCbor(const sensorData* pData, uint8_t* pBuffer, size_t size)
+{
+    cborWriter writer;
+
+    cborWriterInit(&writer, pBuffer, size);
+    cborWriteMapBegin(&writer, SENSOR_MEMBERS);
+    writeSensorMembersCbor(&writer, pData);
+
+    return cborWriterFinish(&writer);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Preparing CBOR array with many samples, the members are
+ *         the same as in postDataBatch().
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return Length of the CBOR, -1 if the buffer is too small.
+ *
+ */
+/*********************************************************************/
+int postDataBatchCbor(const sensorSample* pSamples, size_t count, uint8_t* pBuffer, size_t size)
+{
+    cborWriter writer;
+    size_t i = 0;
+
+    cborWriterInit(&writer, pBuffer, size);
+    cborWriteArrayBegin(&writer, count);
+    for (i = 0; i < count; i++)
+    {
+        cborWriteMapBegin(&writer, SENSOR_MEMBERS + (pSamples[i].timeValid ? 1 : 0));
+        writeSensorMembersCbor(&writer, &pSamples[i].data);
+        if (pSamples[i].timeValid)
+        {
+            cborWriteMemberInt(&writer, "timestamp", pSamples[i].timestamp);
+        }
+    }
 
-    cJSON_Delete(pRoot);
-    return pNewJsonData;
+    return cborWriterFinish(&writer);
 }
\ No newline at end of file
@@ -11,53 +11,244 @@
 #ifndef WIFI_API_H
 #define WIFI_API_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sample_ring.h"
+#include "schedule.h"
 #include "sensor.h"
 
+/**********************************************************************
+Macros
+**********************************************************************/
+
+/* Buffer size needed by postData(). */
+#define POST_DATA_SIZE 64
+/* Buffer size needed by postDataBatch() for each sample. */
+#define POST_SAMPLE_SIZE 96
+
+/* Command change notification bits, one for each waiting task. */
+#define WIFI_API_SENSOR_BIT (1 << 0)
+#define WIFI_API_SPRINKLERS_BIT (1 << 1)
+#define WIFI_API_ALL_BITS (WIFI_API_SENSOR_BIT | WIFI_API_SPRINKLERS_BIT)
+
 /**********************************************************************
 Data Types
 **********************************************************************/
-/* Data read from JSON. */
+/* Encoding of a response or a request body. */
+typedef enum
+{
+    wifiApiJson,            //application/json
+    wifiApiCbor,            //application/cbor
+} wifiApiFormat;
+
+/* Data of one sensor read from JSON. */
 typedef struct
 {
-    float humidity;         //Humidity level.
+    float humidity;         //Target humidity level, 0 if not controlled.
     int isSensorOn;         //Sensor status (1-on, 0-off).
     int sensorId;           // Sensor ID.
+} wifiApiSensor;
+
+/* Data read from JSON. */
+typedef struct
+{
+    wifiApiSensor sensors[SENSOR_MAX];  //Sensors of the board, in registry order.
+    uint8_t sensorCount;                //Number of sensors of the board.
 
     int wateringProcess;    //Watering status (1-on, 0-off).
     int sprinklerState;     //Manual watering status (1-on, 0-off).
-} wifiApi;
 
-/**********************************************************************
-Global variables
-**********************************************************************/
+    /* Limits of the moisture controller, 0 if not given. */
+    int controlBand;        //Deficit which opens the valve [%].
+    int controlMaxOnS;      //Longest watering [s].
+    int controlMinOffS;     //Soak time after a watering [s].
+} wifiApi;
 
-extern wifiApi wifi_api;
+/* Called with a schedule read from the website, returns true if it was applied. */
+typedef bool (*wifiApiScheduleCallback)(const scheduleTable* pTable);
 
 /**********************************************************************
 Function Declarations
 **********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Reading a consistent copy of the data from the website.
+ *         Readers retry instead of blocking the writer.
+ *
+ * \param  pData - Pointer where the copy is stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiApiRead(wifiApi* pData);
+
+/*********************************************************************/
+/*!
+ * \brief  Initialization of the command change notifications
+ *         and of the sensors reported by the board.
+ *
+ * \param  pSensorIds - website IDs of the sensors, in registry order.
+ * \param  count - number of sensors.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiApiInit(const uint16_t* pSensorIds, uint8_t count);
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting until the commands from the website change.
+ *
+ * \param  bit - bit of the waiting task (WIFI_API_*_BIT).
+ * \param  timeout - maximum waiting time in ticks.
+ *
+ * \return True if the commands changed, false on timeout.
+ *
+ */
+/*********************************************************************/
+bool wifiApiWaitChange(uint32_t bit, uint32_t timeout);
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the function called with every complete schedule
+ *         in the data from the website.
+ *
+ * \param  callback - function called from the parsing task.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiApiSetScheduleCallback(wifiApiScheduleCallback callback);
+
+/*********************************************************************/
+/*!
+ * \brief  Restoring the data kept through deep sleep.
+ *         Has to be called before the tasks start.
+ *
+ * \param  pData - data.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiApiRestore(const wifiApi* pData);
+
+/*********************************************************************/
+/*!
+ * \brief  Starting to read a new response from the website.
+ *
+ * \param  format - encoding of the response.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void getDataBegin(wifiApiFormat format);
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the next chunk of the response.
+ *
+ * \param  pData - chunk of the response (not NUL-terminated).
+ * \param  len - length of the chunk.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void getDataChunk(const char* pData, int len);
+
+/*********************************************************************/
+/*!
+ * \brief  Updating data downloaded from the website
+ *         once the whole response was read.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void getDataEnd(void);
+
 /*********************************************************************/
 /*!
  * \brief  Updating data downloaded from the website.
  *
- * \param  pData - Pointer where the result is stored.
+ * \param  pData - Whole response.
+ * \param  len - length of the response.
  *
  * \return None
  *
  */
 /*********************************************************************/
-void getData(char* pData);
+void getData(const char* pData, int len);
+
+/*********************************************************************/
+/*!
+ * \brief  Preparing compact JSON with loaded data, without heap allocations.
+ *
+ * \param  pData - Pointer where the result is stored.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return Length of the JSON, -1 if the buffer is too small.
+ *
+ */
+/*********************************************************************/
+int postData(const sensorData* pData, char* pBuffer, size_t size);
+
+/*********************************************************************/
+/*!
+ * \brief  Preparing compact JSON array with many samples,
+ *         without heap allocations. Samples taken before the
+ *         wall-clock time was set have no timestamp.
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return Length of the JSON, -1 if the buffer is too small.
+ *
+ */
+/*********************************************************************/
+int postDataBatch(const sensorSample* pSamples, size_t count, char* pBuffer, size_t size);
 
 /*********************************************************************/
 /*!
- * \brief  Preparing JSON with loaded data.
+ * \brief  Preparing CBOR with loaded data, the members are
+ *         the same as in postData().
  *
  * \param  pData - Pointer where the result is stored.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
+ *
+ * \return Length of the CBOR, -1 if the buffer is too small.
+ *
+ */
+/*********************************************************************/
+int postDataCbor(const sensorData* pData, uint8_t* pBuffer, size_t size);
+
+/*********************************************************************/
+/*!
+ * \brief  Preparing CBOR array with many samples, the members are
+ *         the same as in postDataBatch().
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples.
+ * \param  pBuffer - output buffer.
+ * \param  size - size of the output buffer.
  *
- * \return Formatted JSON.
+ * \return Length of the CBOR, -1 if the buffer is too small.
  *
  */
 /*********************************************************************/
-char* postData(sensorData* pData);
+int postDataBatchCbor(const sensorSample* pSamples, size_t count, uint8_t* pBuffer, size_t size);
 
 #endif /*WIFI_API_H*/
\ No newline at end of file
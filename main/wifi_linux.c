@@ -0,0 +1,977 @@
+/*********************************************************************/
+/*!
+*   \file   wifi_linux.c
+*
+*   \brief  Rest api support for the Linux build over POSIX sockets.
+*
+*           The host network is always up, so the link is reported as
+*           connected from wifiInit(). Requests use one keep-alive
+*           HTTP/1.1 connection, like the esp_http_client session.
+*
+*   \author Paweł Majewski
+*
+*/
+/*********************************************************************/
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "event_stream.h"
+#include "metrics.h"
+#include "wifi.h"
+#include "wifi_api.h"
+#include "leds.h"
+
+/**********************************************************************
+Macros
+**********************************************************************/
+
+#define TAG "wifi"
+
+/* Link state bits. */
+#define WIFI_CONNECTED_BIT BIT0
+
+/* How many times a request is repeated after a stale keep-alive connection. */
+#define SESSION_RETRY 1
+/* Socket send and receive timeout [s]. */
+#define SESSION_TIMEOUT_S 5
+
+/* Maximum lengths of the parts of the URL. */
+#define URL_HOST_SIZE 64
+#define URL_PORT_SIZE 8
+#define URL_PATH_SIZE 128
+
+/* Buffer for the request headers and for the response. */
+#define REQUEST_HEADER_SIZE 384
+#define RESPONSE_BUFFER_SIZE 512
+
+/* Content types of the request and response bodies. */
+#define CONTENT_TYPE_JSON "application/json"
+#define CONTENT_TYPE_CBOR "application/cbor"
+
+/* Encodings of the GET response accepted by the session. */
+#if CONFIG_TELEMETRY_CBOR
+#define SESSION_ACCEPT "Accept: " CONTENT_TYPE_CBOR ", " CONTENT_TYPE_JSON ";q=0.5\r\n"
+#else
+#define SESSION_ACCEPT ""
+#endif
+
+/* Maximum length of an entity tag, longer ones are not used. */
+#define SESSION_ETAG_SIZE 48
+
+/* Longest silence on the command stream, the server sends comments more often [s]. */
+#define PUSH_TIMEOUT_S 60
+
+/* Buffer for the batch of samples. */
+#define POST_BATCH_BUFFER_SIZE (POST_BATCH_MAX * POST_SAMPLE_SIZE + 2)
+
+/**********************************************************************
+Data Types
+**********************************************************************/
+/* Long-lived HTTP session to the rest api. */
+typedef struct
+{
+    char host[URL_HOST_SIZE];           //Host of the rest api.
+    char port[URL_PORT_SIZE];           //Port of the rest api.
+    char path[URL_PATH_SIZE];           //Path of the rest api.
+    int socket;                         //Connection reused between requests, -1 - closed.
+    SemaphoreHandle_t lock;             //Access to the session from many tasks.
+    bool newConnection;                 //Request in progress opened a new connection.
+    char etag[SESSION_ETAG_SIZE];       //Entity tag of the last parsed GET response.
+    char buffer[RESPONSE_BUFFER_SIZE];  //Response being read.
+    bool cborRefused;                   //Server answered 415 to a CBOR body.
+    httpStats stats;                    //Session statistics.
+} httpSession;
+
+/* Headers of the response which matter to the session. */
+typedef struct
+{
+    int status;                         //Status code.
+    long contentLength;                 //Body length, -1 - until the connection is closed.
+    bool close;                         //Server closes the connection.
+    bool chunked;                       //Chunked transfer encoding.
+    bool eventStream;                   //Body is a text/event-stream.
+    wifiApiFormat format;               //Encoding of the body.
+    char etag[SESSION_ETAG_SIZE];       //Entity tag, empty if none.
+} httpResponse;
+
+/* Command stream pushed by the server. */
+typedef struct
+{
+    httpSession connection;             //Connection of the stream.
+    eventStream parser;                 //Parser of the stream.
+} pushStream;
+
+/* State of the link. */
+typedef struct
+{
+    EventGroupHandle_t events;          //Link state bits.
+    wifiLinkCallback callback;          //Called when the link goes up or down.
+    uint32_t linkUpUs;                  //Boot to the link up [us].
+} wifiLink;
+
+/**********************************************************************
+Local variables
+**********************************************************************/
+
+static httpSession session = { .socket = -1 };
+static wifiLink linkState;
+static pushStream push = { .connection = { .socket = -1 } };
+static char batchBuffer[POST_BATCH_BUFFER_SIZE];
+
+/**********************************************************************
+Local Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  Splitting the URL (http://host[:port]/path).
+ *
+ * \param  pSession - session.
+ * \param  pUrl - URL.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t sessionParseUrl(httpSession* pSession, const char* pUrl)
+{
+    const char* pHost = NULL;
+    const char* pPath = NULL;
+    const char* pPort = NULL;
+    size_t hostLen = 0;
+
+    if (strncmp(pUrl, "http://", 7) != 0)
+    {
+        ESP_LOGE(TAG, "Only http:// URLs are supported: %s", pUrl);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pHost = pUrl + 7;
+    pPath = strchr(pHost, '/');
+    if (pPath == NULL)
+    {
+        pPath = pHost + strlen(pHost);
+    }
+    pPort = memchr(pHost, ':', pPath - pHost);
+    hostLen = (pPort != NULL ? pPort : pPath) - pHost;
+
+    if (hostLen == 0 || hostLen >= URL_HOST_SIZE || strlen(pPath) >= URL_PATH_SIZE)
+    {
+        ESP_LOGE(TAG, "Invalid URL: %s", pUrl);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(pSession->host, pHost, hostLen);
+    pSession->host[hostLen] = '\0';
+    if (pPort != NULL)
+    {
+        snprintf(pSession->port, sizeof(pSession->port), "%.*s", (int)(pPath - pPort - 1), pPort + 1);
+    }
+    else
+    {
+        strcpy(pSession->port, "80");
+    }
+    strcpy(pSession->path, (*pPath != '\0') ? pPath : "/");
+
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Closing the session connection.
+ *
+ * \param  pSession - session.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void sessionClose(httpSession* pSession)
+{
+    if (pSession->socket >= 0)
+    {
+        close(pSession->socket);
+        pSession->socket = -1;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Opening the session connection if it is closed.
+ *
+ * \param  pSession - session.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t sessionOpen(httpSession* pSession)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo* pAddresses = NULL;
+    struct addrinfo* pAddress = NULL;
+    struct timeval timeout = {
+        .tv_sec = SESSION_TIMEOUT_S,
+    };
+    int64_t start = 0;
+
+    if (pSession->socket >= 0)
+    {
+        return ESP_OK;
+    }
+
+    start = esp_timer_get_time();
+    if (getaddrinfo(pSession->host, pSession->port, &hints, &pAddresses) != 0)
+    {
+        ESP_LOGE(TAG, "Failed to resolve %s", pSession->host);
+        return ESP_FAIL;
+    }
+
+    for (pAddress = pAddresses; pAddress != NULL; pAddress = pAddress->ai_next)
+    {
+        pSession->socket = socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol);
+        if (pSession->socket < 0)
+        {
+            continue;
+        }
+        setsockopt(pSession->socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(pSession->socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(pSession->socket, pAddress->ai_addr, pAddress->ai_addrlen) == 0)
+        {
+            break;
+        }
+        sessionClose(pSession);
+    }
+    freeaddrinfo(pAddresses);
+
+    if (pSession->socket < 0)
+    {
+        ESP_LOGE(TAG, "Failed to connect to %s:%s: %s", pSession->host, pSession->port, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    uint32_t handshake = (uint32_t)(esp_timer_get_time() - start);
+
+    pSession->newConnection = true;
+    pSession->stats.connections++;
+    pSession->stats.lastHandshakeUs = handshake;
+    pSession->stats.totalHandshakeUs += handshake;
+
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Sending the whole buffer.
+ *
+ * \param  pSession - session.
+ * \param  pData - data.
+ * \param  len - length of the data.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t sessionSend(httpSession* pSession, const char* pData, size_t len)
+{
+    ssize_t sent = 0;
+
+    while (len > 0)
+    {
+        sent = send(pSession->socket, pData, len, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return ESP_FAIL;
+        }
+        pData += sent;
+        len -= sent;
+    }
+
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the status line and the headers of the response.
+ *         The part of the body read with them is moved to the
+ *         start of the session buffer.
+ *
+ * \param  pSession - session.
+ * \param  pResponse - Pointer where the headers are stored.
+ * \param  pBodyLen - Pointer where the length of the read body is stored.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t sessionReadHeaders(httpSession* pSession, httpResponse* pResponse, size_t* pBodyLen)
+{
+    size_t len = 0;
+    size_t etagLen = 0;
+    ssize_t received = 0;
+    char* pEnd = NULL;
+    char* pLine = NULL;
+    char* pNext = NULL;
+
+    do
+    {
+        if (len == sizeof(pSession->buffer) - 1)
+        {
+            ESP_LOGE(TAG, "Response headers too long");
+            return ESP_ERR_INVALID_SIZE;
+        }
+        received = recv(pSession->socket, pSession->buffer + len, sizeof(pSession->buffer) - 1 - len, 0);
+        if (received <= 0)
+        {
+            return ESP_FAIL;
+        }
+        len += received;
+        pSession->buffer[len] = '\0';
+    } while ((pEnd = strstr(pSession->buffer, "\r\n\r\n")) == NULL);
+
+    *pEnd = '\0';
+    pResponse->status = 0;
+    pResponse->contentLength = -1;
+    pResponse->close = false;
+    pResponse->chunked = false;
+    pResponse->eventStream = false;
+    pResponse->format = wifiApiJson;
+    pResponse->etag[0] = '\0';
+
+    if (sscanf(pSession->buffer, "HTTP/1.%*d %d", &pResponse->status) != 1)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    for (pLine = strstr(pSession->buffer, "\r\n"); pLine != NULL; pLine = pNext)
+    {
+        pLine += 2;
+        pNext = strstr(pLine, "\r\n");
+        if (strncasecmp(pLine, "Content-Length:", 15) == 0)
+        {
+            pResponse->contentLength = strtol(pLine + 15, NULL, 10);
+        }
+        else if (strncasecmp(pLine, "Connection:", 11) == 0 && strstr(pLine, "close") != NULL)
+        {
+            pResponse->close = true;
+        }
+        else if (strncasecmp(pLine, "Transfer-Encoding:", 18) == 0 && strstr(pLine, "chunked") != NULL)
+        {
+            pResponse->chunked = true;
+        }
+        else if (strncasecmp(pLine, "Content-Type:", 13) == 0 && strstr(pLine, "text/event-stream") != NULL)
+        {
+            pResponse->eventStream = true;
+        }
+        else if (strncasecmp(pLine, "Content-Type:", 13) == 0 && strstr(pLine, CONTENT_TYPE_CBOR) != NULL)
+        {
+            pResponse->format = wifiApiCbor;
+        }
+        else if (strncasecmp(pLine, "ETag:", 5) == 0)
+        {
+            pLine += 5 + strspn(pLine + 5, " ");
+            etagLen = (pNext != NULL) ? (size_t)(pNext - pLine) : strlen(pLine);
+            if (etagLen < SESSION_ETAG_SIZE)
+            {
+                memcpy(pResponse->etag, pLine, etagLen);
+                pResponse->etag[etagLen] = '\0';
+            }
+        }
+    }
+
+    /* These never have a body, whatever the headers say. */
+    if (pResponse->status == 204 || pResponse->status == 304)
+    {
+        pResponse->contentLength = 0;
+    }
+
+    *pBodyLen = len - (pEnd + 4 - pSession->buffer);
+    memmove(pSession->buffer, pEnd + 4, *pBodyLen);
+
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading the body of the response.
+ *
+ * \param  pResponse - headers of the response.
+ * \param  len - length of the body already in the session buffer.
+ * \param  parse - the body is passed to the GET parser.
+ *
+ * \return Error status.
+ *
+ */
+/*********************************************************************/
+static esp_err_t sessionReadBody(const httpResponse* pResponse, size_t len, bool parse)
+{
+    long remaining = pResponse->contentLength;
+    ssize_t received = 0;
+
+    if (parse)
+    {
+        getDataBegin(pResponse->format);
+    }
+
+    while (true)
+    {
+        if (remaining >= 0 && (long)len > remaining)
+        {
+            len = remaining;
+        }
+        if (parse)
+        {
+            getDataChunk(session.buffer, len);
+        }
+        if (remaining >= 0)
+        {
+            remaining -= len;
+            if (remaining == 0)
+            {
+                break;
+            }
+        }
+
+        received = recv(session.socket, session.buffer, sizeof(session.buffer), 0);
+        if (received < 0 || (received == 0 && remaining >= 0))
+        {
+            return ESP_FAIL;
+        }
+        if (received == 0)
+        {
+            /* Body without a length ends with the connection. */
+            break;
+        }
+        len = received;
+    }
+
+    if (parse && pResponse->status == 200)
+    {
+        getDataEnd();
+    }
+
+    return ESP_OK;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Passing the events of the command stream to the GET parser.
+ *
+ * \param  part - part of the event.
+ * \param  pData - piece of the event data.
+ * \param  len - length of the piece.
+ * \param  pContext - not used.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+static void pushEvent(eventStreamPart part, const char* pData, size_t len, void* pContext)
+{
+    switch (part)
+    {
+    case eventStreamBegin:
+        getDataBegin(wifiApiJson);
+        break;
+    case eventStreamData:
+        getDataChunk(pData, (int)len);
+        break;
+    case eventStreamEnd:
+        getDataEnd();
+        xSemaphoreTake(session.lock, portMAX_DELAY);
+        session.stats.pushEvents++;
+        xSemaphoreGive(session.lock);
+        break;
+    default:
+        break;
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Performing a request on the session connection.
+ *         A request which failed on a reused connection is repeated
+ *         once on a new one, because the server may have closed it.
+ *
+ * \param  pMethod - request method.
+ * \param  pContentType - type of the body.
+ * \param  pBody - request body (NULL if none).
+ * \param  len - length of the body.
+ *
+ * \return Error status, ESP_ERR_NOT_SUPPORTED if the server refused
+ *         the type of the body, ESP_ERR_INVALID_ARG if it rejected
+ *         the request (4xx), ESP_ERR_INVALID_RESPONSE on a server error (5xx).
+ *
+ */
+/*********************************************************************/
+static esp_err_t sessionPerform(const char* pMethod, const char* pContentType, const char* pBody, int len)
+{
+    esp_err_t err = ESP_FAIL;
+    uint8_t retry = 0;
+    int64_t start = 0;
+    char header[REQUEST_HEADER_SIZE];
+    int headerLen = 0;
+    httpResponse response;
+    size_t bodyLen = 0;
+    bool conditional = false;
+
+    xSemaphoreTake(session.lock, portMAX_DELAY);
+
+    /* The server answers 304 without a body if the commands did not change. */
+    conditional = (pBody == NULL && session.etag[0] != '\0');
+    if (pBody != NULL)
+    {
+        headerLen = snprintf(header, sizeof(header),
+                             "%s %s HTTP/1.1\r\nHost: %s:%s\r\nConnection: keep-alive\r\n"
+                             "Content-Type: %s\r\nContent-Length: %d\r\n\r\n",
+                             pMethod, session.path, session.host, session.port, pContentType, len);
+    }
+    else if (conditional)
+    {
+        headerLen = snprintf(header, sizeof(header),
+                             "%s %s HTTP/1.1\r\nHost: %s:%s\r\nConnection: keep-alive\r\n"
+                             SESSION_ACCEPT "If-None-Match: %s\r\n\r\n",
+                             pMethod, session.path, session.host, session.port, session.etag);
+    }
+    else
+    {
+        headerLen = snprintf(header, sizeof(header),
+                             "%s %s HTTP/1.1\r\nHost: %s:%s\r\nConnection: keep-alive\r\n"
+                             SESSION_ACCEPT "\r\n",
+                             pMethod, session.path, session.host, session.port);
+    }
+    if (headerLen < 0 || headerLen >= (int)sizeof(header))
+    {
+        xSemaphoreGive(session.lock);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    start = metricsStart();
+    for (retry = 0; retry <= SESSION_RETRY; retry++)
+    {
+        session.newConnection = false;
+
+        err = sessionOpen(&session);
+        if (err != ESP_OK)
+        {
+            break;
+        }
+
+        err = sessionSend(&session, header, headerLen);
+        if (err == ESP_OK && pBody != NULL)
+        {
+            err = sessionSend(&session, pBody, len);
+        }
+        if (err == ESP_OK)
+        {
+            err = sessionReadHeaders(&session, &response, &bodyLen);
+        }
+        if (err == ESP_OK && response.chunked)
+        {
+            ESP_LOGE(TAG, "Chunked responses are not supported");
+            err = ESP_ERR_NOT_SUPPORTED;
+        }
+        if (err == ESP_OK)
+        {
+            /* 304 Not Modified has no body, the last commands stay. */
+            err = sessionReadBody(&response, bodyLen, pBody == NULL && response.status == 200);
+        }
+        if (err == ESP_OK && pBody == NULL && response.status == 200)
+        {
+            strcpy(session.etag, response.etag);
+        }
+        if (err == ESP_OK)
+        {
+            if (response.close || response.contentLength < 0)
+            {
+                sessionClose(&session);
+            }
+            if (response.status == 415)
+            {
+                err = ESP_ERR_NOT_SUPPORTED;
+            }
+            else if (response.status >= 500)
+            {
+                err = ESP_ERR_INVALID_RESPONSE;
+            }
+            else if (response.status >= 400)
+            {
+                /* Sending the same request again would not help. */
+                err = ESP_ERR_INVALID_ARG;
+            }
+            break;
+        }
+
+        /* Drop the broken connection, the next attempt reconnects. */
+        sessionClose(&session);
+        if (session.newConnection)
+        {
+            break;
+        }
+        ESP_LOGW(TAG, "Keep-alive connection lost, reconnecting");
+    }
+
+    metricsObserve((pBody == NULL) ? metricHttpGet : metricHttpPost, start);
+    session.stats.requests++;
+    if (conditional)
+    {
+        session.stats.conditional++;
+        if (err == ESP_OK && response.status == 304)
+        {
+            session.stats.notModified++;
+        }
+    }
+    if (err != ESP_OK)
+    {
+        session.stats.failures++;
+    }
+    else if (!session.newConnection)
+    {
+        session.stats.reuses++;
+    }
+    if (err == ESP_OK && pBody != NULL && session.stats.firstPostUs == 0)
+    {
+        session.stats.firstPostUs = (uint32_t)esp_timer_get_time();
+        ESP_LOGI(TAG, "First POST %lu ms after boot", (unsigned long)(session.stats.firstPostUs / 1000));
+    }
+
+    xSemaphoreGive(session.lock);
+    return err;
+}
+
+/**********************************************************************
+ Global Function
+**********************************************************************/
+/*********************************************************************/
+/*!
+ * \brief  WiFi initialization.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiInit(void)
+{
+    esp_err_t err = ESP_OK;
+
+    linkState.events = xEventGroupCreate();
+
+    err = sessionParseUrl(&session, CONFIG_REST_API_URL);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to parse rest api URL: %s", esp_err_to_name(err));
+    }
+
+#if CONFIG_COMMAND_PUSH
+    err = sessionParseUrl(&push.connection, CONFIG_COMMAND_PUSH_URL);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to parse command stream URL: %s", esp_err_to_name(err));
+    }
+#endif
+
+    session.lock = xSemaphoreCreateMutex();
+    if (session.lock == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create HTTP session lock");
+    }
+
+    linkState.linkUpUs = (uint32_t)esp_timer_get_time();
+    xEventGroupSetBits(linkState.events, WIFI_CONNECTED_BIT);
+    turnOnLed(wifiUiStatus);
+
+    ESP_LOGI(TAG, "Host network used, rest api at %s:%s%s", session.host, session.port, session.path);
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Stopping the radio before deep sleep.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiStop(void)
+{
+    /* The host network stays up through the simulated sleep. */
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Checking if the station has an IP address.
+ *
+ * \param  None
+ *
+ * \return True if connected.
+ *
+ */
+/*********************************************************************/
+bool wifiIsConnected(void)
+{
+    return (xEventGroupGetBits(linkState.events) & WIFI_CONNECTED_BIT) != 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Waiting until the station has an IP address.
+ *
+ * \param  timeout - maximum waiting time [ticks].
+ *
+ * \return True if connected.
+ *
+ */
+/*********************************************************************/
+bool wifiWaitConnected(uint32_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(linkState.events, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, timeout);
+
+    return (bits & WIFI_CONNECTED_BIT) != 0;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Setting the function called when the link goes up or down.
+ *
+ * \param  callback - function called from the event loop task.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void wifiSetLinkCallback(wifiLinkCallback callback)
+{
+    linkState.callback = callback;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  GET support.
+ *
+ * \param  None
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void restGet(void)
+{
+    esp_err_t err = ESP_FAIL;
+
+    err = sessionPerform("GET", NULL, NULL, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Receiving commands pushed by the server (Server-Sent Events).
+ *         Blocks while the stream is open, every event is parsed
+ *         like a GET response.
+ *
+ * \param  None
+ *
+ * \return ESP_ERR_NOT_SUPPORTED if the server does not offer the stream,
+ *         ESP_OK when an open stream ended, other errors if it could
+ *         not be opened.
+ *
+ */
+/*********************************************************************/
+esp_err_t restListen(void)
+{
+#if CONFIG_COMMAND_PUSH
+    esp_err_t err = ESP_FAIL;
+    httpSession* pConnection = &push.connection;
+    char header[REQUEST_HEADER_SIZE];
+    int headerLen = 0;
+    httpResponse response;
+    size_t len = 0;
+    ssize_t received = 0;
+    struct timeval timeout = {
+        .tv_sec = PUSH_TIMEOUT_S,
+    };
+
+    headerLen = snprintf(header, sizeof(header),
+                         "GET %s HTTP/1.1\r\nHost: %s:%s\r\nAccept: text/event-stream\r\n"
+                         "Cache-Control: no-cache\r\n\r\n",
+                         pConnection->path, pConnection->host, pConnection->port);
+    if (headerLen < 0 || headerLen >= (int)sizeof(header))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    /* The stream has its own connection, requests keep the session one. */
+    err = sessionOpen(pConnection);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    setsockopt(pConnection->socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    err = sessionSend(pConnection, header, headerLen);
+    if (err == ESP_OK)
+    {
+        err = sessionReadHeaders(pConnection, &response, &len);
+    }
+    if (err == ESP_OK && (response.status != 200 || !response.eventStream))
+    {
+        /* A server in trouble is not a server without the stream. */
+        err = (response.status >= 500) ? ESP_ERR_INVALID_RESPONSE : ESP_ERR_NOT_SUPPORTED;
+    }
+    if (err == ESP_OK && response.chunked)
+    {
+        ESP_LOGE(TAG, "Chunked streams are not supported");
+        err = ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (err == ESP_OK)
+    {
+        xSemaphoreTake(session.lock, portMAX_DELAY);
+        session.stats.pushStreams++;
+        xSemaphoreGive(session.lock);
+
+        /* The stream ends with the connection. */
+        eventStreamInit(&push.parser, pushEvent, NULL);
+        eventStreamFeed(&push.parser, pConnection->buffer, len);
+        while ((received = recv(pConnection->socket, pConnection->buffer, sizeof(pConnection->buffer), 0)) > 0)
+        {
+            eventStreamFeed(&push.parser, pConnection->buffer, received);
+        }
+        ESP_LOGW(TAG, "Command stream closed");
+    }
+
+    sessionClose(pConnection);
+    return err;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+/*********************************************************************/
+/*!
+ * \brief  POST support.
+ *
+ * \param  pData - Pointer where the result is stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void restPost(sensorData* pData)
+{
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+    char json_data[POST_DATA_SIZE];
+    int len = -1;
+
+#if CONFIG_TELEMETRY_CBOR
+    /* CBOR until the server refuses it, JSON from then on. */
+    len = session.cborRefused ? -1 : postDataCbor(pData, (uint8_t*)json_data, sizeof(json_data));
+    if (len >= 0)
+    {
+        err = sessionPerform("POST", CONTENT_TYPE_CBOR, json_data, len);
+        if (err == ESP_ERR_NOT_SUPPORTED)
+        {
+            ESP_LOGW(TAG, "Server does not accept CBOR, JSON is used");
+            session.cborRefused = true;
+        }
+    }
+#endif
+    if (err == ESP_ERR_NOT_SUPPORTED)
+    {
+        len = postData(pData, json_data, sizeof(json_data));
+        if (len < 0) {
+            ESP_LOGE(TAG, "POST data does not fit into the buffer");
+            return;
+        }
+        err = sessionPerform("POST", CONTENT_TYPE_JSON, json_data, len);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+    }
+}
+
+/*********************************************************************/
+/*!
+ * \brief  POST support for a batch of samples.
+ *         Only one task may send batches.
+ *
+ * \param  pSamples - samples, oldest first.
+ * \param  count - number of samples (at most POST_BATCH_MAX).
+ *
+ * \return Error status, ESP_ERR_INVALID_ARG or ESP_ERR_NOT_SUPPORTED
+ *         if the server rejected the samples for good.
+ *
+ */
+/*********************************************************************/
+esp_err_t restPostBatch(const sensorSample* pSamples, size_t count)
+{
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+    int len = -1;
+
+#if CONFIG_TELEMETRY_CBOR
+    /* CBOR until the server refuses it, JSON from then on. */
+    len = session.cborRefused ? -1 : postDataBatchCbor(pSamples, count, (uint8_t*)batchBuffer, sizeof(batchBuffer));
+    if (len >= 0)
+    {
+        err = sessionPerform("POST", CONTENT_TYPE_CBOR, batchBuffer, len);
+        if (err == ESP_ERR_NOT_SUPPORTED)
+        {
+            ESP_LOGW(TAG, "Server does not accept CBOR, JSON is used");
+            session.cborRefused = true;
+        }
+    }
+#endif
+    if (err == ESP_ERR_NOT_SUPPORTED)
+    {
+        len = postDataBatch(pSamples, count, batchBuffer, sizeof(batchBuffer));
+        if (len < 0) {
+            ESP_LOGE(TAG, "POST batch does not fit into the buffer");
+            return ESP_ERR_INVALID_SIZE;
+        }
+        err = sessionPerform("POST", CONTENT_TYPE_JSON, batchBuffer, len);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP POST batch request failed: %s", esp_err_to_name(err));
+    }
+
+    return err;
+}
+
+/*********************************************************************/
+/*!
+ * \brief  Reading statistics of the HTTP session.
+ *
+ * \param  pStats - Pointer where the statistics are stored.
+ *
+ * \return None
+ *
+ */
+/*********************************************************************/
+void restGetStats(httpStats* pStats)
+{
+    xSemaphoreTake(session.lock, portMAX_DELAY);
+    *pStats = session.stats;
+    xSemaphoreGive(session.lock);
+    pStats->linkUpUs = linkState.linkUpUs;
+}
\ No newline at end of file
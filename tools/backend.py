@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+"""Stand-in for the website rest api, used by the Linux build of the firmware.
+
+GET /mainview returns the commands with an ETag and answers If-None-Match with 304, POST /mainview accepts one sample or a batch.
+Bodies are CBOR when the device sends or accepts application/cbor, JSON otherwise; --no-cbor answers 415 instead.
+GET /mainview/events streams the commands as Server-Sent Events, POST /mainview/commands
+changes them, e.g. curl -d '{"sprinkler_state": 1}' http://127.0.0.1:5000/mainview/commands
+A watering schedule is sent with the commands, e.g. --schedule schedule.json with
+{"version": 1, "windows": [{"days": 127, "hour": 6, "minute": 30, "program": 0}],
+ "programs": [[{"valve": 1, "seconds": 120}, {"valve": 0, "seconds": 600}]]}
+The device stores it and starts the windows itself; a new "version" replaces it.
+"humidity" of each sensor is the target of the on-device moisture controller, 0 turns it off;
+its limits are changed with e.g. curl -d '{"control": {"band": 5, "max_on_s": 120, "min_off_s": 600}}'.
+Run: python3 tools/backend.py --sensors 2 --watering
+"""
+import argparse
+import hashlib
+import json
+import struct
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Comment sent on an idle stream, must be shorter than the device stream timeout.
+KEEPALIVE_S = 15
+
+JSON = "application/json"
+CBOR = "application/cbor"
+
+
+def cbor_head(major, value):
+    if value < 24:
+        return bytes([major << 5 | value])
+    for info, fmt in ((24, ">B"), (25, ">H"), (26, ">I"), (27, ">Q")):
+        if value < 1 << (8 * struct.calcsize(fmt)):
+            return bytes([major << 5 | info]) + struct.pack(fmt, value)
+    raise ValueError("integer too large")
+
+
+def cbor_encode(value):
+    """Encoding the subset of CBOR the firmware reads."""
+    if isinstance(value, bool):
+        return bytes([0xF5 if value else 0xF4])
+    if value is None:
+        return bytes([0xF6])
+    if isinstance(value, int):
+        return cbor_head(0, value) if value >= 0 else cbor_head(1, -1 - value)
+    if isinstance(value, float):
+        return bytes([0xFA]) + struct.pack(">f", value)
+    if isinstance(value, str):
+        data = value.encode()
+        return cbor_head(3, len(data)) + data
+    if isinstance(value, list):
+        return cbor_head(4, len(value)) + b"".join(cbor_encode(item) for item in value)
+    if isinstance(value, dict):
+        return cbor_head(5, len(value)) + b"".join(cbor_encode(k) + cbor_encode(v) for k, v in value.items())
+    raise ValueError(f"cannot encode {type(value).__name__}")
+
+
+def cbor_decode(data, pos=0):
+    """Decoding definite-length CBOR, returns the value and the next position."""
+    major, info = data[pos] >> 5, data[pos] & 0x1F
+    pos += 1
+    if major == 7:
+        if info in (25, 26, 27):
+            size = {25: 2, 26: 4, 27: 8}[info]
+            return struct.unpack({25: ">e", 26: ">f", 27: ">d"}[info], data[pos:pos + size])[0], pos + size
+        return {20: False, 21: True}.get(info), pos
+    if info < 24:
+        value = info
+    elif info < 28:
+        size = 1 << (info - 24)
+        value, pos = int.from_bytes(data[pos:pos + size], "big"), pos + size
+    else:
+        raise ValueError("indefinite lengths are not supported")
+    if major == 0:
+        return value, pos
+    if major == 1:
+        return -1 - value, pos
+    if major in (2, 3):
+        chunk = data[pos:pos + value]
+        return (chunk.decode() if major == 3 else bytes(chunk)), pos + value
+    if major == 6:
+        return cbor_decode(data, pos)
+    items = []
+    for _ in range(value * (2 if major == 5 else 1)):
+        item, pos = cbor_decode(data, pos)
+        items.append(item)
+    return (dict(zip(items[::2], items[1::2])) if major == 5 else items), pos
+
+
+class Backend(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    state = {}
+    samples = 0
+    not_modified = 0
+    push = True
+    cbor = True
+    version = 0
+    changed = threading.Condition()
+
+    def _reply(self, status, body=b"", etag=None, content_type=JSON):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        if etag is not None:
+            self.send_header("ETag", etag)
+        self.end_headers()
+        self.wfile.write(body)
+
+    def _stream(self):
+        self.send_response(200)
+        self.send_header("Content-Type", "text/event-stream")
+        self.send_header("Cache-Control", "no-cache")
+        self.send_header("Connection", "close")
+        self.end_headers()
+        self.close_connection = True
+        seen = None
+        try:
+            while True:
+                with Backend.changed:
+                    Backend.changed.wait_for(lambda: Backend.version != seen, timeout=KEEPALIVE_S)
+                    event = Backend.version != seen
+                    seen = Backend.version
+                    body = json.dumps(Backend.state)
+                self.wfile.write(f"data: {body}\n\n".encode() if event else b": keepalive\n\n")
+                self.wfile.flush()
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+
+    def do_GET(self):
+        if self.path == "/mainview/events" and Backend.push:
+            self._stream()
+            return
+        if self.path != "/mainview":
+            self._reply(404)
+            return
+        if Backend.cbor and CBOR in self.headers.get("Accept", ""):
+            content_type, body = CBOR, cbor_encode(Backend.state)
+        else:
+            content_type, body = JSON, json.dumps(Backend.state).encode()
+        etag = '"%s"' % hashlib.sha1(body).hexdigest()[:16]
+        if self.headers.get("If-None-Match") == etag:
+            Backend.not_modified += 1
+            self.send_response(304)
+            self.send_header("ETag", etag)
+            self.end_headers()
+            return
+        self._reply(200, body, etag, content_type)
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        cbor = self.headers.get("Content-Type", JSON).startswith(CBOR)
+        if cbor and not Backend.cbor:
+            self._reply(415)
+            return
+        try:
+            payload = cbor_decode(body)[0] if cbor else json.loads(body)
+        except (ValueError, IndexError, struct.error):
+            self._reply(400)
+            return
+        if self.path == "/mainview/commands":
+            with Backend.changed:
+                Backend.state.update(payload)
+                Backend.version += 1
+                Backend.changed.notify_all()
+            print(f"Commands: {payload}")
+            self._reply(200, b"{}")
+            return
+        # "humidity" of the commands is the target of the device controller, readings do not change it.
+        batch = payload if isinstance(payload, list) else [payload]
+        Backend.samples += len(batch)
+        print(f"POST {len(batch)} samples in {'CBOR' if cbor else 'JSON'} ({Backend.samples} total): {batch[-1]}")
+        self._reply(200, b"{}")
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--port", type=int, default=5000)
+    parser.add_argument("--sensors", type=int, default=1, help="number of sensors, ids 1..n")
+    parser.add_argument("--watering", action="store_true", help="start the watering sequence")
+    parser.add_argument("--sprinkler", action="store_true", help="open the valve manually")
+    parser.add_argument("--no-push", action="store_true", help="refuse the command stream, the device polls")
+    parser.add_argument("--no-cbor", action="store_true", help="answer CBOR bodies with 415, the device falls back to JSON")
+    parser.add_argument("--schedule", metavar="FILE", help="JSON watering schedule sent with the commands")
+    parser.add_argument("--target", type=int, default=0, help="target humidity of every sensor, 0 leaves control off")
+    args = parser.parse_args()
+
+    Backend.state = {
+        "sensor_data": [{"sensor_id": i + 1, "humidity": args.target, "is_sensor_on": 1} for i in range(args.sensors)],
+        "watering_process": int(args.watering),
+        "sprinkler_state": int(args.sprinkler),
+    }
+    if args.schedule:
+        with open(args.schedule) as schedule:
+            Backend.state["schedule"] = json.load(schedule)
+    Backend.push = not args.no_push
+    Backend.cbor = not args.no_cbor
+    server = ThreadingHTTPServer(("127.0.0.1", args.port), Backend)
+    print(f"Backend on http://127.0.0.1:{args.port}/mainview")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()